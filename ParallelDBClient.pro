@@ -2,6 +2,8 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
     lib \
-    app
+    app \
+    bench
 
 app.depends = lib
+bench.depends = lib
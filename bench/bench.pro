@@ -0,0 +1,21 @@
+TARGET = db_client_bench
+TEMPLATE = app
+
+QT += core sql network
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+
+HEADERS += \
+    benchrunner.h \
+    latencydriver.h
+
+SOURCES = \
+    benchrunner.cpp \
+    latencydriver.cpp \
+    main.cpp
+
+INCLUDEPATH += $$PWD/../lib
+LIBS += -L$$OUT_PWD/../lib -lparalleldbclient
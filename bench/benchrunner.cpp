@@ -0,0 +1,107 @@
+#include "benchrunner.h"
+
+#include <QMutexLocker>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+QJsonObject BenchResult::toJson() const
+{
+    QJsonObject ans = extra;
+    ans.insert("name", name);
+    ans.insert("ops", ops);
+    ans.insert("seconds", seconds);
+    ans.insert("ops_per_sec", throughput());
+    ans.insert("p50_ms", p50Ms);
+    ans.insert("p99_ms", p99Ms);
+    return ans;
+}
+
+
+void BenchRunner::run(const QString& name, const Case& benchCase, QJsonObject extra)
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mSamples.clear();
+        mOps = 0;
+        mFailed = false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    benchCase(*this);
+    qint64 elapsedNs = timer.nsecsElapsed();
+
+    QMutexLocker locker(&mMutex);
+    BenchResult result;
+    result.name = name;
+    result.ops = mOps > 0 ? mOps : mSamples.size();
+    result.seconds = elapsedNs / 1e9;
+    result.p50Ms = percentileMs(mSamples, 0.50);
+    result.p99Ms = percentileMs(mSamples, 0.99);
+    result.extra = extra;
+    result.extra.insert("samples", mSamples.size());
+    result.extra.insert("ok", !mFailed);
+    mResults.append(result);
+
+    QTextStream(stderr) << name << ": " << result.throughput() << " ops/s, p50 "
+                        << result.p50Ms << " ms, p99 " << result.p99Ms << " ms"
+                        << (mFailed ? " (FAILED)" : "") << endl;
+}
+
+
+void BenchRunner::record(qint64 ns)
+{
+    QMutexLocker locker(&mMutex);
+    mSamples.append(ns);
+}
+
+
+// Ops default to the number of samples, cases where one sample
+// covers many rows report them here
+void BenchRunner::addOps(qint64 ops)
+{
+    QMutexLocker locker(&mMutex);
+    mOps += ops;
+}
+
+
+bool BenchRunner::timed(const std::function<bool()>& op)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bool succ = op();
+    record(timer.nsecsElapsed());
+    if (!succ)
+    {
+        QMutexLocker locker(&mMutex);
+        mFailed = true;
+    }
+
+    return succ;
+}
+
+
+QJsonArray BenchRunner::toJson() const
+{
+    QJsonArray ans;
+    for (const BenchResult& result : mResults)
+    {
+        ans.append(result.toJson());
+    }
+
+    return ans;
+}
+
+
+// Nearest-rank percentile
+double BenchRunner::percentileMs(QVector<qint64> samplesNs, double quantile)
+{
+    if (samplesNs.isEmpty())
+        return 0.0;
+
+    std::sort(samplesNs.begin(), samplesNs.end());
+    int rank = static_cast<int>(std::ceil(quantile * samplesNs.size())) - 1;
+    rank = qBound(0, rank, samplesNs.size() - 1);
+    return samplesNs[rank] / 1e6;
+}
@@ -0,0 +1,53 @@
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// Outcome of one benchmark case, reported as one JSON object
+struct BenchResult
+{
+    QString name;
+    qint64 ops = 0;
+    double seconds = 0.0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    QJsonObject extra;
+
+    double throughput() const { return seconds > 0.0 ? ops / seconds : 0.0; }
+    QJsonObject toJson() const;
+};
+
+
+// Times operations of a case and collects the results of all cases.
+// record() may be called from several threads at once.
+class BenchRunner
+{
+public:
+    typedef std::function<void(BenchRunner&)> Case;
+
+    void run(const QString& name, const Case& benchCase, QJsonObject extra = QJsonObject());
+    void record(qint64 ns);
+    void addOps(qint64 ops);
+    bool timed(const std::function<bool()>& op);
+
+    QJsonArray toJson() const;
+    const QList<BenchResult>& results() const { return mResults; }
+
+    static double percentileMs(QVector<qint64> samplesNs, double quantile);
+
+private:
+    QList<BenchResult> mResults;
+    QVector<qint64> mSamples;
+    qint64 mOps = 0;
+    bool mFailed = false;
+
+    QMutex mMutex;
+};
+
+#endif // BENCHRUNNER_H
@@ -0,0 +1,289 @@
+#include "latencydriver.h"
+
+#include <QAtomicInt>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QThread>
+
+namespace
+{
+    QAtomicInt nextInnerId;
+}
+
+
+LatencyDriver::LatencyDriver(int latencyMs)
+    : mLatencyMs(qMax(0, latencyMs)),
+    mInnerName(QString("latency-inner-%1").arg(nextInnerId.fetchAndAddRelaxed(1)))
+{
+
+}
+
+
+LatencyDriver::~LatencyDriver()
+{
+    close();
+}
+
+
+bool LatencyDriver::hasFeature(DriverFeature feature) const
+{
+    switch (feature)
+    {
+    case DriverFeature::Transactions:
+    case DriverFeature::BLOB:
+    case DriverFeature::Unicode:
+    case DriverFeature::PreparedQueries:
+    case DriverFeature::PositionalPlaceholders:
+    case DriverFeature::LastInsertId:
+    case DriverFeature::SimpleLocking:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+bool LatencyDriver::open(
+        const QString& db,
+        const QString& user,
+        const QString& password,
+        const QString& host,
+        int port,
+        const QString& options)
+{
+    Q_UNUSED(user)
+    Q_UNUSED(password)
+    Q_UNUSED(host)
+    Q_UNUSED(port)
+
+    roundTrip();
+    QSqlDatabase inner = QSqlDatabase::contains(mInnerName)
+            ? QSqlDatabase::database(mInnerName, false)
+            : QSqlDatabase::addDatabase("QSQLITE", mInnerName);
+    inner.setDatabaseName(db);
+    inner.setConnectOptions(options);
+
+    bool succ = inner.open();
+    setOpen(succ);
+    setOpenError(!succ);
+    if (!succ)
+        setLastError(inner.lastError());
+
+    return succ;
+}
+
+
+void LatencyDriver::close()
+{
+    if (QSqlDatabase::contains(mInnerName))
+    {
+        {
+            QSqlDatabase inner = QSqlDatabase::database(mInnerName, false);
+            inner.close();
+        }
+
+        QSqlDatabase::removeDatabase(mInnerName);
+    }
+
+    setOpen(false);
+    setOpenError(false);
+}
+
+
+QSqlResult* LatencyDriver::createResult() const
+{
+    return new LatencyResult(this);
+}
+
+
+bool LatencyDriver::beginTransaction()
+{
+    roundTrip();
+    return inner().transaction();
+}
+
+
+bool LatencyDriver::commitTransaction()
+{
+    roundTrip();
+    return inner().commit();
+}
+
+
+bool LatencyDriver::rollbackTransaction()
+{
+    roundTrip();
+    return inner().rollback();
+}
+
+
+QStringList LatencyDriver::tables(QSql::TableType tableType) const
+{
+    return inner().tables(tableType);
+}
+
+
+QSqlRecord LatencyDriver::record(const QString& tableName) const
+{
+    return inner().record(tableName);
+}
+
+
+QString LatencyDriver::escapeIdentifier(
+        const QString& identifier,
+        IdentifierType type) const
+{
+    return inner().driver()->escapeIdentifier(identifier, type);
+}
+
+
+void LatencyDriver::roundTrip() const
+{
+    if (mLatencyMs > 0)
+        QThread::msleep(static_cast<unsigned long>(mLatencyMs));
+}
+
+
+QSqlDatabase LatencyDriver::inner() const
+{
+    return QSqlDatabase::database(mInnerName, false);
+}
+
+
+LatencyResult::LatencyResult(const LatencyDriver* driver)
+    : QSqlResult(driver),
+    mDriver(driver)
+{
+
+}
+
+
+bool LatencyResult::reset(const QString& query)
+{
+    mDriver->roundTrip();
+    mQuery = QSqlQuery(mDriver->inner());
+    mQuery.setForwardOnly(isForwardOnly());
+    return finishExec(mQuery.exec(query));
+}
+
+
+// Placeholders reach here already positional (?), the driver
+// does not claim support for named ones
+bool LatencyResult::prepare(const QString& query)
+{
+    mQuery = QSqlQuery(mDriver->inner());
+    mQuery.setForwardOnly(isForwardOnly());
+    if (!mQuery.prepare(query))
+    {
+        setLastError(mQuery.lastError());
+        return false;
+    }
+
+    return true;
+}
+
+
+bool LatencyResult::exec()
+{
+    mDriver->roundTrip();
+    QVector<QVariant> values = boundValues();
+    for (int i = 0; i < values.size(); ++i)
+    {
+        mQuery.bindValue(i, values[i], bindValueType(i));
+    }
+
+    return finishExec(mQuery.exec());
+}
+
+
+bool LatencyResult::fetch(int i)
+{
+    if (!mQuery.seek(i))
+        return false;
+
+    setAt(i);
+    return true;
+}
+
+
+bool LatencyResult::fetchNext()
+{
+    if (!mQuery.next())
+        return false;
+
+    setAt(at() + 1);
+    return true;
+}
+
+
+bool LatencyResult::fetchFirst()
+{
+    if (!mQuery.first())
+        return false;
+
+    setAt(0);
+    return true;
+}
+
+
+bool LatencyResult::fetchLast()
+{
+    if (!mQuery.last())
+        return false;
+
+    setAt(mQuery.at());
+    return true;
+}
+
+
+QVariant LatencyResult::data(int i)
+{
+    return mQuery.value(i);
+}
+
+
+bool LatencyResult::isNull(int i)
+{
+    return mQuery.isNull(i);
+}
+
+
+int LatencyResult::size()
+{
+    return mQuery.size();
+}
+
+
+int LatencyResult::numRowsAffected()
+{
+    return mQuery.numRowsAffected();
+}
+
+
+QSqlRecord LatencyResult::record() const
+{
+    return mQuery.record();
+}
+
+
+QVariant LatencyResult::lastInsertId() const
+{
+    return mQuery.lastInsertId();
+}
+
+
+bool LatencyResult::finishExec(bool succ)
+{
+    setActive(succ);
+    setSelect(succ && mQuery.isSelect());
+    if (!succ)
+        setLastError(mQuery.lastError());
+
+    return succ;
+}
+
+
+QSqlDriver* LatencyDriverCreator::createObject() const
+{
+    return new LatencyDriver(mLatencyMs);
+}
@@ -0,0 +1,85 @@
+#ifndef LATENCYDRIVER_H
+#define LATENCYDRIVER_H
+
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlDriverCreatorBase>
+#include <QSqlQuery>
+#include <QSqlResult>
+
+// Stand-in for a remote database: forwards everything to an SQLite
+// connection and sleeps latencyMs on every round trip (open, exec,
+// transaction commands), like a network hop would.
+class LatencyDriver : public QSqlDriver
+{
+public:
+    explicit LatencyDriver(int latencyMs);
+    ~LatencyDriver() override;
+
+    bool hasFeature(DriverFeature feature) const override;
+    bool open(
+            const QString& db,
+            const QString& user,
+            const QString& password,
+            const QString& host,
+            int port,
+            const QString& options) override;
+    void close() override;
+    QSqlResult* createResult() const override;
+    bool beginTransaction() override;
+    bool commitTransaction() override;
+    bool rollbackTransaction() override;
+    QStringList tables(QSql::TableType tableType) const override;
+    QSqlRecord record(const QString& tableName) const override;
+    QString escapeIdentifier(
+            const QString& identifier,
+            IdentifierType type) const override;
+
+    void roundTrip() const;
+    QSqlDatabase inner() const;
+
+private:
+    int mLatencyMs;
+    QString mInnerName;
+};
+
+
+class LatencyResult : public QSqlResult
+{
+public:
+    explicit LatencyResult(const LatencyDriver* driver);
+
+protected:
+    bool reset(const QString& query) override;
+    bool prepare(const QString& query) override;
+    bool exec() override;
+    bool fetch(int i) override;
+    bool fetchNext() override;
+    bool fetchFirst() override;
+    bool fetchLast() override;
+    QVariant data(int i) override;
+    bool isNull(int i) override;
+    int size() override;
+    int numRowsAffected() override;
+    QSqlRecord record() const override;
+    QVariant lastInsertId() const override;
+
+private:
+    bool finishExec(bool succ);
+
+    const LatencyDriver* mDriver;
+    QSqlQuery mQuery;
+};
+
+
+class LatencyDriverCreator : public QSqlDriverCreatorBase
+{
+public:
+    explicit LatencyDriverCreator(int latencyMs) : mLatencyMs(latencyMs) {}
+    QSqlDriver* createObject() const override;
+
+private:
+    int mLatencyMs;
+};
+
+#endif // LATENCYDRIVER_H
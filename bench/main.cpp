@@ -0,0 +1,329 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSqlRecord>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+#include "benchrunner.h"
+#include "latencydriver.h"
+#include "paralleldbfactory.h"
+#include "paralleldbmetainfo.h"
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const QString LATENCY_DRIVER = "QSQLITE_LATENCY";
+    const int SCAN_ROWS = 200000;
+
+    struct Options
+    {
+        int iterations;
+        int threads;
+        int latencyMs;
+        int maxBlobMb;
+    };
+
+
+    ParallelDbClient* createClient(
+            const QString& name,
+            const QString& path,
+            int poolSize,
+            const QString& driver = QString())
+    {
+        DbConfig config;
+        config.setDbEngine(DbConfig::DbEngine::SQLITE);
+        config.setDbname(path);
+        config.setDbDriver(driver);
+        dbFactory.createDbClient(name, name + "-conn", config);
+        ParallelDbClient* client = DB_CLIENT(name);
+        client->setPoolSize(poolSize, poolSize);
+        client->preOpenConnections();
+        return client;
+    }
+
+
+    bool exec(ParallelDbClient* client, const QString& queryString)
+    {
+        return client->update(queryString).result();
+    }
+
+
+    // Every thread runs its share of synchronous requests, latency is
+    // measured per request from submission to result
+    void concurrentSelects(
+            BenchRunner& runner,
+            ParallelDbClient* client,
+            const Options& options)
+    {
+        int perThread = qMax(1, options.iterations / options.threads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < options.threads; ++t)
+        {
+            threads.emplace_back([&runner, client, perThread, t]() {
+                for (int i = 0; i < perThread; ++i)
+                {
+                    int id = (t * 31 + i * 7919) % 1000 + 1;
+                    runner.timed([&]() {
+                        return client->select(
+                                    "SELECT id, name, value FROM small WHERE id = ?",
+                                    DbParams { id }).result().size() == 1;
+                    });
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+
+    void prepareSchema(ParallelDbClient* client)
+    {
+        exec(client, "PRAGMA journal_mode=WAL");
+        exec(client, "CREATE TABLE small (id INTEGER PRIMARY KEY, name TEXT, value REAL)");
+        exec(client, "CREATE TABLE big (id INTEGER PRIMARY KEY, name TEXT, value REAL, flag INTEGER)");
+        exec(client, "CREATE TABLE inserts (id INTEGER PRIMARY KEY, name TEXT, value REAL)");
+        exec(client, "CREATE TABLE blobs (id INTEGER PRIMARY KEY, data BLOB)");
+
+        QVariantList ids;
+        QVariantList names;
+        QVariantList values;
+        for (int i = 1; i <= 1000; ++i)
+        {
+            ids << i;
+            names << QString("name-%1").arg(i);
+            values << i * 0.5;
+        }
+        client->insertBatch(
+                    "INSERT INTO small (id, name, value) VALUES (?, ?, ?)",
+                    { ids, names, values }).waitForFinished();
+
+        QVariantList flags;
+        ids.clear();
+        names.clear();
+        values.clear();
+        for (int i = 1; i <= SCAN_ROWS; ++i)
+        {
+            ids << i;
+            names << QString("row-%1").arg(i);
+            values << i * 0.25;
+            flags << i % 2;
+        }
+        client->insertBatch(
+                    "INSERT INTO big (id, name, value, flag) VALUES (?, ?, ?, ?)",
+                    { ids, names, values, flags }).waitForFinished();
+    }
+
+
+    void scans(BenchRunner& runner, ParallelDbClient* client, const Options& options)
+    {
+        int repeats = qMax(1, options.iterations / 1000);
+        const QString query = "SELECT id, name, value, flag FROM big";
+
+        runner.run("sqlite.scan.select", [&](BenchRunner& r) {
+            for (int i = 0; i < repeats; ++i)
+            {
+                r.timed([&]() {
+                    return client->select(query).result().size() == SCAN_ROWS;
+                });
+                r.addOps(SCAN_ROWS);
+            }
+        }, QJsonObject { { "rows", SCAN_ROWS }, { "unit", "rows" } });
+
+        runner.run("sqlite.scan.result_set", [&](BenchRunner& r) {
+            for (int i = 0; i < repeats; ++i)
+            {
+                r.timed([&]() {
+                    return client->selectResultSet(query).result().rowCount() == SCAN_ROWS;
+                });
+                r.addOps(SCAN_ROWS);
+            }
+        }, QJsonObject { { "rows", SCAN_ROWS }, { "unit", "rows" } });
+
+        runner.run("sqlite.scan.stream", [&](BenchRunner& r) {
+            for (int i = 0; i < repeats; ++i)
+            {
+                r.timed([&]() {
+                    int rows = 0;
+                    bool succ = client->selectStream(query, [&rows](const QList<QSqlRecord>& chunk) {
+                        rows += chunk.size();
+                        return true;
+                    }).result();
+                    return succ && rows == SCAN_ROWS;
+                });
+                r.addOps(SCAN_ROWS);
+            }
+        }, QJsonObject { { "rows", SCAN_ROWS }, { "unit", "rows" } });
+    }
+
+
+    void inserts(BenchRunner& runner, ParallelDbClient* client, const Options& options)
+    {
+        const QString query = "INSERT INTO inserts (name, value) VALUES (?, ?)";
+        int rows = options.iterations;
+
+        runner.run("sqlite.insert.single", [&](BenchRunner& r) {
+            for (int i = 0; i < rows; ++i)
+            {
+                r.timed([&]() {
+                    return client->insert(query, DbParams { QString("single-%1").arg(i), i * 1.5 }).result();
+                });
+            }
+        }, QJsonObject { { "rows", rows }, { "unit", "rows" } });
+
+        const int batchSize = 500;
+        runner.run("sqlite.insert.batched", [&](BenchRunner& r) {
+            for (int offset = 0; offset < rows; offset += batchSize)
+            {
+                QVariantList names;
+                QVariantList values;
+                for (int i = offset; i < qMin(rows, offset + batchSize); ++i)
+                {
+                    names << QString("batched-%1").arg(i);
+                    values << i * 1.5;
+                }
+
+                r.timed([&]() {
+                    return client->insertBatch(query, { names, values }).result().succ;
+                });
+                r.addOps(names.size());
+            }
+        }, QJsonObject { { "rows", rows }, { "batch_size", batchSize }, { "unit", "rows" } });
+    }
+
+
+    // Sizes grow 4x from 1 KB up to the limit, fewer round trips
+    // for the large ones to keep the run time bounded
+    void blobs(BenchRunner& runner, ParallelDbClient* client, const Options& options)
+    {
+        qint64 maxBytes = qint64(options.maxBlobMb) * 1024 * 1024;
+        for (qint64 size = 1024; size <= maxBytes; size *= 4)
+        {
+            if (size * 4 > maxBytes && size < maxBytes)
+                size = maxBytes;
+
+            QByteArray data(static_cast<int>(size), 'x');
+            for (int i = 0; i < data.size(); i += 4096)
+            {
+                data[i] = static_cast<char>(i / 4096);
+            }
+
+            int repeats = static_cast<int>(qBound<qint64>(
+                        1, (qint64(256) * 1024 * 1024) / size, options.iterations / 10 + 1));
+            runner.run(QString("sqlite.blob.round_trip.%1").arg(size), [&](BenchRunner& r) {
+                for (int i = 0; i < repeats; ++i)
+                {
+                    r.timed([&]() {
+                        if (!client->insert("INSERT OR REPLACE INTO blobs (id, data) VALUES (1, ?)",
+                                            DbParams { data }).result())
+                            return false;
+
+                        QList<QSqlRecord> rows = client->select(
+                                    "SELECT data FROM blobs WHERE id = ?", DbParams { 1 }).result();
+                        return rows.size() == 1 && rows.first().value(0).toByteArray() == data;
+                    });
+                }
+            }, QJsonObject { { "bytes", size }, { "unit", "round_trips" } });
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("db_client_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                "Benchmarks of ParallelDbClient, results are written as JSON");
+    parser.addHelpOption();
+    QCommandLineOption iterationsOption(
+                "iterations", "Operations per case.", "n", "2000");
+    QCommandLineOption threadsOption(
+                "threads", "Concurrent callers and pool size.", "n",
+                QString::number(qMax(2, QThread::idealThreadCount())));
+    QCommandLineOption latencyOption(
+                "latency-ms", "Round-trip latency of the network-like driver.", "ms", "2");
+    QCommandLineOption blobOption(
+                "max-blob-mb", "Largest blob of the round-trip case.", "mb", "64");
+    QCommandLineOption outputOption(
+                "output", "Write the JSON report to a file instead of stdout.", "path");
+    parser.addOptions({ iterationsOption, threadsOption, latencyOption,
+                        blobOption, outputOption });
+    parser.process(app);
+
+    Options options;
+    options.iterations = qMax(1, parser.value(iterationsOption).toInt());
+    options.threads = qMax(1, parser.value(threadsOption).toInt());
+    options.latencyMs = qMax(0, parser.value(latencyOption).toInt());
+    options.maxBlobMb = qMax(0, parser.value(blobOption).toInt());
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+    {
+        QTextStream(stderr) << "Can not create a temporary directory" << endl;
+        return 1;
+    }
+
+    QString path = QDir(dir.path()).filePath("bench.db");
+    ParallelDbMetainfo::registerSqlDriver(
+                LATENCY_DRIVER, new LatencyDriverCreator(options.latencyMs));
+
+    ParallelDbClient* sqlite = createClient("sqlite", path, options.threads);
+    prepareSchema(sqlite);
+
+    BenchRunner runner;
+    runner.run("sqlite.select.concurrent_small", [&](BenchRunner& r) {
+        concurrentSelects(r, sqlite, options);
+    }, QJsonObject { { "threads", options.threads }, { "unit", "queries" } });
+    scans(runner, sqlite, options);
+    inserts(runner, sqlite, options);
+    blobs(runner, sqlite, options);
+
+    // Same small selects against the same file, every round trip
+    // delayed like a remote server would
+    ParallelDbClient* remote = createClient(
+                "latency", path, options.threads, LATENCY_DRIVER);
+    runner.run("latency.select.concurrent_small", [&](BenchRunner& r) {
+        concurrentSelects(r, remote, options);
+    }, QJsonObject { { "threads", options.threads },
+                     { "latency_ms", options.latencyMs },
+                     { "unit", "queries" } });
+
+    dbFactory.removeDbClient("latency");
+    dbFactory.removeDbClient("sqlite");
+
+    QJsonObject report;
+    report.insert("qt", QString(qVersion()));
+    report.insert("threads", options.threads);
+    report.insert("iterations", options.iterations);
+    report.insert("benchmarks", runner.toJson());
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QTextStream(stderr) << "Can not write " << file.fileName() << endl;
+            return 1;
+        }
+
+        file.write(json);
+    }
+    else
+    {
+        QTextStream(stdout) << json;
+    }
+
+    return 0;
+}
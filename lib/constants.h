@@ -7,6 +7,34 @@ namespace DbConstants
 {
     const QString LOCALHOST = "127.0.0.1";
     const quint16 DEFAULT_PORT = 6969;
+    const int DEFAULT_STATEMENT_CACHE_SIZE = 64;
+    const int DEFAULT_STREAM_CHUNK_SIZE = 1000;
+    const int DEFAULT_STREAM_PENDING_CHUNKS = 4;
+    const int DEFAULT_BATCH_PARAMSET_SIZE = 1000;
+    const int DEFAULT_ODBC_ROW_ARRAY_SIZE = 1000;
+    const int DEFAULT_READ_YOUR_WRITES_MS = 2000;
+    const qint64 DEFAULT_RESULT_CACHE_BYTES = 64 * 1024 * 1024;
+    const int DEFAULT_RESULT_CACHE_TTL_MS = 60000;
+    const int DEFAULT_HEALTH_CHECK_INTERVAL_MS = 30000;
+    const int DEFAULT_RETRY_INITIAL_BACKOFF_MS = 50;
+    const int DEFAULT_RETRY_MAX_BACKOFF_MS = 2000;
+    const double DEFAULT_RETRY_BUDGET_RATIO = 0.1;
+    const int DEFAULT_RETRY_BUDGET_MIN_RETRIES = 10;
+    const int DEFAULT_DNS_TTL_MS = 300000;
+    const int DEFAULT_DNS_RETRY_MS = 5000;
+    const int DEFAULT_DNS_RESOLVE_TIMEOUT_MS = 5000;
+    const int DEFAULT_DNS_LOOKUP_THREADS = 4;
+    const int DEFAULT_QUERY_TIMEOUT_MS = 0;
+    const int DEFAULT_CANCEL_POLL_MS = 50;
+    const int DEFAULT_INTERACTIVE_WEIGHT = 8;
+    const int DEFAULT_NORMAL_WEIGHT = 4;
+    const int DEFAULT_BULK_WEIGHT = 1;
+    const int DEFAULT_CURSOR_IDLE_MS = 60000;
+    const int DEFAULT_CURSOR_SWEEP_MS = 10000;
+    const int DEFAULT_IMPORT_READ_BYTES = 1024 * 1024;
+    const int DEFAULT_BLOB_CHUNK_BYTES = 64 * 1024;
+    // Wait of a blob write for more data of a sequential source
+    const int DEFAULT_BLOB_READ_TIMEOUT_MS = 30000;
 }
 
 #endif // CONSTANTS_H
@@ -0,0 +1,30 @@
+#ifndef DBBATCHRESULT_H
+#define DBBATCHRESULT_H
+
+#include <QList>
+#include <QSqlError>
+#include <QString>
+
+// Outcome of insertBatch()/updateBatch(). failedRows holds indices
+// of rows (within the submitted columns) that were not applied.
+// error is the driver error of the first failure, with its native code
+// (the SQLSTATE on ODBC) for the retry policy. attempts counts
+// executions, including retries. Calls returning other results report
+// their attempts through queryRetried()/queryFailed() only.
+struct DbBatchResult
+{
+    bool succ = false;
+    qint64 rowsAffected = 0;
+    QList<int> failedRows;
+    QString errorText;
+    QSqlError error;
+    int attempts = 1;
+
+    void setError(const QSqlError& driverError)
+    {
+        error = driverError;
+        errorText = driverError.text().trimmed();
+    }
+};
+
+#endif // DBBATCHRESULT_H
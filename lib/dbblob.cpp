@@ -0,0 +1,96 @@
+#include "dbblob.h"
+#include "dbconnection.h"
+
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+
+QString DbBlob::selectQuery(const QSqlDatabase& db, const DbBlobLocation& location)
+{
+    QString table = db.driver()->escapeIdentifier(location.table, QSqlDriver::TableName);
+    QString column = db.driver()->escapeIdentifier(location.column, QSqlDriver::FieldName);
+    QString key = db.driver()->escapeIdentifier(location.keyColumn, QSqlDriver::FieldName);
+    return "SELECT " + column + " FROM " + table + " WHERE " + key + " = ?";
+}
+
+
+// Blob is bound as the first, the key as the second parameter
+QString DbBlob::updateQuery(const QSqlDatabase& db, const DbBlobLocation& location)
+{
+    QString table = db.driver()->escapeIdentifier(location.table, QSqlDriver::TableName);
+    QString column = db.driver()->escapeIdentifier(location.column, QSqlDriver::FieldName);
+    QString key = db.driver()->escapeIdentifier(location.keyColumn, QSqlDriver::FieldName);
+    return "UPDATE " + table + " SET " + column + " = ? WHERE " + key + " = ?";
+}
+
+
+// Chunk read from the database into the target device
+bool DbBlob::write(QIODevice* target, const char* data, qint64 size, DbBlobResult& result)
+{
+    if (target->write(data, size) != size)
+    {
+        result.errorText = target->errorString();
+        return false;
+    }
+
+    result.bytes += size;
+    return true;
+}
+
+
+// Drivers without chunked access: the value is held in memory once
+DbBlobResult DbBlob::readValue(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* target)
+{
+    DbBlobResult ans;
+    QSqlQuery query = connection.statement(selectQuery(connection.database(), location));
+    query.bindValue(0, location.key);
+
+    if (!connection.exec(query))
+    {
+        ans.errorText = query.lastError().text();
+    }
+    else if (!query.next())
+    {
+        ans.errorText = "No row with the blob key";
+    }
+    else if (query.isNull(0))
+    {
+        ans.null = true;
+    }
+    else
+    {
+        QByteArray value = query.value(0).toByteArray();
+        write(target, value.constData(), value.size(), ans);
+    }
+
+    connection.finish(query);
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
+
+
+DbBlobResult DbBlob::writeValue(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* source)
+{
+    DbBlobResult ans;
+    QByteArray value = source->readAll();
+    QSqlQuery query = connection.statement(updateQuery(connection.database(), location));
+    query.bindValue(0, value, QSql::In | QSql::Binary);
+    query.bindValue(1, location.key);
+
+    if (!connection.exec(query))
+        ans.errorText = query.lastError().text();
+    else if (query.numRowsAffected() == 0)
+        ans.errorText = "No row with the blob key";
+    else
+        ans.bytes = value.size();
+
+    connection.finish(query);
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
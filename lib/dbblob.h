@@ -0,0 +1,46 @@
+#ifndef DBBLOB_H
+#define DBBLOB_H
+
+#include <QIODevice>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariant>
+
+class DbConnection;
+
+// Row and column of a blob streamed by readBlob()/writeBlob().
+// The key has to select exactly one row.
+struct DbBlobLocation
+{
+    QString table;
+    QString column;
+    QString keyColumn;
+    QVariant key;
+};
+
+// Outcome of readBlob()/writeBlob(). A NULL blob reads as null,
+// without bytes.
+struct DbBlobResult
+{
+    bool succ = false;
+    bool null = false;
+    qint64 bytes = 0;
+    QString errorText;
+};
+
+namespace DbBlob
+{
+    QString selectQuery(const QSqlDatabase& db, const DbBlobLocation& location);
+    QString updateQuery(const QSqlDatabase& db, const DbBlobLocation& location);
+    bool write(QIODevice* target, const char* data, qint64 size, DbBlobResult& result);
+    DbBlobResult readValue(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* target);
+    DbBlobResult writeValue(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* source);
+}
+
+#endif // DBBLOB_H
@@ -1,4 +1,5 @@
 #include "dbconfig.h"
+#include "dbhostcache.h"
 
 DbConfig::DbConfig()
 {
@@ -38,12 +39,14 @@ DbConfig::DbConfig(
 DbConfig& DbConfig::operator=(const DbConfig& conf)
 {
     mEngine = conf.getDbEngine();
-    mIp = conf.getIp();
+    mIp = conf.mIp;
+    mDomain = conf.getDomain();
     mPort = conf.getPort();
     mDbname = conf.getDbname();
     mUsername = conf.getUsername();
     mPassword = conf.getPassword();
     mOdbcName = conf.getOdbcName();
+    mDriver = conf.mDriver;
 
     return *this;
 }
@@ -66,29 +69,27 @@ void DbConfig::initDbDrivers()
 
 QString DbConfig::getDbDriver()
 {
+    if (!mDriver.isEmpty())
+        return mDriver;
+
     return mDrivers.value(mEngine);
 }
 
 
+// Host names are only looked up in the background here, a connection
+// waits for the address when it is opened
 void DbConfig::setIp(const QString& domain)
 {
-    QHostInfo hi = QHostInfo::fromName(domain);
-    if (verifyDomain(domain))
-    {
-        mIp = hi.addresses().first();
-        if (isDomainAddress(domain))
-        {
-            mDomain = domain;
-        }
-        else
-        {
-            mDomain = QString();
-        }
-    }
-    else
+    QHostAddress ip;
+    if (ip.setAddress(domain))
     {
-        setIp(QHostAddress(DbConstants::LOCALHOST));
+        setIp(ip);
+        return;
     }
+
+    mIp = QHostAddress(DbConstants::LOCALHOST);
+    mDomain = domain;
+    DbHostCache::getInstance().prefetch(domain);
 }
 
 
@@ -99,18 +100,23 @@ void DbConfig::setIp(const QHostAddress& ip)
 }
 
 
-bool DbConfig::isDomainAddress(const QString& value)
+QHostAddress DbConfig::getIp() const
 {
-    QList<QString> list = value.split(".");
-    if (list.length() != 4)
-        return true;
+    if (mDomain.isEmpty())
+        return mIp;
+
+    QHostAddress ip = DbHostCache::getInstance().lookup(mDomain);
+    return ip.isNull() ? mIp : ip;
+}
+
 
-    QRegExp re("\\d*");
-    QString sequence = list.join("");
-    if (!re.exactMatch(sequence))
-        return true;
+QHostAddress DbConfig::resolveIp(int timeoutMs) const
+{
+    if (mDomain.isEmpty())
+        return mIp;
 
-    return false;
+    QHostAddress ip = DbHostCache::getInstance().resolve(mDomain, timeoutMs);
+    return ip.isNull() ? mIp : ip;
 }
 
 
@@ -118,24 +124,17 @@ bool DbConfig::verifyDomain(const QString& name)
 {
     bool succ = true;
 
-    QHostInfo hi = QHostInfo::fromName(name);
-    if (hi.addresses().isEmpty())
-    {
-        switch (hi.error())
-        {
-        case QHostInfo::NoError:
-            qDebug() << "No error, no address, is it possible... WTF?!";
-            break;
-        case QHostInfo::HostNotFound:
-        case QHostInfo::UnknownError:
-            emit hostError("WARNING: " + name +
-                           "domain name or IP is not valid.",
-                           hi.errorString());
-            break;
-        //default:
-        //    break;
-        }
+    QHostAddress ip;
+    if (ip.setAddress(name))
+        return succ;
 
+    // Shares the lookup started by setIp() instead of a second one
+    DbHostCache& hosts = DbHostCache::getInstance();
+    if (hosts.resolve(name, DbConstants::DEFAULT_DNS_RESOLVE_TIMEOUT_MS).isNull())
+    {
+        emit hostError("WARNING: " + name +
+                       " domain name or IP is not valid.",
+                       hosts.errorString(name));
         succ = false;
     }
 
@@ -41,9 +41,12 @@ public:
     void setUsername(const QString& username) { this->mUsername = username; }
     void setPassword(const QString& password) { this->mPassword = password; }
     void setOdbcName(const QString& odbcName) { this->mOdbcName = odbcName; }
+    void setDbDriver(const QString& driver) { this->mDriver = driver; }
 
     DbEngine getDbEngine() const { return mEngine; }
-    QHostAddress getIp() const { return mIp; }
+    QHostAddress getIp() const;
+    QHostAddress resolveIp(
+            int timeoutMs = DbConstants::DEFAULT_DNS_RESOLVE_TIMEOUT_MS) const;
     QString getDomain() const { return mDomain; }
     quint16 getPort() const { return mPort; }
     QString getDbname() const { return mDbname; }
@@ -56,7 +59,6 @@ public:
 
 private:
     void initDbDrivers();
-    bool isDomainAddress(const QString& value);
 
     DbEngine mEngine;
     QHostAddress mIp;
@@ -66,6 +68,9 @@ private:
     QString mPassword;
     QString mOdbcName;
     QMap<DbEngine, QString> mDrivers;
+    // Overrides the driver of the engine, e.g. a registered custom one
+    QString mDriver;
+    // Resolved through DbHostCache, mIp is used until it is
     QString mDomain;
 
 signals:
@@ -0,0 +1,440 @@
+#include "dbconnection.h"
+#include "dbodbc.h"
+
+#include <QSqlDriver>
+#include <QSqlResult>
+
+// Only a system SQLite, also used by Qt's driver, may be called directly
+// on the driver's handle. Qt's bundled copy is a separate library.
+#ifdef DB_SYSTEM_SQLITE
+#include <sqlite3.h>
+#endif
+
+namespace
+{
+    // Handles are handed out by QSqlDriver/QSqlResult::handle()
+    // as pointers wrapped in a named meta type
+    void* nativeHandle(QVariant handle, const char* typeName)
+    {
+        if (!handle.isValid() || qstrcmp(handle.typeName(), typeName) != 0)
+            return nullptr;
+
+        return *static_cast<void**>(handle.data());
+    }
+}
+
+DbConnection::DbConnection(
+        const QString& connectionName,
+        DbConfig& config,
+        int statementCacheSize,
+        DbStatementCacheStats* statementCacheStats,
+        DbMetrics* metrics)
+    : mConnectionName(connectionName),
+    mStatements(statementCacheSize, statementCacheStats),
+    mDeferErrors(false),
+    mRetryDelayMs(-1),
+    mMetrics(metrics),
+    mCurrentStatement(nullptr),
+    mDeadline(QDeadlineTimer::Forever),
+    mCancelled(false),
+    mDeadlineExceeded(false),
+    mStatementActive(false),
+    mOdbcStatement(nullptr),
+    mSqliteHandle(nullptr),
+    mInterruptUnsupported(false)
+{
+    mConfig = config;
+    QSqlDatabase db = QSqlDatabase::contains(mConnectionName)
+            ? QSqlDatabase::database(mConnectionName, false)
+            : QSqlDatabase::addDatabase(config.getDbDriver(), mConnectionName);
+    configure(db, config);
+}
+
+
+DbConnection::~DbConnection()
+{
+    close();
+    QSqlDatabase::removeDatabase(mConnectionName);
+}
+
+
+QSqlDatabase DbConnection::database() const
+{
+    return QSqlDatabase::database(mConnectionName, false);
+}
+
+
+bool DbConnection::open()
+{
+    QSqlDatabase db = database();
+    if (!db.isOpen())
+    {
+        if (!db.open())
+            return false;
+
+        if (mMetrics)
+            mMetrics->connectionOpened();
+
+        // MySQL statements are killed by the id of the server thread,
+        // from a second connection
+        QString threadId;
+        if (db.driverName().startsWith("QMYSQL"))
+        {
+            QSqlQuery query(db);
+            if (query.exec("SELECT CONNECTION_ID()") && query.next())
+                threadId = query.value(0).toString();
+        }
+
+        QMutexLocker locker(&mCancelMutex);
+        mSqliteHandle = nativeHandle(db.driver()->handle(), "sqlite3*");
+        mServerThreadId = threadId;
+    }
+
+    return true;
+}
+
+
+void DbConnection::close()
+{
+    {
+        QMutexLocker locker(&mCancelMutex);
+        mStatementActive = false;
+        mOdbcStatement = nullptr;
+        mSqliteHandle = nullptr;
+        mServerThreadId = QString();
+    }
+
+    // Prepared statements do not survive the connection
+    mStatements.clear();
+
+    // Block scope, so the handle is released before removeDatabase()
+    {
+        QSqlDatabase db = database();
+        if (db.isOpen())
+        {
+            db.close();
+            if (mMetrics)
+                mMetrics->connectionClosed();
+        }
+    }
+}
+
+
+bool DbConnection::isOpen() const
+{
+    return database().isOpen();
+}
+
+
+// Cheap liveness check. ODBC drivers know a broken connection without
+// a round trip, other drivers (SQLite, MySQL) run a trivial query.
+bool DbConnection::ping()
+{
+    QSqlDatabase db = database();
+    if (!db.isOpen())
+        return false;
+
+    SQLHDBC hdbc = DbOdbc::connectionHandle(db);
+    if (hdbc != nullptr)
+    {
+        SQLUINTEGER dead = SQL_CD_FALSE;
+        SQLRETURN retcode = SQLGetConnectAttr(
+                    hdbc,
+                    SQL_ATTR_CONNECTION_DEAD,
+                    static_cast<SQLPOINTER>(&dead),
+                    static_cast<SQLINTEGER>(sizeof (dead)),
+                    nullptr);
+        if (SQL_SUCCEEDED(retcode))
+            return dead == SQL_CD_FALSE;
+    }
+
+    QSqlQuery query(db);
+    bool alive = query.exec("SELECT 1");
+    query.finish();
+    return alive;
+}
+
+
+bool DbConnection::reconnect()
+{
+    close();
+    if (!mConfig.getDomain().isEmpty())
+    {
+        QSqlDatabase db = database();
+        configure(db, mConfig);
+    }
+
+    return open();
+}
+
+
+QSqlError DbConnection::lastError() const
+{
+    return database().lastError();
+}
+
+
+// Prepared (and possibly cached) statement, ready for binding and exec().
+// Call finish() on it when done, so it can be reused.
+QSqlQuery DbConnection::statement(const QString& queryString)
+{
+    if (!mMetrics)
+        return mStatements.statement(database(), queryString);
+
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery query = mStatements.statement(database(), queryString);
+    qint64 us = timer.nsecsElapsed() / 1000;
+
+    mCurrentStatement = mMetrics->statement(queryString);
+    mMetrics->total().prepare.observe(us);
+    mCurrentStatement->prepare.observe(us);
+    return query;
+}
+
+
+// exec() and finish() of the statement, timed when metrics are collected.
+// Fetch time runs from the end of exec() to finish().
+bool DbConnection::exec(QSqlQuery& query)
+{
+    if (!beginStatement(nativeHandle(query.result()->handle(), "SQLHANDLE")))
+        return false;
+
+    if (!mMetrics)
+        return query.exec();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool succ = query.exec();
+    qint64 us = timer.nsecsElapsed() / 1000;
+
+    mMetrics->total().exec.observe(us);
+    if (mCurrentStatement)
+        mCurrentStatement->exec.observe(us);
+
+    mFetchTimer.start();
+    return succ;
+}
+
+
+bool DbConnection::execBatch(QSqlQuery& query)
+{
+    if (!beginStatement(nativeHandle(query.result()->handle(), "SQLHANDLE")))
+        return false;
+
+    if (!mMetrics)
+        return query.execBatch();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool succ = query.execBatch();
+    qint64 us = timer.nsecsElapsed() / 1000;
+
+    mMetrics->total().exec.observe(us);
+    if (mCurrentStatement)
+        mCurrentStatement->exec.observe(us);
+
+    return succ;
+}
+
+
+void DbConnection::finish(QSqlQuery& query)
+{
+    endStatement();
+    query.finish();
+    if (!mMetrics || !mFetchTimer.isValid())
+        return;
+
+    qint64 us = mFetchTimer.nsecsElapsed() / 1000;
+    mFetchTimer.invalidate();
+    mMetrics->total().fetch.observe(us);
+    if (mCurrentStatement)
+        mCurrentStatement->fetch.observe(us);
+}
+
+
+// Called by the pool before every task, the state of the previous
+// one must not leak into it
+void DbConnection::startTask(const QDeadlineTimer& deadline)
+{
+    QMutexLocker locker(&mCancelMutex);
+    mDeadline = deadline;
+    mCancelled = deadline.hasExpired();
+    mDeadlineExceeded = mCancelled;
+    mStatementActive = false;
+    mOdbcStatement = nullptr;
+    mInterruptUnsupported = false;
+    mQueryError = QSqlError();
+    mRetryDelayMs = -1;
+}
+
+
+// Interrupts the running statement on the server. Statements the task
+// tries to run afterwards fail without reaching the server.
+bool DbConnection::cancel(bool deadlineExceeded)
+{
+    QMutexLocker locker(&mCancelMutex);
+    if (mCancelled)
+        return false;
+
+    mCancelled = true;
+    mDeadlineExceeded = deadlineExceeded;
+    if (!mStatementActive)
+        return true;
+
+    QString threadId = interrupt();
+    if (!threadId.isEmpty())
+    {
+        // Connecting may take long, the worker's own endStatement()
+        // must not wait for it. KILL QUERY of a statement that ended
+        // meanwhile does nothing.
+        QString connectionName = mConnectionName;
+        DbConfig config = mConfig;
+        locker.unlock();
+        killQuery(connectionName, config, threadId);
+    }
+
+    return true;
+}
+
+
+bool DbConnection::isCancelled() const
+{
+    QMutexLocker locker(&mCancelMutex);
+    return mCancelled;
+}
+
+
+// SQLSTATEs of ODBC: HYT00 timeout expired, HY008 operation cancelled
+QSqlError DbConnection::cancelError() const
+{
+    QMutexLocker locker(&mCancelMutex);
+    QString text = mDeadlineExceeded ? "Query deadline exceeded" : "Query cancelled";
+    if (mInterruptUnsupported)
+    {
+        text += ", the SQLite statement ran to its end: interrupting it needs "
+                "Qt built with system SQLite";
+    }
+
+    return QSqlError(
+                QString(),
+                text,
+                QSqlError::StatementError,
+                mDeadlineExceeded ? "HYT00" : "HY008");
+}
+
+
+bool DbConnection::beginStatement(void* odbcStatement)
+{
+    QMutexLocker locker(&mCancelMutex);
+    if (mCancelled)
+        return false;
+
+    mStatementActive = true;
+    mOdbcStatement = odbcStatement;
+    return true;
+}
+
+
+bool DbConnection::resume(QSqlQuery& query)
+{
+    return beginStatement(nativeHandle(query.result()->handle(), "SQLHANDLE"));
+}
+
+
+// After this a late cancel() can not hit the next statement
+void DbConnection::endStatement()
+{
+    QMutexLocker locker(&mCancelMutex);
+    mStatementActive = false;
+    mOdbcStatement = nullptr;
+}
+
+
+// Called with mCancelMutex held, the statement can not end meanwhile.
+// Returns the server thread to kill, that is done after the lock is
+// released.
+QString DbConnection::interrupt()
+{
+    if (mOdbcStatement != nullptr)
+    {
+        SQLCancel(static_cast<SQLHSTMT>(mOdbcStatement));
+    }
+    else if (mSqliteHandle != nullptr)
+    {
+#ifdef DB_SYSTEM_SQLITE
+        sqlite3_interrupt(static_cast<sqlite3*>(mSqliteHandle));
+#else
+        mInterruptUnsupported = true;
+#endif
+    }
+    else if (!mServerThreadId.isEmpty())
+    {
+        return mServerThreadId;
+    }
+
+    return QString();
+}
+
+
+// Short-lived connection of the calling thread, the busy one
+// can not be used for it
+void DbConnection::killQuery(
+        const QString& connectionName,
+        DbConfig config,
+        const QString& threadId)
+{
+    QString killName = connectionName + "#kill";
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(
+                    config.getDbDriver(), killName);
+        configure(db, config);
+        if (db.open())
+        {
+            QSqlQuery query(db);
+            query.exec("KILL QUERY " + threadId);
+        }
+
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(killName);
+}
+
+
+void DbConnection::configure(QSqlDatabase& db, DbConfig& config)
+{
+    if (config.getDbEngine() == DbConfig::DbEngine::SQLITE)
+    {
+        // TODO: What if sqlite is secured?!
+        db.setDatabaseName(config.getDbname());
+    }
+    else if (config.getDbEngine() == DbConfig::DbEngine::MYSQL)
+    {
+        db.setHostName(config.resolveIp().toString());
+        db.setPort(config.getPort());
+        db.setDatabaseName(config.getDbname());
+        db.setUserName(config.getUsername());
+        db.setPassword(config.getPassword());
+    }
+    else if (config.getDbEngine() == DbConfig::DbEngine::MSSQL_SQLAUTH)
+    {
+        db.setDatabaseName(
+                    QString("DRIVER={%1};SERVER=%2,%3;DATABASE=%4;UID=%5;PWD=%6")
+                    .arg(config.getOdbcName())
+                    .arg(config.resolveIp().toString())
+                    .arg(config.getPort())
+                    .arg(config.getDbname())
+                    .arg(config.getUsername())
+                    .arg(config.getPassword()));
+    }
+    else if (config.getDbEngine() == DbConfig::DbEngine::MSSQL_WINAUTH)
+    {
+        db.setDatabaseName(
+                    QString("DRIVER={%1};SERVER=%2,%3;DATABASE=%4")
+                    .arg(config.getOdbcName())
+                    .arg(config.resolveIp().toString())
+                    .arg(config.getPort())
+                    .arg(config.getDbname()));
+    }
+}
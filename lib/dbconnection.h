@@ -0,0 +1,111 @@
+#ifndef DBCONNECTION_H
+#define DBCONNECTION_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include "dbconfig.h"
+#include "dbmetrics.h"
+#include "dbstatementcache.h"
+
+// One physical database connection. QSqlDatabase connections can
+// only be used from the thread that created them, so a DbConnection
+// has to be created, used and destroyed by one and the same thread.
+class LIBSHARED_EXPORT DbConnection
+{
+public:
+    DbConnection(
+            const QString& connectionName,
+            DbConfig& config,
+            int statementCacheSize = 0,
+            DbStatementCacheStats* statementCacheStats = nullptr,
+            DbMetrics* metrics = nullptr);
+    ~DbConnection();
+    DbConnection(const DbConnection&) = delete;
+    void operator=(const DbConnection&) = delete;
+
+    QString getConnectionName() const { return mConnectionName; }
+    QSqlDatabase database() const;
+    bool open();
+    void close();
+    bool isOpen() const;
+    bool ping();
+    bool reconnect();
+    QSqlError lastError() const;
+    QSqlQuery statement(const QString& queryString);
+    bool exec(QSqlQuery& query);
+    bool execBatch(QSqlQuery& query);
+    void finish(QSqlQuery& query);
+    DbMetrics* metrics() const { return mMetrics; }
+    DbStatementMetrics* currentStatement() const { return mCurrentStatement; }
+    void setCurrentStatement(DbStatementMetrics* statement)
+    {
+        mCurrentStatement = statement;
+    }
+    // Error of the last failed statement, kept for retries
+    void setQueryError(const QSqlError& error) { mQueryError = error; }
+    QSqlError queryError() const { return mQueryError; }
+    void setDeferErrors(bool defer) { mDeferErrors = defer; }
+    bool isDeferringErrors() const { return mDeferErrors; }
+    // Asked for by a failed task, its pool queues it again after
+    // delayMs instead of reporting the result. Reset by startTask().
+    void requestRetry(int delayMs) { mRetryDelayMs = delayMs; }
+    int retryDelay() const { return mRetryDelayMs; }
+    // Cancellation of the running task, cancel() may be called from
+    // any thread. Statements run between beginStatement() and
+    // endStatement(), exec() and finish() do that on their own.
+    void startTask(const QDeadlineTimer& deadline);
+    QDeadlineTimer deadline() const { return mDeadline; }
+    bool cancel(bool deadlineExceeded);
+    bool isCancelled() const;
+    QSqlError cancelError() const;
+    bool beginStatement(void* odbcStatement = nullptr);
+    void endStatement();
+    // Statement left open by an earlier task, e.g. a cursor
+    bool resume(QSqlQuery& query);
+
+    static void configure(QSqlDatabase& db, DbConfig& config);
+
+private:
+    QString interrupt();
+    static void killQuery(
+            const QString& connectionName,
+            DbConfig config,
+            const QString& threadId);
+
+    QString mConnectionName;
+    // Re-applied on reconnect, a host name may resolve differently
+    DbConfig mConfig;
+    DbStatementCache mStatements;
+    QSqlError mQueryError;
+    bool mDeferErrors;
+    int mRetryDelayMs;
+    DbMetrics* mMetrics;
+    DbStatementMetrics* mCurrentStatement;
+    QElapsedTimer mFetchTimer;
+    QDeadlineTimer mDeadline;
+    // Guarded by mCancelMutex, the native handles are only valid
+    // while the connection is open
+    bool mCancelled;
+    bool mDeadlineExceeded;
+    bool mStatementActive;
+    void* mOdbcStatement;
+    void* mSqliteHandle;
+    // Set when a running SQLite statement could not be interrupted
+    bool mInterruptUnsupported;
+    QString mServerThreadId;
+
+    mutable QMutex mCancelMutex;
+};
+
+#endif // DBCONNECTION_H
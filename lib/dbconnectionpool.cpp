@@ -0,0 +1,763 @@
+#include "dbconnectionpool.h"
+#include "dbpoolworker.h"
+#include "dbquerywatchdog.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+DbConnectionPool::DbConnectionPool(
+        const QString& connectionName,
+        const DbConfig& config,
+        int minSize,
+        int maxSize,
+        QObject* parent)
+    : QObject(parent),
+    mConnectionName(connectionName),
+    mGeneration(1),
+    mMinSize(1),
+    mMaxSize(1),
+    mActiveCount(0),
+    mMaxQueueDepth(0),
+    mOverflowPolicy(OverflowPolicy::BLOCK),
+    mStatementCacheSize(0),
+    mHealthCheckIntervalMs(0),
+    mHealthRound(0),
+    mMetrics(nullptr),
+    mNextWorkerId(0),
+    mStopping(false),
+    mTasks(Priority::BULK + 1),
+    mCredits(Priority::BULK + 1, 0),
+    mQueued(0),
+    mMaxBulkWorkers(0),
+    mCallerBulkTasks(0),
+    mWatchdog(new DbQueryWatchdog())
+{
+    mWeights << DbConstants::DEFAULT_INTERACTIVE_WEIGHT
+             << DbConstants::DEFAULT_NORMAL_WEIGHT
+             << DbConstants::DEFAULT_BULK_WEIGHT;
+    // DbConfig is a QObject, it can not be copied in list initialization
+    mConfig = config;
+    mClock.start();
+    setSize(minSize, maxSize);
+}
+
+
+DbConnectionPool::~DbConnectionPool()
+{
+    stop();
+    delete mWatchdog;
+}
+
+
+// Workers drain the queue before they finish, so every future handed
+// out gets its result. Tasks queued once stopping started are rejected,
+// run() and runPinned() finish their futures with a default result.
+// Has to be called from outside the pool's own workers.
+void DbConnectionPool::stop()
+{
+    QList<DbPoolWorker*> workers;
+    {
+        QMutexLocker locker(&mMutex);
+        mStopping = true;
+        mTaskAvailable.wakeAll();
+        mSpaceAvailable.wakeAll();
+        workers = mWorkers;
+    }
+
+    for (DbPoolWorker* worker : workers)
+    {
+        worker->wait();
+    }
+
+    QMutexLocker locker(&mMutex);
+    qDeleteAll(mWorkers);
+    mWorkers.clear();
+}
+
+
+// Deleter of shared pools. The last reference may be dropped by a task
+// on one of the pool's own workers, which can not wait for itself.
+void DbConnectionPool::destroy(DbConnectionPool* pool)
+{
+    if (pool->isWorkerThread())
+        QtConcurrent::run([pool]() { delete pool; });
+    else
+        delete pool;
+}
+
+
+void DbConnectionPool::setConnectionName(const QString& connectionName)
+{
+    QMutexLocker locker(&mMutex);
+    mConnectionName = connectionName;
+    ++mGeneration;
+}
+
+
+void DbConnectionPool::setDbConfig(const DbConfig& config)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig = config;
+    ++mGeneration;
+}
+
+
+void DbConnectionPool::setSize(int minSize, int maxSize)
+{
+    QMutexLocker locker(&mMutex);
+    mMinSize = qMax(1, minSize);
+    mMaxSize = qMax(mMinSize, maxSize);
+
+    while (mWorkers.size() < mMinSize && !mStopping)
+    {
+        spawnWorker();
+    }
+}
+
+
+// 0 means unbounded queue
+void DbConnectionPool::setMaxQueueDepth(int depth)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxQueueDepth = qMax(0, depth);
+    mSpaceAvailable.wakeAll();
+}
+
+
+void DbConnectionPool::setOverflowPolicy(OverflowPolicy policy)
+{
+    QMutexLocker locker(&mMutex);
+    mOverflowPolicy = policy;
+    mSpaceAvailable.wakeAll();
+}
+
+
+// Workers re-create their connections (and caches) with the new size
+void DbConnectionPool::setStatementCacheSize(int size)
+{
+    QMutexLocker locker(&mMutex);
+    mStatementCacheSize = qMax(0, size);
+    ++mGeneration;
+}
+
+
+// Metrics are not owned by the pool, they have to outlive it
+void DbConnectionPool::setMetrics(DbMetrics* metrics)
+{
+    QMutexLocker locker(&mMutex);
+    mMetrics = metrics;
+    ++mGeneration;
+}
+
+
+// Share of picks each class gets while all of them have queued tasks,
+// a class with weight 8 is picked 8 times as often as one with 1
+void DbConnectionPool::setPriorityWeights(int interactive, int normal, int bulk)
+{
+    QMutexLocker locker(&mMutex);
+    mWeights[Priority::INTERACTIVE] = qMax(1, interactive);
+    mWeights[Priority::NORMAL] = qMax(1, normal);
+    mWeights[Priority::BULK] = qMax(1, bulk);
+    mCredits.fill(0);
+}
+
+
+// 0 means half of the maximum pool size. The other workers stay
+// free for interactive and normal tasks.
+void DbConnectionPool::setMaxBulkWorkers(int workers)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxBulkWorkers = qMax(0, workers);
+    mTaskAvailable.wakeAll();
+}
+
+
+// 0 disables periodic checks. A worker checks its connection
+// after being idle for intervalMs.
+void DbConnectionPool::setHealthCheckInterval(int intervalMs)
+{
+    QMutexLocker locker(&mMutex);
+    mHealthCheckIntervalMs = qMax(0, intervalMs);
+    mTaskAvailable.wakeAll();
+}
+
+
+// Every idle worker opens or validates its connection now,
+// workers spawned later do it as soon as they are idle
+void DbConnectionPool::checkConnections()
+{
+    QMutexLocker locker(&mMutex);
+    ++mHealthRound;
+    mTaskAvailable.wakeAll();
+}
+
+
+QString DbConnectionPool::getConnectionName() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConnectionName;
+}
+
+
+int DbConnectionPool::getMinSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMinSize;
+}
+
+
+int DbConnectionPool::getMaxSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMaxSize;
+}
+
+
+int DbConnectionPool::getMaxQueueDepth() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMaxQueueDepth;
+}
+
+
+DbConnectionPool::OverflowPolicy DbConnectionPool::getOverflowPolicy() const
+{
+    QMutexLocker locker(&mMutex);
+    return mOverflowPolicy;
+}
+
+
+int DbConnectionPool::getStatementCacheSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mStatementCacheSize;
+}
+
+
+int DbConnectionPool::getHealthCheckInterval() const
+{
+    QMutexLocker locker(&mMutex);
+    return mHealthCheckIntervalMs;
+}
+
+
+int DbConnectionPool::getPriorityWeight(Priority priority) const
+{
+    QMutexLocker locker(&mMutex);
+    return mWeights.value(priority);
+}
+
+
+int DbConnectionPool::getMaxBulkWorkers() const
+{
+    QMutexLocker locker(&mMutex);
+    return maxBulkWorkers();
+}
+
+
+const DbStatementCacheStats& DbConnectionPool::statementCacheStats() const
+{
+    return mStatementCacheStats;
+}
+
+
+int DbConnectionPool::size() const
+{
+    QMutexLocker locker(&mMutex);
+    return mWorkers.size();
+}
+
+
+int DbConnectionPool::queueDepth() const
+{
+    QMutexLocker locker(&mMutex);
+    return mQueued;
+}
+
+
+int DbConnectionPool::queueDepth(Priority priority) const
+{
+    QMutexLocker locker(&mMutex);
+    return mTasks.value(priority).size();
+}
+
+
+int DbConnectionPool::activeCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mActiveCount;
+}
+
+
+int DbConnectionPool::bulkCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mBulkWorkers.size();
+}
+
+
+// The queue depth limit is shared by all priority classes. Tasks queued
+// by the pool's own workers do not block on a full queue, the worker
+// could be the one that would have to drain it.
+bool DbConnectionPool::enqueue(const Task& task, Priority priority)
+{
+    QMutexLocker locker(&mMutex);
+    if (mStopping)
+        return false;
+
+    while (mMaxQueueDepth > 0 &&
+           mQueued >= mMaxQueueDepth &&
+           !mStopping)
+    {
+        if (mOverflowPolicy == OverflowPolicy::REJECT)
+        {
+            int depth = mQueued;
+            locker.unlock();
+            emit taskRejected(depth);
+            return false;
+        }
+        else if (mOverflowPolicy == OverflowPolicy::CALLER_RUNS &&
+                 (priority != Priority::BULK ||
+                  mBulkWorkers.size() + mCallerBulkTasks < maxBulkWorkers()))
+        {
+            // Bulk work run by callers counts against the bulk limit,
+            // otherwise it waits for a slot like with BLOCK
+            bool bulk = priority == Priority::BULK;
+            if (bulk)
+                ++mCallerBulkTasks;
+
+            locker.unlock();
+            runInCallerThread(task);
+            if (bulk)
+            {
+                locker.relock();
+                --mCallerBulkTasks;
+                mTaskAvailable.wakeAll();
+                mSpaceAvailable.wakeAll();
+            }
+
+            return true;
+        }
+        else if (runsOnWorker())
+        {
+            break;
+        }
+
+        mSpaceAvailable.wait(&mMutex);
+    }
+
+    // Woken up by stop(), the workers may be gone before they see it
+    if (mStopping)
+        return false;
+
+    mTasks[priority].enqueue(task);
+    ++mQueued;
+
+    int idleUnreserved = 0;
+    for (int workerId : mIdleWorkers)
+    {
+        if (!mReserved.contains(workerId))
+            ++idleUnreserved;
+    }
+
+    if (idleUnreserved < mQueued && mWorkers.size() < mMaxSize)
+    {
+        spawnWorker();
+    }
+
+    // With reserved workers around, wakeOne() could wake one of them
+    // and the task would wait for the next wake up
+    if (mReserved.isEmpty())
+        mTaskAvailable.wakeOne();
+    else
+        mTaskAvailable.wakeAll();
+
+    return true;
+}
+
+
+// Pins a worker: prefers an idle one, then a new one, then any unreserved
+// worker (pinned tasks wait for its current task). Returns -1 when every
+// worker is already reserved and the pool can not grow, or when fewer
+// than spare workers would be left for the shared queue.
+int DbConnectionPool::reserve(int spare)
+{
+    QMutexLocker locker(&mMutex);
+    if (mStopping || mMaxSize - mReserved.size() - 1 < spare)
+        return -1;
+
+    int workerId = -1;
+    for (DbPoolWorker* worker : mWorkers)
+    {
+        if (!mReserved.contains(worker->id()) &&
+            mIdleWorkers.contains(worker->id()))
+        {
+            workerId = worker->id();
+            break;
+        }
+    }
+
+    if (workerId < 0 && mWorkers.size() < mMaxSize)
+    {
+        spawnWorker();
+        workerId = mWorkers.last()->id();
+    }
+
+    if (workerId < 0)
+    {
+        for (DbPoolWorker* worker : mWorkers)
+        {
+            if (!mReserved.contains(worker->id()))
+            {
+                workerId = worker->id();
+                break;
+            }
+        }
+    }
+
+    if (workerId >= 0)
+    {
+        mReserved.insert(workerId, false);
+    }
+
+    return workerId;
+}
+
+
+bool DbConnectionPool::enqueuePinned(int workerId, const Task& task)
+{
+    QMutexLocker locker(&mMutex);
+    if (mStopping || !mReserved.contains(workerId) || mReserved.value(workerId))
+        return false;
+
+    mPinnedTasks[workerId].enqueue(task);
+    mTaskAvailable.wakeAll();
+    return true;
+}
+
+
+// Worker returns to the shared queue after its pinned tasks are done
+void DbConnectionPool::release(int workerId)
+{
+    QMutexLocker locker(&mMutex);
+    if (mReserved.contains(workerId))
+    {
+        mReserved.insert(workerId, true);
+        mTaskAvailable.wakeAll();
+    }
+}
+
+
+// Hands out one shared task or, to a reserved worker, all of its pinned
+// tasks at once, so pipelined requests run back-to-back. Returns true
+// with no tasks when the worker is due to check its connection.
+bool DbConnectionPool::takeTasks(int workerId, QQueue<Task>& tasks)
+{
+    QMutexLocker locker(&mMutex);
+
+    mIdleWorkers.insert(workerId);
+    forever
+    {
+        queueDueTasks();
+        if (mReserved.contains(workerId))
+        {
+            QQueue<Task>& pinned = mPinnedTasks[workerId];
+            if (!pinned.isEmpty())
+            {
+                tasks.swap(pinned);
+                break;
+            }
+
+            if (mReserved.value(workerId))
+            {
+                mReserved.remove(workerId);
+                mPinnedTasks.remove(workerId);
+                continue;
+            }
+        }
+
+        // While stopping, reserved workers help to drain the shared
+        // queue, and the bulk limit no longer holds tasks back
+        if (!mReserved.contains(workerId) || mStopping)
+        {
+            int priority = nextPriority(mStopping || bulkAllowed());
+            if (priority >= 0)
+            {
+                tasks.enqueue(mTasks[priority].dequeue());
+                --mQueued;
+                if (priority == Priority::BULK)
+                    mBulkWorkers.insert(workerId);
+
+                mSpaceAvailable.wakeOne();
+                break;
+            }
+        }
+
+        if (mStopping)
+        {
+            mIdleWorkers.remove(workerId);
+            return false;
+        }
+
+        // Reserved workers are left alone, a reconnect would break
+        // the transaction running on them. Delayed retries are picked
+        // up by the others once they are due.
+        if (!mReserved.contains(workerId))
+        {
+            qint64 now = mClock.elapsed();
+            qint64 timeout = -1;
+            bool due = mCheckedRound.value(workerId) != mHealthRound;
+            if (mHealthCheckIntervalMs > 0)
+            {
+                timeout = mLastActive.value(workerId) +
+                        mHealthCheckIntervalMs - now;
+                due = due || timeout <= 0;
+            }
+
+            if (due)
+            {
+                mCheckedRound.insert(workerId, mHealthRound);
+                mLastActive.insert(workerId, now);
+                mIdleWorkers.remove(workerId);
+                return true;
+            }
+
+            if (!mDelayed.isEmpty())
+            {
+                qint64 delayed = qMax<qint64>(1, mDelayed.firstKey() - now);
+                timeout = timeout > 0 ? qMin(timeout, delayed) : delayed;
+            }
+
+            if (timeout > 0)
+            {
+                mTaskAvailable.wait(&mMutex, static_cast<unsigned long>(timeout));
+                continue;
+            }
+        }
+
+        mTaskAvailable.wait(&mMutex);
+    }
+
+    mIdleWorkers.remove(workerId);
+    mLastActive.insert(workerId, mClock.elapsed());
+    ++mActiveCount;
+    return true;
+}
+
+
+// Has to be called with mMutex locked. While stopping every delayed
+// task is due, the workers drain them with the rest of the queue.
+void DbConnectionPool::queueDueTasks()
+{
+    qint64 now = mClock.elapsed();
+    bool queued = false;
+    while (!mDelayed.isEmpty() && (mStopping || mDelayed.firstKey() <= now))
+    {
+        auto first = mDelayed.begin();
+        mTasks[first.value().first].enqueue(first.value().second);
+        mDelayed.erase(first);
+        ++mQueued;
+        queued = true;
+    }
+
+    if (queued)
+        mTaskAvailable.wakeAll();
+}
+
+
+// Queued beyond the depth limit, the task was accepted before. Not
+// taken while stopping, the task reports its last result instead.
+bool DbConnectionPool::enqueueDelayed(const Task& task, int priority, int delayMs)
+{
+    QMutexLocker locker(&mMutex);
+    if (mStopping)
+        return false;
+
+    mDelayed.insert(mClock.elapsed() + qMax(0, delayMs), qMakePair(priority, task));
+
+    // Idle workers wait for the earliest due task
+    mTaskAvailable.wakeAll();
+    return true;
+}
+
+
+// Smooth weighted round robin over the classes with queued tasks,
+// picks of a class are spread evenly instead of coming in bursts.
+// Returns -1 when nothing can be taken.
+int DbConnectionPool::nextPriority(bool bulkAllowed)
+{
+    int best = -1;
+    int total = 0;
+    for (int priority = 0; priority < mTasks.size(); ++priority)
+    {
+        if (mTasks[priority].isEmpty() ||
+                (priority == Priority::BULK && !bulkAllowed))
+            continue;
+
+        mCredits[priority] += mWeights[priority];
+        total += mWeights[priority];
+        if (best < 0 || mCredits[priority] > mCredits[best])
+            best = priority;
+    }
+
+    if (best >= 0)
+    {
+        mCredits[best] -= total;
+        // A class starts over once it runs empty
+        if (mTasks[best].size() == 1)
+            mCredits[best] = 0;
+    }
+
+    return best;
+}
+
+
+// At least one connection is always left for other work. A pool of
+// one connection has no bulk slot at all, see bulkAllowed().
+int DbConnectionPool::maxBulkWorkers() const
+{
+    if (mMaxSize < 2)
+        return 0;
+
+    int workers = mMaxBulkWorkers > 0 ? mMaxBulkWorkers : mMaxSize / 2;
+    return qBound(1, workers, mMaxSize - 1);
+}
+
+
+// Has to be called with mMutex locked. Without a bulk slot, bulk tasks
+// only run while nothing else is queued or running.
+bool DbConnectionPool::bulkAllowed() const
+{
+    int running = mBulkWorkers.size() + mCallerBulkTasks;
+    if (maxBulkWorkers() > 0)
+        return running < maxBulkWorkers();
+
+    return running == 0 && mActiveCount == 0 &&
+            mQueued == mTasks[Priority::BULK].size();
+}
+
+
+void DbConnectionPool::taskFinished(int workerId)
+{
+    QMutexLocker locker(&mMutex);
+    --mActiveCount;
+
+    // Bulk tasks may be waiting for this worker's slot, callers too
+    if (mBulkWorkers.remove(workerId))
+    {
+        if (!mTasks[Priority::BULK].isEmpty())
+            mTaskAvailable.wakeAll();
+
+        mSpaceAvailable.wakeAll();
+    }
+    else if (mMaxSize < 2 && !mTasks[Priority::BULK].isEmpty())
+    {
+        mTaskAvailable.wakeAll();
+    }
+}
+
+
+void DbConnectionPool::startWatch(
+        DbConnection& connection,
+        const QFutureInterfaceBase& future,
+        const QDeadlineTimer& deadline,
+        bool cancellable)
+{
+    connection.startTask(cancellable
+                         ? deadline
+                         : QDeadlineTimer(QDeadlineTimer::Forever));
+    if (cancellable)
+        mWatchdog->watch(&connection, future, deadline);
+}
+
+
+void DbConnectionPool::stopWatch(DbConnection& connection, bool cancellable)
+{
+    if (cancellable)
+        mWatchdog->unwatch(&connection);
+}
+
+
+// Connections are bound to threads, so the calling thread
+// gets a short-lived connection of its own
+void DbConnectionPool::runInCallerThread(const Task& task)
+{
+    QString connectionName;
+    DbConfig config;
+    int statementCacheSize = 0;
+    DbMetrics* metrics = nullptr;
+    snapshot(connectionName, config, statementCacheSize, metrics);
+
+    // Short-lived connection, caching its statements would not pay off
+    DbConnection connection(
+                QString("%1#caller-%2")
+                .arg(connectionName)
+                .arg(reinterpret_cast<quintptr>(QThread::currentThreadId())),
+                config,
+                0,
+                nullptr,
+                metrics);
+    task(connection);
+}
+
+
+quint64 DbConnectionPool::snapshot(
+        QString& connectionName,
+        DbConfig& config,
+        int& statementCacheSize,
+        DbMetrics*& metrics) const
+{
+    QMutexLocker locker(&mMutex);
+    connectionName = mConnectionName;
+    config = mConfig;
+    statementCacheSize = mStatementCacheSize;
+    metrics = mMetrics;
+    return mGeneration;
+}
+
+
+quint64 DbConnectionPool::generation() const
+{
+    QMutexLocker locker(&mMutex);
+    return mGeneration;
+}
+
+
+bool DbConnectionPool::isReserved(int workerId) const
+{
+    QMutexLocker locker(&mMutex);
+    return mReserved.contains(workerId);
+}
+
+
+bool DbConnectionPool::isWorkerThread() const
+{
+    QMutexLocker locker(&mMutex);
+    return runsOnWorker();
+}
+
+
+// Has to be called with mMutex locked
+bool DbConnectionPool::runsOnWorker() const
+{
+    for (DbPoolWorker* worker : mWorkers)
+    {
+        if (worker == QThread::currentThread())
+            return true;
+    }
+
+    return false;
+}
+
+
+// Has to be called with mMutex locked
+void DbConnectionPool::spawnWorker()
+{
+    if (mStopping)
+        return;
+
+    DbPoolWorker* worker = new DbPoolWorker(this, mNextWorkerId++);
+    mLastActive.insert(worker->id(), mClock.elapsed());
+    mWorkers.append(worker);
+    worker->start();
+}
@@ -0,0 +1,293 @@
+#ifndef DBCONNECTIONPOOL_H
+#define DBCONNECTIONPOOL_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QObject>
+#include <QDeadlineTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
+#include "dbconfig.h"
+#include "dbconnection.h"
+#include "dbmetrics.h"
+#include "dbstatementcache.h"
+
+class DbPoolWorker;
+class DbQueryWatchdog;
+
+// Pool of worker threads, each of them owning exactly one physical
+// connection opened from the same DbConfig. The pool starts with minSize
+// workers and grows up to maxSize when all of them are busy. Shared
+// tasks wait in one FIFO queue per priority class, idle workers pick the
+// next class by weighted round robin; at most maxBulkWorkers run BULK
+// tasks at once, so one connection always stays free of bulk work. When
+// a bounded queue is full, overflowPolicy blocks the caller, rejects the
+// task or runs it on the calling thread. A reserved worker leaves the
+// shared queue and runs only the tasks pinned to it, in order, until it
+// is released. With a health-check interval set, idle, unreserved
+// workers check their connections periodically and reconnect dead ones
+// before a task reaches them. Tasks of run() and runPinned() can be
+// cancelled through their futures or by a deadline; a watchdog thread
+// then cancels the running statement on the server.
+class LIBSHARED_EXPORT DbConnectionPool : public QObject
+{
+    Q_OBJECT
+    friend DbPoolWorker;
+
+public:
+    typedef std::function<void(DbConnection&)> Task;
+    enum OverflowPolicy { BLOCK, REJECT, CALLER_RUNS };
+    enum Priority { INTERACTIVE, NORMAL, BULK };
+
+    DbConnectionPool(
+            const QString& connectionName,
+            const DbConfig& config,
+            int minSize = 1,
+            int maxSize = 4,
+            QObject* parent = nullptr);
+    ~DbConnectionPool();
+    DbConnectionPool(const DbConnectionPool&) = delete;
+    void operator=(const DbConnectionPool&) = delete;
+
+    void setConnectionName(const QString& connectionName);
+    void setDbConfig(const DbConfig& config);
+    void setSize(int minSize, int maxSize);
+    void setMaxQueueDepth(int depth);
+    void setOverflowPolicy(OverflowPolicy policy);
+    void setStatementCacheSize(int size);
+    void setHealthCheckInterval(int intervalMs);
+    void setMetrics(DbMetrics* metrics);
+    void setPriorityWeights(int interactive, int normal, int bulk);
+    void setMaxBulkWorkers(int workers);
+    void checkConnections();
+    QString getConnectionName() const;
+    int getMinSize() const;
+    int getMaxSize() const;
+    int getMaxQueueDepth() const;
+    OverflowPolicy getOverflowPolicy() const;
+    int getStatementCacheSize() const;
+    int getHealthCheckInterval() const;
+    int getPriorityWeight(Priority priority) const;
+    int getMaxBulkWorkers() const;
+    const DbStatementCacheStats& statementCacheStats() const;
+    int size() const;
+    int queueDepth() const;
+    int queueDepth(Priority priority) const;
+    int activeCount() const;
+    int bulkCount() const;
+
+    void stop();
+    static void destroy(DbConnectionPool* pool);
+
+    bool enqueue(const Task& task, Priority priority = Priority::NORMAL);
+    int reserve(int spare = 0);
+    bool enqueuePinned(int workerId, const Task& task);
+    void release(int workerId);
+
+    template <typename T>
+    QFuture<T> run(
+            std::function<T(DbConnection&)> fn,
+            const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever),
+            Priority priority = Priority::NORMAL);
+    template <typename T>
+    QFuture<T> runPinned(
+            int workerId,
+            std::function<T(DbConnection&)> fn,
+            const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever),
+            bool cancellable = true);
+
+signals:
+    void taskRejected(int queueDepth);
+    void connectionStateChanged(const QString& connectionName, bool connected);
+
+private:
+    template <typename T>
+    Task watched(
+            QFutureInterface<T> promise,
+            QSharedPointer<std::function<T(DbConnection&)>> call,
+            const QDeadlineTimer& deadline,
+            bool cancellable,
+            int priority);
+    bool enqueueDelayed(const Task& task, int priority, int delayMs);
+    void queueDueTasks();
+    void startWatch(
+            DbConnection& connection,
+            const QFutureInterfaceBase& future,
+            const QDeadlineTimer& deadline,
+            bool cancellable);
+    void stopWatch(DbConnection& connection, bool cancellable);
+    bool takeTasks(int workerId, QQueue<Task>& tasks);
+    int nextPriority(bool bulkAllowed);
+    int maxBulkWorkers() const;
+    bool bulkAllowed() const;
+    void taskFinished(int workerId);
+    void runInCallerThread(const Task& task);
+    quint64 snapshot(
+            QString& connectionName,
+            DbConfig& config,
+            int& statementCacheSize,
+            DbMetrics*& metrics) const;
+    quint64 generation() const;
+    bool isReserved(int workerId) const;
+    bool isWorkerThread() const;
+    bool runsOnWorker() const;
+    void spawnWorker();
+
+    QString mConnectionName;
+    DbConfig mConfig;
+    quint64 mGeneration;
+    int mMinSize;
+    int mMaxSize;
+    int mActiveCount;
+    int mMaxQueueDepth;
+    OverflowPolicy mOverflowPolicy;
+    int mStatementCacheSize;
+    int mHealthCheckIntervalMs;
+    quint64 mHealthRound;
+    // Worker id -> last health round checked, time of last activity
+    QHash<int, quint64> mCheckedRound;
+    QHash<int, qint64> mLastActive;
+    QElapsedTimer mClock;
+    DbStatementCacheStats mStatementCacheStats;
+    DbMetrics* mMetrics;
+    int mNextWorkerId;
+    bool mStopping;
+    // Shared queue per priority class, with the weights and the
+    // round robin credits of the classes
+    QVector<QQueue<Task>> mTasks;
+    // Retries waiting for their backoff, by due time (mClock) and
+    // priority class
+    QMultiMap<qint64, QPair<int, Task>> mDelayed;
+    QVector<int> mWeights;
+    QVector<int> mCredits;
+    int mQueued;
+    int mMaxBulkWorkers;
+    // BULK tasks run by callers under CALLER_RUNS
+    int mCallerBulkTasks;
+    QSet<int> mBulkWorkers;
+    QList<DbPoolWorker*> mWorkers;
+    QSet<int> mIdleWorkers;
+    // Reserved worker id -> release requested
+    QHash<int, bool> mReserved;
+    QHash<int, QQueue<Task>> mPinnedTasks;
+    DbQueryWatchdog* mWatchdog;
+
+    mutable QMutex mMutex;
+    QWaitCondition mTaskAvailable;
+    QWaitCondition mSpaceAvailable;
+};
+
+
+// fn is moved to the heap once, queued tasks only share it,
+// so arguments bound into it are never copied on the way to the worker.
+// A task cancelled before a worker picks it up is not run at all.
+// A task asking for a retry (DbConnection::requestRetry()) is queued
+// again after the delay, its worker is free meanwhile. Pinned tasks
+// (priority -1) are never queued again.
+template <typename T>
+DbConnectionPool::Task DbConnectionPool::watched(
+        QFutureInterface<T> promise,
+        QSharedPointer<std::function<T(DbConnection&)>> call,
+        const QDeadlineTimer& deadline,
+        bool cancellable,
+        int priority)
+{
+    return [this, promise, call, deadline, cancellable, priority](
+            DbConnection& connection) mutable
+    {
+        if (cancellable && promise.isCanceled())
+        {
+            promise.reportFinished();
+            return;
+        }
+
+        startWatch(connection, promise, deadline, cancellable);
+        T ans = (*call)(connection);
+        stopWatch(connection, cancellable);
+        if (priority >= 0 && connection.retryDelay() >= 0 &&
+                enqueueDelayed(
+                    watched<T>(promise, call, deadline, cancellable, priority),
+                    priority,
+                    connection.retryDelay()))
+        {
+            return;
+        }
+
+        promise.reportResult(ans);
+        promise.reportFinished();
+    };
+}
+
+
+template <typename T>
+QFuture<T> DbConnectionPool::run(
+        std::function<T(DbConnection&)> fn,
+        const QDeadlineTimer& deadline,
+        Priority priority)
+{
+    QFutureInterface<T> promise;
+    promise.reportStarted();
+    QFuture<T> future = promise.future();
+
+    QSharedPointer<std::function<T(DbConnection&)>> call(
+                new std::function<T(DbConnection&)>(std::move(fn)));
+    bool accepted = enqueue(
+                watched<T>(promise, call, deadline, true, priority),
+                priority);
+
+    if (!accepted)
+    {
+        promise.reportResult(T());
+        promise.reportFinished();
+    }
+
+    return future;
+}
+
+
+// Transaction commands are not cancellable, skipping a COMMIT or
+// ROLLBACK would leave the transaction open on the pooled connection
+template <typename T>
+QFuture<T> DbConnectionPool::runPinned(
+        int workerId,
+        std::function<T(DbConnection&)> fn,
+        const QDeadlineTimer& deadline,
+        bool cancellable)
+{
+    QFutureInterface<T> promise;
+    promise.reportStarted();
+    QFuture<T> future = promise.future();
+
+    QSharedPointer<std::function<T(DbConnection&)>> call(
+                new std::function<T(DbConnection&)>(std::move(fn)));
+    bool accepted = enqueuePinned(
+                workerId,
+                watched<T>(promise, call, deadline, cancellable, -1));
+
+    if (!accepted)
+    {
+        promise.reportResult(T());
+        promise.reportFinished();
+    }
+
+    return future;
+}
+
+#endif // DBCONNECTIONPOOL_H
@@ -0,0 +1,92 @@
+#include "dbcsv.h"
+
+// One record without its line break. Fails on text after a closing
+// quote and on a quote left open.
+bool DbCsv::parseRecord(
+        const QByteArray& record,
+        char delimiter,
+        char quote,
+        QStringList& fields)
+{
+    fields.clear();
+    QByteArray field;
+    bool quoted = false;
+    bool closed = false;
+
+    for (int i = 0; i < record.size(); ++i)
+    {
+        char c = record.at(i);
+        if (quoted)
+        {
+            if (c != quote)
+            {
+                field.append(c);
+            }
+            else if (i + 1 < record.size() && record.at(i + 1) == quote)
+            {
+                field.append(quote);
+                ++i;
+            }
+            else
+            {
+                quoted = false;
+                closed = true;
+            }
+        }
+        else if (c == delimiter)
+        {
+            fields.append(QString::fromUtf8(field));
+            field.clear();
+            closed = false;
+        }
+        else if (closed)
+        {
+            return false;
+        }
+        else if (c == quote && field.isEmpty())
+        {
+            quoted = true;
+        }
+        else
+        {
+            field.append(c);
+        }
+    }
+
+    fields.append(QString::fromUtf8(field));
+    return !quoted;
+}
+
+
+void DbCsv::appendField(
+        QByteArray& out,
+        const QString& text,
+        char delimiter,
+        char quote)
+{
+    QByteArray field = text.toUtf8();
+    bool quoted = false;
+    for (char c : field)
+    {
+        if (c == delimiter || c == quote || c == '\n' || c == '\r')
+        {
+            quoted = true;
+            break;
+        }
+    }
+
+    if (!quoted)
+    {
+        out.append(field);
+        return;
+    }
+
+    out.append(quote);
+    for (char c : field)
+    {
+        out.append(c);
+        if (c == quote)
+            out.append(quote);
+    }
+    out.append(quote);
+}
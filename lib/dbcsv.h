@@ -0,0 +1,24 @@
+#ifndef DBCSV_H
+#define DBCSV_H
+
+#include <QByteArray>
+#include <QChar>
+#include <QStringList>
+
+// RFC 4180 fields: separated by the delimiter, quoted when they contain
+// it, the quote or a line break; quotes inside are doubled
+namespace DbCsv
+{
+    bool parseRecord(
+            const QByteArray& record,
+            char delimiter,
+            char quote,
+            QStringList& fields);
+    void appendField(
+            QByteArray& out,
+            const QString& text,
+            char delimiter,
+            char quote);
+}
+
+#endif // DBCSV_H
@@ -0,0 +1,200 @@
+#include "dbcursor.h"
+#include "paralleldbclient.h"
+#include "utils.h"
+
+bool DbCursor::State::isReleased()
+{
+    QMutexLocker locker(&mutex);
+    return workerId < 0;
+}
+
+
+// Once only, the worker may already serve someone else afterwards
+void DbCursor::State::release()
+{
+    QMutexLocker locker(&mutex);
+    if (workerId >= 0)
+    {
+        pool->release(workerId);
+        workerId = -1;
+    }
+}
+
+
+DbCursor::DbCursor(
+        ParallelDbClient* client,
+        QSharedPointer<DbConnectionPool> pool,
+        int workerId,
+        const QString& queryString,
+        DbParams params)
+    : mClient(client),
+    mState(new State),
+    mQueryString(queryString),
+    mParams(std::move(params))
+{
+    mState->pool = pool;
+    mState->workerId = workerId;
+}
+
+
+DbCursor::~DbCursor()
+{
+    close();
+}
+
+
+// Fetches queued before are read first, pages come in order
+QFuture<DbPage> DbCursor::fetch(int rows)
+{
+    QMutexLocker locker(&mState->mutex);
+    if (mState->workerId < 0 || mClient.isNull())
+        return Db::readyFuture(DbPage());
+
+    return mState->pool->runPinned<DbPage>(
+                mState->workerId,
+                mClient->bounded<DbPage>(mClient->measured<DbPage>(
+                    mQueryString,
+                    std::bind(
+                        &DbCursor::fetchRows,
+                        mClient.data(),
+                        mState,
+                        std::placeholders::_1,
+                        mQueryString,
+                        mParams,
+                        mToken,
+                        qMax(1, rows)))),
+                mClient->deadline());
+}
+
+
+void DbCursor::close()
+{
+    QMutexLocker locker(&mState->mutex);
+    if (mState->workerId < 0)
+        return;
+
+    QSharedPointer<State> state = mState;
+    mState->pool->runPinned<bool>(
+                mState->workerId,
+                [state](DbConnection& connection)
+                {
+                    finish(state, connection);
+                    return true;
+                },
+                QDeadlineTimer(QDeadlineTimer::Forever),
+                false);
+    mState->pool->release(mState->workerId);
+    mState->workerId = -1;
+}
+
+
+bool DbCursor::isOpen() const
+{
+    return !mState->isReleased();
+}
+
+
+DbPage DbCursor::fetchRows(
+        ParallelDbClient* client,
+        QSharedPointer<State> state,
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params,
+        const QByteArray& token,
+        int rows)
+{
+    DbPage ans;
+    if (state->done)
+        return ans;
+
+    if (state->query.isNull())
+    {
+        client->openDb(connection);
+        QSqlDatabase db = connection.database();
+        if (!db.isOpen())
+        {
+            client->fail(connection, db.lastError());
+            finish(state, connection);
+            state->release();
+            return ans;
+        }
+
+        // Not from the statement cache, it stays open across tasks
+        state->query.reset(new QSqlQuery(db));
+        state->query->setForwardOnly(true);
+        if (!state->query->prepare(queryString))
+        {
+            client->fail(connection, state->query->lastError());
+            finish(state, connection);
+            state->release();
+            return ans;
+        }
+
+        params.bindTo(*state->query);
+        if (!connection.exec(*state->query))
+        {
+            client->fail(connection, state->query->lastError());
+            finish(state, connection);
+            state->release();
+            return ans;
+        }
+    }
+    else if (!connection.resume(*state->query))
+    {
+        return ans;
+    }
+
+    if (state->hasPending)
+    {
+        ans.rows.append(state->pending);
+        state->hasPending = false;
+    }
+
+    while (ans.rows.size() < rows && state->query->next())
+    {
+        ans.rows.append(state->query->record());
+    }
+
+    if (ans.rows.size() == rows && state->query->next())
+    {
+        state->pending = state->query->record();
+        state->hasPending = true;
+        ans.hasMore = true;
+        ans.token = token;
+    }
+
+    QSqlError error = state->query->lastError();
+    connection.endStatement();
+
+    // An interrupted read can not be continued, the rows already
+    // read are dropped with the cancelled page
+    if (error.isValid() || connection.isCancelled())
+    {
+        if (error.isValid())
+            client->fail(connection, error);
+
+        ans.hasMore = false;
+        ans.token.clear();
+    }
+
+    if (!ans.hasMore)
+    {
+        finish(state, connection);
+        state->release();
+    }
+
+    return ans;
+}
+
+
+void DbCursor::finish(QSharedPointer<State> state, DbConnection& connection)
+{
+    if (!state->query.isNull())
+    {
+        connection.finish(*state->query);
+        state->query.reset();
+    }
+
+    state->hasPending = false;
+    state->done = true;
+}
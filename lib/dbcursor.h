@@ -0,0 +1,85 @@
+#ifndef DBCURSOR_H
+#define DBCURSOR_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QFuture>
+#include <QMutex>
+#include <QPointer>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include "dbconnection.h"
+#include "dbconnectionpool.h"
+#include "dbpage.h"
+#include "dbparams.h"
+
+class ParallelDbClient;
+
+// Forward-only server cursor over one query. The query is executed on a
+// reserved pooled connection by the first fetch() and stays open, every
+// fetch() reads the next rows from it instead of running the query again.
+// Drivers that buffer whole results (QMYSQL) still save the transfer of
+// all rows to the caller. The connection is given back once the last
+// row was read, on close() or on destruction.
+class LIBSHARED_EXPORT DbCursor
+{
+    friend ParallelDbClient;
+
+public:
+    ~DbCursor();
+    DbCursor(const DbCursor&) = delete;
+    void operator=(const DbCursor&) = delete;
+
+    QFuture<DbPage> fetch(int rows);
+    void close();
+    bool isOpen() const;
+
+private:
+    // Shared with the queued fetches. The query is created, read and
+    // destroyed by the pinned worker only.
+    struct State
+    {
+        QScopedPointer<QSqlQuery> query;
+        // First row of the next page, read to know there is one
+        QSqlRecord pending;
+        bool hasPending = false;
+        bool done = false;
+        QSharedPointer<DbConnectionPool> pool;
+        int workerId = -1;
+        QMutex mutex;
+
+        bool isReleased();
+        void release();
+    };
+
+    DbCursor(
+            ParallelDbClient* client,
+            QSharedPointer<DbConnectionPool> pool,
+            int workerId,
+            const QString& queryString,
+            DbParams params);
+    static DbPage fetchRows(
+            ParallelDbClient* client,
+            QSharedPointer<State> state,
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params,
+            const QByteArray& token,
+            int rows);
+    static void finish(QSharedPointer<State> state, DbConnection& connection);
+
+    QPointer<ParallelDbClient> mClient;
+    QSharedPointer<State> mState;
+    QString mQueryString;
+    DbParams mParams;
+    // Handed out with every page that has a successor, see selectPage()
+    QByteArray mToken;
+};
+
+#endif // DBCURSOR_H
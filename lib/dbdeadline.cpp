@@ -0,0 +1,33 @@
+#include "dbdeadline.h"
+
+namespace
+{
+    thread_local const DbDeadline* innermost = nullptr;
+}
+
+
+DbDeadline::DbDeadline(int timeoutMs)
+    : DbDeadline(QDeadlineTimer(qMax(0, timeoutMs)))
+{
+
+}
+
+
+DbDeadline::DbDeadline(const QDeadlineTimer& deadline)
+    : mDeadline(deadline),
+    mOuter(innermost)
+{
+    innermost = this;
+}
+
+
+DbDeadline::~DbDeadline()
+{
+    innermost = mOuter;
+}
+
+
+const DbDeadline* DbDeadline::current()
+{
+    return innermost;
+}
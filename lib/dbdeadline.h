@@ -0,0 +1,37 @@
+#ifndef DBDEADLINE_H
+#define DBDEADLINE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QDeadlineTimer>
+
+// Deadline of the queries the current thread submits while it is in
+// scope, it overrides the query timeout of the client:
+//
+//     DbDeadline deadline(200);
+//     QFuture<QList<QSqlRecord>> rows = db->select("SELECT ...");
+//
+// Scopes nest, the innermost one applies.
+class LIBSHARED_EXPORT DbDeadline
+{
+public:
+    explicit DbDeadline(int timeoutMs);
+    explicit DbDeadline(const QDeadlineTimer& deadline);
+    ~DbDeadline();
+    DbDeadline(const DbDeadline&) = delete;
+    void operator=(const DbDeadline&) = delete;
+
+    QDeadlineTimer deadline() const { return mDeadline; }
+
+    static const DbDeadline* current();
+
+private:
+    QDeadlineTimer mDeadline;
+    const DbDeadline* mOuter;
+};
+
+#endif // DBDEADLINE_H
@@ -0,0 +1,221 @@
+#include "dbexport.h"
+#include "dbcsv.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+
+namespace
+{
+    const quint32 BINARY_MAGIC = 0x50444258;
+    const quint8 BINARY_VERSION = 1;
+    const quint8 ROW_MARKER = 1;
+    const quint8 END_MARKER = 0;
+
+    QString csvText(const QVariant& value)
+    {
+        if (value.isNull())
+            return QString();
+
+        if (value.type() == QVariant::ByteArray)
+            return QString::fromLatin1(value.toByteArray().toBase64());
+
+        return value.toString();
+    }
+}
+
+
+DbExportWriter::DbExportWriter(const QString& fileName, const DbExportOptions& options)
+    : mFile(fileName),
+    mOptions(options),
+    mHeaderWritten(false),
+    mRows(0),
+    mBytes(0)
+{
+    mOptions.bufferBytes = qMax(4096, mOptions.bufferBytes);
+    // resize(0) keeps reserved capacity, the buffer is allocated once
+    mBuffer.reserve(mOptions.bufferBytes);
+}
+
+
+bool DbExportWriter::open()
+{
+    if (!mFile.open(QIODevice::WriteOnly))
+    {
+        mError = "Can not open " + mFile.fileName() + ": " + mFile.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+
+// Returns false once writing failed, that stops the fetch
+bool DbExportWriter::write(const QList<QSqlRecord>& rows)
+{
+    if (!mError.isEmpty())
+        return false;
+
+    if (rows.isEmpty())
+        return true;
+
+    if (!mHeaderWritten)
+        writeHeader(rows.first());
+
+    if (mOptions.format == DbExportOptions::Format::BINARY)
+    {
+        QDataStream stream(&mBuffer, QIODevice::WriteOnly | QIODevice::Append);
+        stream.setVersion(QDataStream::Qt_5_0);
+        for (const QSqlRecord& record : rows)
+        {
+            stream << ROW_MARKER;
+            for (int i = 0; i < record.count(); ++i)
+            {
+                stream << record.value(i);
+            }
+        }
+    }
+    else
+    {
+        for (const QSqlRecord& record : rows)
+        {
+            for (int i = 0; i < record.count(); ++i)
+            {
+                if (i > 0)
+                    mBuffer.append(mOptions.delimiter);
+
+                DbCsv::appendField(
+                            mBuffer,
+                            csvText(record.value(i)),
+                            mOptions.delimiter,
+                            mOptions.quote);
+            }
+            mBuffer.append("\r\n");
+        }
+    }
+
+    mRows += rows.size();
+    return mBuffer.size() < mOptions.bufferBytes || flush();
+}
+
+
+bool DbExportWriter::close()
+{
+    if (!mError.isEmpty())
+    {
+        discard();
+        return false;
+    }
+
+    if (!mHeaderWritten)
+        writeHeader(QSqlRecord());
+
+    if (mOptions.format == DbExportOptions::Format::BINARY)
+    {
+        QDataStream stream(&mBuffer, QIODevice::WriteOnly | QIODevice::Append);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << END_MARKER;
+    }
+
+    if (!flush() || !mFile.commit())
+    {
+        if (mError.isEmpty())
+            mError = "Can not write " + mFile.fileName() + ": " + mFile.errorString();
+
+        discard();
+        return false;
+    }
+
+    return true;
+}
+
+
+// Leaves an existing file untouched
+void DbExportWriter::discard()
+{
+    if (!mFile.isOpen())
+        return;
+
+    mFile.cancelWriting();
+    mFile.commit();
+}
+
+
+// name.csv -> name.part0.csv
+QString DbExportWriter::partFileName(const QString& fileName, int part)
+{
+    QFileInfo info(fileName);
+    QString suffix = info.completeSuffix();
+    QString base = suffix.isEmpty()
+            ? fileName
+            : fileName.left(fileName.size() - suffix.size() - 1);
+    QString ans = base + QString(".part%1").arg(part);
+    return suffix.isEmpty() ? ans : ans + "." + suffix;
+}
+
+
+// CSV files of empty results stay empty, they have no column names
+void DbExportWriter::writeHeader(const QSqlRecord& record)
+{
+    mHeaderWritten = true;
+    QStringList names;
+    for (int i = 0; i < record.count(); ++i)
+    {
+        names.append(record.fieldName(i));
+    }
+
+    if (mOptions.format == DbExportOptions::Format::BINARY)
+    {
+        QDataStream stream(&mBuffer, QIODevice::WriteOnly | QIODevice::Append);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << BINARY_MAGIC << BINARY_VERSION << names;
+        return;
+    }
+
+    if (!mOptions.header || names.isEmpty())
+        return;
+
+    for (int i = 0; i < names.size(); ++i)
+    {
+        if (i > 0)
+            mBuffer.append(mOptions.delimiter);
+
+        DbCsv::appendField(mBuffer, names[i], mOptions.delimiter, mOptions.quote);
+    }
+    mBuffer.append("\r\n");
+}
+
+
+bool DbExportWriter::flush()
+{
+    if (mBuffer.isEmpty())
+        return true;
+
+    qint64 written = mFile.write(mBuffer);
+    if (written != mBuffer.size())
+    {
+        mError = "Can not write " + mFile.fileName() + ": " + mFile.errorString();
+        return false;
+    }
+
+    mBytes += written;
+    mBuffer.resize(0);
+    return true;
+}
+
+
+DbExportResult DbExport::combine(const QVector<DbExportResult>& parts)
+{
+    DbExportResult ans;
+    ans.succ = true;
+    for (const DbExportResult& part : parts)
+    {
+        ans.succ = ans.succ && part.succ;
+        ans.rows += part.rows;
+        ans.bytes += part.bytes;
+        ans.files.append(part.files);
+        if (ans.errorText.isEmpty())
+            ans.errorText = part.errorText;
+    }
+
+    return ans;
+}
@@ -0,0 +1,89 @@
+#ifndef DBEXPORT_H
+#define DBEXPORT_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QByteArray>
+#include <QList>
+#include <QSaveFile>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// How exportQuery() writes the rows of a query
+struct DbExportOptions
+{
+    enum Format { CSV, BINARY };
+
+    Format format = CSV;
+    char delimiter = ',';
+    char quote = '"';
+    // CSV: first record names the columns
+    bool header = true;
+    // Rows fetched at once and bytes collected before a write
+    int chunkSize = 1000;
+    int bufferBytes = 1024 * 1024;
+    // Parallel export: the query is split into up to parts ranges of
+    // this column (numbers, dates), each written to its own part file
+    // name.partN.ext by its own pooled connection
+    QString keyColumn;
+    int parts = 1;
+};
+
+struct DbExportResult
+{
+    bool succ = false;
+    qint64 rows = 0;
+    qint64 bytes = 0;
+    // Written files, in key order
+    QStringList files;
+    QString errorText;
+};
+
+// Formats rows into a buffer and writes it out whenever bufferBytes are
+// collected. The file only replaces an existing one once close() wrote
+// everything. Used by one thread at a time.
+// BINARY files are a QDataStream (Qt_5_0): quint32 0x50444258 ("PDBX"),
+// quint8 version 1 and the column names as QStringList, then per row
+// quint8 1 followed by one QVariant per column, ended by quint8 0.
+class LIBSHARED_EXPORT DbExportWriter
+{
+public:
+    DbExportWriter(const QString& fileName, const DbExportOptions& options);
+    DbExportWriter(const DbExportWriter&) = delete;
+    void operator=(const DbExportWriter&) = delete;
+
+    bool open();
+    bool write(const QList<QSqlRecord>& rows);
+    bool close();
+    void discard();
+    qint64 rows() const { return mRows; }
+    qint64 bytes() const { return mBytes; }
+    QString errorString() const { return mError; }
+
+    static QString partFileName(const QString& fileName, int part);
+
+private:
+    void writeHeader(const QSqlRecord& record);
+    bool flush();
+
+    QSaveFile mFile;
+    DbExportOptions mOptions;
+    QByteArray mBuffer;
+    bool mHeaderWritten;
+    qint64 mRows;
+    qint64 mBytes;
+    QString mError;
+};
+
+namespace DbExport
+{
+    LIBSHARED_EXPORT DbExportResult combine(const QVector<DbExportResult>& parts);
+}
+
+#endif // DBEXPORT_H
@@ -0,0 +1,158 @@
+#include "dbhostcache.h"
+#include "constants.h"
+
+#include <QtConcurrent>
+
+DbHostCache& DbHostCache::getInstance()
+{
+    static DbHostCache instance;
+    return instance;
+}
+
+
+DbHostCache::DbHostCache()
+    : mTtlMs(DbConstants::DEFAULT_DNS_TTL_MS)
+{
+    mClock.start();
+    mLookups.setMaxThreadCount(DbConstants::DEFAULT_DNS_LOOKUP_THREADS);
+}
+
+
+DbHostCache::~DbHostCache()
+{
+    mLookups.waitForDone();
+}
+
+
+void DbHostCache::setTtl(int ttlMs)
+{
+    QMutexLocker locker(&mMutex);
+    mTtlMs = qMax(0, ttlMs);
+}
+
+
+int DbHostCache::getTtl() const
+{
+    QMutexLocker locker(&mMutex);
+    return mTtlMs;
+}
+
+
+// Starts resolving the name unless it is cached and fresh
+void DbHostCache::prefetch(const QString& name)
+{
+    QMutexLocker locker(&mMutex);
+    refreshIfDue(name, entry(name));
+}
+
+
+// Never blocks. Null address until the first lookup finished.
+QHostAddress DbHostCache::lookup(const QString& name)
+{
+    QMutexLocker locker(&mMutex);
+    Entry& cached = entry(name);
+    refreshIfDue(name, cached);
+    return cached.addresses.isEmpty() ? QHostAddress() : cached.addresses.first();
+}
+
+
+// Waits up to timeoutMs only when nothing was resolved yet
+QHostAddress DbHostCache::resolve(const QString& name, int timeoutMs)
+{
+    QMutexLocker locker(&mMutex);
+    Entry& cached = entry(name);
+    refreshIfDue(name, cached);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (cached.addresses.isEmpty() && cached.pending)
+    {
+        qint64 left = timeoutMs - timer.elapsed();
+        if (left <= 0)
+            break;
+
+        mResolved.wait(&mMutex, static_cast<unsigned long>(left));
+    }
+
+    return cached.addresses.isEmpty() ? QHostAddress() : cached.addresses.first();
+}
+
+
+QString DbHostCache::errorString(const QString& name) const
+{
+    QMutexLocker locker(&mMutex);
+    return mEntries.value(name.toLower()).errorString;
+}
+
+
+void DbHostCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end();)
+    {
+        // Running lookups still need their entry
+        if (it->pending)
+        {
+            it->refreshAt = 0;
+            ++it;
+        }
+        else
+        {
+            it = mEntries.erase(it);
+        }
+    }
+}
+
+
+DbHostCache::Entry& DbHostCache::entry(const QString& name)
+{
+    return mEntries[name.toLower()];
+}
+
+
+// QHostInfo::lookupHost() would need an event loop in the calling
+// thread, pool workers and plain threads have none
+void DbHostCache::refreshIfDue(const QString& name, Entry& entry)
+{
+    if (entry.pending || mClock.elapsed() < entry.refreshAt)
+        return;
+
+    entry.pending = true;
+    QString key = name.toLower();
+    QtConcurrent::run(&mLookups, [this, key]() {
+        finished(key, QHostInfo::fromName(key));
+    });
+}
+
+
+void DbHostCache::finished(const QString& name, const QHostInfo& info)
+{
+    bool changed = false;
+    QHostAddress address;
+    {
+        QMutexLocker locker(&mMutex);
+        Entry& cached = entry(name);
+        cached.pending = false;
+        if (info.addresses().isEmpty())
+        {
+            cached.errorString = info.errorString();
+            cached.refreshAt = mClock.elapsed() + DbConstants::DEFAULT_DNS_RETRY_MS;
+        }
+        else
+        {
+            changed = cached.addresses.isEmpty()
+                    || cached.addresses.first() != info.addresses().first();
+            cached.addresses = info.addresses();
+            cached.errorString = QString();
+            cached.refreshAt = mClock.elapsed() + mTtlMs;
+            address = cached.addresses.first();
+        }
+
+        mResolved.wakeAll();
+    }
+
+    if (changed)
+        emit hostChanged(name, address);
+    else if (address.isNull())
+        emit hostError(name, info.errorString());
+}
@@ -0,0 +1,71 @@
+#ifndef DBHOSTCACHE_H
+#define DBHOSTCACHE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+// Process-wide cache of host name lookups. Every name is resolved at
+// most once at a time, off the caller's thread. An address older than
+// the TTL keeps being served while a background lookup refreshes it,
+// so DNS failover is picked up without blocking anyone. A failed
+// refresh keeps the last known addresses.
+class LIBSHARED_EXPORT DbHostCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DbHostCache& getInstance();
+    ~DbHostCache();
+    DbHostCache(const DbHostCache&) = delete;
+    void operator=(const DbHostCache&) = delete;
+
+    void setTtl(int ttlMs);
+    int getTtl() const;
+
+    void prefetch(const QString& name);
+    QHostAddress lookup(const QString& name);
+    QHostAddress resolve(const QString& name, int timeoutMs);
+    QString errorString(const QString& name) const;
+    void clear();
+
+signals:
+    void hostChanged(const QString& name, const QHostAddress& address);
+    void hostError(const QString& name, const QString& errorString);
+
+private:
+    struct Entry
+    {
+        QList<QHostAddress> addresses;
+        QString errorString;
+        qint64 refreshAt = 0;
+        bool pending = false;
+    };
+
+    DbHostCache();
+    Entry& entry(const QString& name);
+    void refreshIfDue(const QString& name, Entry& entry);
+    void finished(const QString& name, const QHostInfo& info);
+
+    QHash<QString, Entry> mEntries;
+    int mTtlMs;
+    QElapsedTimer mClock;
+    QWaitCondition mResolved;
+    mutable QMutex mMutex;
+    // Declared last, waits for running lookups before the rest goes
+    QThreadPool mLookups;
+};
+
+#endif // DBHOSTCACHE_H
@@ -0,0 +1,593 @@
+#include "dbimport.h"
+#include "dbcsv.h"
+#include "paralleldbclient.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrent/QtConcurrent>
+
+DbImport::DbImport(
+        ParallelDbClient* client,
+        QSharedPointer<DbConnectionPool> pool,
+        const QString& fileName,
+        const QString& table,
+        const DbImportOptions& options)
+    : mClient(client),
+    mPool(pool),
+    mFileName(fileName),
+    mTable(table),
+    mOptions(options),
+    mColumnCount(-1),
+    mNextLane(0),
+    mPendingBatches(qMax(1, options.maxPendingBatches)),
+    mCancelled(0),
+    mBytesRead(0),
+    mBytesTotal(QFileInfo(fileName).size()),
+    mQueueClosed(false)
+{
+    mOptions.batchSize = qMax(1, mOptions.batchSize);
+    mOptions.parserThreads = qMax(1, mOptions.parserThreads);
+    mThreads.setMaxThreadCount(mOptions.parserThreads + 1);
+}
+
+
+DbImport::~DbImport()
+{
+    cancel();
+    mRun.waitForFinished();
+    mThreads.waitForDone();
+}
+
+
+void DbImport::cancel()
+{
+    mCancelled.storeRelease(1);
+    QMutexLocker locker(&mQueueMutex);
+    mChunkAvailable.wakeAll();
+    mSpaceAvailable.wakeAll();
+}
+
+
+bool DbImport::isCancelled() const
+{
+    return mCancelled.loadAcquire() != 0;
+}
+
+
+// Reserves the connections and hands the rest to the reader thread
+void DbImport::start()
+{
+    mResult.reportStarted();
+
+    int connections = mOptions.connections > 0
+            ? mOptions.connections
+            : qMax(1, mClient->getPoolMaxSize() / 2);
+    if (mClient->getDbEngine() == DbConfig::DbEngine::SQLITE)
+        connections = 1;
+
+    for (int i = 0; i < connections; ++i)
+    {
+        int workerId = mPool->reserve();
+        if (workerId < 0)
+            break;
+
+        QSharedPointer<Lane> lane(new Lane);
+        lane->workerId = workerId;
+        mLanes.append(lane);
+    }
+
+    if (mLanes.isEmpty())
+    {
+        emit mClient->dbError(QSqlError(
+                                  QString(),
+                                  "No pooled connection left for an import",
+                                  QSqlError::ConnectionError));
+        DbImportResult result;
+        result.errorText = "No pooled connection left for an import";
+        mResult.reportResult(result);
+        mResult.reportFinished();
+        return;
+    }
+
+    mRun = QtConcurrent::run(&mThreads, [this]() { run(); });
+}
+
+
+void DbImport::run()
+{
+    QList<QFuture<void>> parsers;
+    for (int i = 0; i < mOptions.parserThreads; ++i)
+    {
+        parsers.append(QtConcurrent::run(&mThreads, [this]() { parse(); }));
+    }
+
+    read();
+    closeQueue();
+    for (QFuture<void>& parser : parsers)
+    {
+        parser.waitForFinished();
+    }
+
+    // Queued behind the last batch of each lane
+    QList<QFuture<bool>> lanes;
+    for (const QSharedPointer<Lane>& lane : mLanes)
+    {
+        lanes.append(mPool->runPinned<bool>(
+                         lane->workerId,
+                         std::bind(&DbImport::finishLane, this, lane, std::placeholders::_1),
+                         QDeadlineTimer(QDeadlineTimer::Forever),
+                         false));
+        mPool->release(lane->workerId);
+    }
+
+    for (QFuture<bool>& lane : lanes)
+    {
+        lane.waitForFinished();
+    }
+
+    // Reads cached or routed to a replica while the rows went in would
+    // miss them, both are renewed once everything is committed
+    mClient->markWrite();
+    mClient->mResultCache.invalidateTable(mTable);
+    reportProgress();
+
+    QMutexLocker locker(&mTotalsMutex);
+    if (isCancelled() && mTotals.errorText.isEmpty())
+        mTotals.errorText = "Import cancelled";
+
+    mTotals.succ = mTotals.errorText.isEmpty() && mTotals.rowsFailed == 0;
+    DbImportResult result = mTotals;
+    locker.unlock();
+
+    mResult.reportResult(result);
+    mResult.reportFinished();
+}
+
+
+// Splits the file into records in blocks. Line breaks inside quoted
+// fields belong to the record. The quote and the line break are single
+// bytes in UTF-8, they never occur inside a multi-byte character.
+bool DbImport::read()
+{
+    QFile file(mFileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fatal("Can not open " + mFileName + ": " + file.errorString());
+        return false;
+    }
+
+    Chunk chunk;
+    QByteArray pending;
+    bool quoted = false;
+    bool fieldStart = true;
+    bool closed = false;
+    bool first = true;
+    qint64 line = 1;
+    qint64 recordLine = 1;
+
+    while (!isCancelled())
+    {
+        QByteArray block = file.read(DbConstants::DEFAULT_IMPORT_READ_BYTES);
+        if (block.isEmpty())
+            break;
+
+        mBytesRead.fetchAndAddRelaxed(block.size());
+        if (first && block.startsWith("\xEF\xBB\xBF"))
+            block.remove(0, 3);
+
+        first = false;
+        int start = 0;
+        for (int i = 0; i < block.size(); ++i)
+        {
+            // Same rule as DbCsv::parseRecord(): a quote opens a field
+            // only as its first character. An escaped quote ("") is seen
+            // as close and open again.
+            char c = block.at(i);
+            if (c == mOptions.quote && quoted)
+            {
+                quoted = false;
+                closed = true;
+            }
+            else if (c == mOptions.quote && (fieldStart || closed))
+            {
+                quoted = true;
+                fieldStart = false;
+                closed = false;
+            }
+            else if (c == '\n' && quoted)
+            {
+                ++line;
+            }
+            else if (!quoted && (c == '\n' || c == mOptions.delimiter))
+            {
+                fieldStart = true;
+                closed = false;
+                if (c == mOptions.delimiter)
+                    continue;
+
+                ++line;
+                pending.append(block.constData() + start, i - start);
+                start = i + 1;
+                QByteArray record;
+                record.swap(pending);
+                if (!addRecord(record, recordLine, chunk))
+                    return false;
+
+                recordLine = line;
+            }
+            else if (!quoted)
+            {
+                fieldStart = false;
+                closed = false;
+            }
+        }
+
+        pending.append(block.constData() + start, block.size() - start);
+    }
+
+    if (file.error() != QFileDevice::NoError)
+    {
+        fatal("Can not read " + mFileName + ": " + file.errorString());
+        return false;
+    }
+
+    if (isCancelled() || !addRecord(pending, recordLine, chunk))
+        return false;
+
+    return chunk.records.isEmpty() || push(chunk);
+}
+
+
+bool DbImport::addRecord(QByteArray record, qint64 line, Chunk& chunk)
+{
+    if (record.endsWith('\r'))
+        record.chop(1);
+
+    if (record.isEmpty())
+        return true;
+
+    if (mColumnCount < 0)
+    {
+        QStringList fields;
+        bool parsed = DbCsv::parseRecord(
+                    record, mOptions.delimiter, mOptions.quote, fields);
+        if (mOptions.header)
+        {
+            if (!parsed)
+            {
+                fatal("Malformed header line");
+                return false;
+            }
+
+            for (QString& field : fields)
+            {
+                field = field.trimmed();
+            }
+
+            mColumns = mOptions.columns.isEmpty() ? fields : mOptions.columns;
+            mColumnCount = mColumns.size();
+            return true;
+        }
+
+        mColumns = mOptions.columns;
+        mColumnCount = mColumns.isEmpty() ? fields.size() : mColumns.size();
+    }
+
+    chunk.records.append(record);
+    chunk.lines.append(line);
+    if (chunk.records.size() < mOptions.batchSize)
+        return true;
+
+    bool pushed = push(chunk);
+    chunk = Chunk();
+    return pushed;
+}
+
+
+// Blocks the reader while maxPendingBatches chunks wait for a parser
+bool DbImport::push(const Chunk& chunk)
+{
+    QMutexLocker locker(&mQueueMutex);
+    while (mChunks.size() >= qMax(1, mOptions.maxPendingBatches) && !isCancelled())
+    {
+        mSpaceAvailable.wait(&mQueueMutex);
+    }
+
+    if (isCancelled())
+        return false;
+
+    mChunks.enqueue(chunk);
+    mChunkAvailable.wakeOne();
+    return true;
+}
+
+
+bool DbImport::take(Chunk& chunk)
+{
+    QMutexLocker locker(&mQueueMutex);
+    while (mChunks.isEmpty() && !mQueueClosed && !isCancelled())
+    {
+        mChunkAvailable.wait(&mQueueMutex);
+    }
+
+    if (mChunks.isEmpty() || isCancelled())
+        return false;
+
+    chunk = mChunks.dequeue();
+    mSpaceAvailable.wakeOne();
+    return true;
+}
+
+
+void DbImport::closeQueue()
+{
+    QMutexLocker locker(&mQueueMutex);
+    mQueueClosed = true;
+    mChunkAvailable.wakeAll();
+}
+
+
+// Parser thread. Rows that can not be converted are rejected here,
+// the rest goes to the database column by column.
+void DbImport::parse()
+{
+    Chunk chunk;
+    QStringList fields;
+    QVariantList row;
+    QString error;
+
+    while (take(chunk))
+    {
+        Batch batch;
+        for (int c = 0; c < mColumnCount; ++c)
+        {
+            batch.columns.append(QVariantList());
+            batch.columns.last().reserve(chunk.records.size());
+        }
+
+        for (int i = 0; i < chunk.records.size(); ++i)
+        {
+            qint64 line = chunk.lines[i];
+            if (!DbCsv::parseRecord(
+                        chunk.records[i], mOptions.delimiter, mOptions.quote, fields))
+            {
+                addError(line, "Malformed record");
+                continue;
+            }
+
+            if (fields.size() != mColumnCount)
+            {
+                addError(line, QString("Expected %1 fields, found %2")
+                         .arg(mColumnCount).arg(fields.size()));
+                continue;
+            }
+
+            row.clear();
+            for (const QString& field : fields)
+            {
+                if (field.isEmpty() && mOptions.emptyAsNull)
+                    row.append(QVariant(QVariant::String));
+                else
+                    row.append(field);
+            }
+
+            error.clear();
+            if (mOptions.convert && !mOptions.convert(row, error))
+            {
+                addError(line, error);
+                continue;
+            }
+
+            if (row.size() != mColumnCount)
+            {
+                addError(line, "Converted row has a different number of values");
+                continue;
+            }
+
+            for (int c = 0; c < mColumnCount; ++c)
+            {
+                batch.columns[c].append(row[c]);
+            }
+            batch.lines.append(line);
+        }
+
+        QMutexLocker locker(&mTotalsMutex);
+        mTotals.rowsRead += chunk.records.size();
+        locker.unlock();
+
+        if (!batch.lines.isEmpty())
+            submit(std::move(batch));
+    }
+}
+
+
+// Lanes take batches in turns. The parser blocks while maxPendingBatches
+// are queued on them.
+void DbImport::submit(Batch batch)
+{
+    mPendingBatches.acquire();
+    if (isCancelled())
+    {
+        mPendingBatches.release();
+        return;
+    }
+
+    uint next = static_cast<uint>(mNextLane.fetchAndAddRelaxed(1));
+    QSharedPointer<Lane> lane = mLanes[static_cast<int>(next % mLanes.size())];
+    mPool->runPinned<bool>(
+                lane->workerId,
+                std::bind(
+                    &DbImport::insert,
+                    this,
+                    lane,
+                    std::placeholders::_1,
+                    std::move(batch)),
+                QDeadlineTimer(QDeadlineTimer::Forever),
+                false);
+}
+
+
+// Rows count as imported once committed. Failing rows are skipped
+// by the batch and reported with their line.
+bool DbImport::insert(
+        QSharedPointer<Lane> lane,
+        DbConnection& connection,
+        const Batch& batch)
+{
+    bool succ = false;
+    if (!isCancelled())
+    {
+        mClient->openDb(connection);
+        QSqlDatabase db = connection.database();
+        if (db.isOpen())
+        {
+            if (lane->queryString.isEmpty())
+                lane->queryString = insertQuery(db);
+
+            if (!lane->inTransaction && mOptions.commitInterval > 0)
+                lane->inTransaction = db.transaction();
+
+            DbBatchResult result = mClient->executeBatch(
+                        connection, lane->queryString, batch.columns, lane->inTransaction);
+            QSet<int> failed;
+            for (int row : result.failedRows)
+            {
+                failed.insert(row);
+                addError(batch.lines[row], result.errorText);
+            }
+
+            QList<qint64> applied;
+            for (int row = 0; row < batch.lines.size(); ++row)
+            {
+                if (!failed.contains(row))
+                    applied.append(batch.lines[row]);
+            }
+
+            succ = failed.isEmpty();
+            if (lane->inTransaction)
+            {
+                lane->uncommitted.append(applied);
+                if (lane->uncommitted.size() >= mOptions.commitInterval)
+                    succ = commit(lane, connection) && succ;
+            }
+            else
+            {
+                QMutexLocker locker(&mTotalsMutex);
+                mTotals.rowsImported += applied.size();
+            }
+        }
+        else
+        {
+            for (qint64 line : batch.lines)
+            {
+                addError(line, db.lastError().text());
+            }
+        }
+    }
+
+    mPendingBatches.release();
+    reportProgress();
+    return succ;
+}
+
+
+bool DbImport::finishLane(QSharedPointer<Lane> lane, DbConnection& connection)
+{
+    if (!lane->inTransaction)
+        return true;
+
+    if (!isCancelled())
+        return commit(lane, connection);
+
+    connection.database().rollback();
+    lane->inTransaction = false;
+    lane->uncommitted.clear();
+    return false;
+}
+
+
+// A failed commit loses every row since the previous one
+bool DbImport::commit(QSharedPointer<Lane> lane, DbConnection& connection)
+{
+    QSqlDatabase db = connection.database();
+    lane->inTransaction = false;
+    bool succ = db.commit();
+    if (succ)
+    {
+        QMutexLocker locker(&mTotalsMutex);
+        mTotals.rowsImported += lane->uncommitted.size();
+    }
+    else
+    {
+        QString text = "Commit failed: " + db.lastError().text();
+        db.rollback();
+        for (qint64 line : lane->uncommitted)
+        {
+            addError(line, text);
+        }
+    }
+
+    lane->uncommitted.clear();
+    return succ;
+}
+
+
+QString DbImport::insertQuery(const QSqlDatabase& db) const
+{
+    QStringList names;
+    for (const QString& column : mColumns)
+    {
+        names.append(db.driver()->escapeIdentifier(column, QSqlDriver::FieldName));
+    }
+
+    QStringList values;
+    for (int c = 0; c < mColumnCount; ++c)
+    {
+        values.append("?");
+    }
+
+    QString ans = "INSERT INTO "
+            + db.driver()->escapeIdentifier(mTable, QSqlDriver::TableName);
+    if (!names.isEmpty())
+        ans += " (" + names.join(", ") + ")";
+
+    return ans + " VALUES (" + values.join(", ") + ")";
+}
+
+
+void DbImport::addError(qint64 line, const QString& text)
+{
+    QMutexLocker locker(&mTotalsMutex);
+    ++mTotals.rowsFailed;
+    if (mTotals.errors.size() < mOptions.maxErrors)
+    {
+        DbImportError error;
+        error.line = line;
+        error.text = text;
+        mTotals.errors.append(error);
+    }
+}
+
+
+void DbImport::reportProgress()
+{
+    QMutexLocker locker(&mTotalsMutex);
+    qint64 imported = mTotals.rowsImported;
+    qint64 failed = mTotals.rowsFailed;
+    locker.unlock();
+
+    emit progress(imported, failed, mBytesRead.loadAcquire(), mBytesTotal);
+}
+
+
+// Stops reading and rolls back what is not committed
+void DbImport::fatal(const QString& text)
+{
+    QMutexLocker locker(&mTotalsMutex);
+    if (mTotals.errorText.isEmpty())
+        mTotals.errorText = text;
+
+    locker.unlock();
+    cancel();
+}
@@ -0,0 +1,181 @@
+#ifndef DBIMPORT_H
+#define DBIMPORT_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QAtomicInteger>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariant>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
+#include "dbconnection.h"
+#include "dbconnectionpool.h"
+
+class ParallelDbClient;
+
+// How importCsv() reads a file and writes its rows
+struct DbImportOptions
+{
+    char delimiter = ',';
+    char quote = '"';
+    // First record names the columns
+    bool header = true;
+    // Target columns in file order, empty means the header names, or
+    // no column list at all without a header
+    QStringList columns;
+    bool emptyAsNull = true;
+    // Called on the parser threads for every row, has to be
+    // thread-safe. Returning false rejects the row with error.
+    std::function<bool(QVariantList& row, QString& error)> convert;
+
+    int parserThreads = 2;
+    // Pooled connections written in parallel, 0 means half of the pool.
+    // SQLite always uses one, it has a single writer.
+    int connections = 0;
+    int batchSize = 1000;
+    // Rows per transaction on each connection, 0 commits every batch
+    int commitInterval = 10000;
+    // Batches read or parsed ahead of the inserts, bounds the memory
+    int maxPendingBatches = 8;
+    // Rejected rows kept in the result, all of them are counted
+    int maxErrors = 1000;
+};
+
+struct DbImportError
+{
+    // Line of the file the record starts on
+    qint64 line = 0;
+    QString text;
+};
+
+struct DbImportResult
+{
+    bool succ = false;
+    qint64 rowsRead = 0;
+    qint64 rowsImported = 0;
+    qint64 rowsFailed = 0;
+    QList<DbImportError> errors;
+    // Why the import stopped, empty when it ran through
+    QString errorText;
+};
+
+// CSV import running in the background. A reader thread splits the file
+// into records, parser threads turn them into column batches and the
+// batches are inserted through several reserved pooled connections at
+// once, each committing every commitInterval rows. Reading stalls while
+// maxPendingBatches are waiting, the file is never held in memory.
+// Rows are not inserted in file order. Destroying the import cancels it
+// and waits for the running batches; rows not committed yet are rolled
+// back.
+class LIBSHARED_EXPORT DbImport : public QObject
+{
+    Q_OBJECT
+    friend ParallelDbClient;
+
+public:
+    ~DbImport();
+    DbImport(const DbImport&) = delete;
+    void operator=(const DbImport&) = delete;
+
+    QFuture<DbImportResult> result() const { return mResult.future(); }
+    void cancel();
+    bool isCancelled() const;
+
+signals:
+    // Emitted from pooled threads after every batch
+    void progress(
+            qint64 rowsImported,
+            qint64 rowsFailed,
+            qint64 bytesRead,
+            qint64 bytesTotal);
+
+private:
+    struct Chunk
+    {
+        QList<QByteArray> records;
+        QList<qint64> lines;
+    };
+
+    struct Batch
+    {
+        QList<QVariantList> columns;
+        QList<qint64> lines;
+    };
+
+    // Touched by the pinned worker only, its tasks run one after another
+    struct Lane
+    {
+        int workerId = -1;
+        QString queryString;
+        bool inTransaction = false;
+        QList<qint64> uncommitted;
+    };
+
+    DbImport(
+            ParallelDbClient* client,
+            QSharedPointer<DbConnectionPool> pool,
+            const QString& fileName,
+            const QString& table,
+            const DbImportOptions& options);
+    void start();
+    void run();
+    bool read();
+    bool addRecord(QByteArray record, qint64 line, Chunk& chunk);
+    bool push(const Chunk& chunk);
+    bool take(Chunk& chunk);
+    void closeQueue();
+    void parse();
+    void submit(Batch batch);
+    bool insert(QSharedPointer<Lane> lane, DbConnection& connection, const Batch& batch);
+    bool finishLane(QSharedPointer<Lane> lane, DbConnection& connection);
+    bool commit(QSharedPointer<Lane> lane, DbConnection& connection);
+    QString insertQuery(const QSqlDatabase& db) const;
+    void addError(qint64 line, const QString& text);
+    void reportProgress();
+    void fatal(const QString& text);
+
+    ParallelDbClient* mClient;
+    QSharedPointer<DbConnectionPool> mPool;
+    QString mFileName;
+    QString mTable;
+    DbImportOptions mOptions;
+    // Set by the reader before the first chunk is queued
+    QStringList mColumns;
+    int mColumnCount;
+
+    QVector<QSharedPointer<Lane>> mLanes;
+    QAtomicInt mNextLane;
+    QSemaphore mPendingBatches;
+    QThreadPool mThreads;
+    QFuture<void> mRun;
+    QAtomicInt mCancelled;
+    QAtomicInteger<qint64> mBytesRead;
+    qint64 mBytesTotal;
+
+    QQueue<Chunk> mChunks;
+    bool mQueueClosed;
+    QMutex mQueueMutex;
+    QWaitCondition mChunkAvailable;
+    QWaitCondition mSpaceAvailable;
+
+    mutable QFutureInterface<DbImportResult> mResult;
+    DbImportResult mTotals;
+    QMutex mTotalsMutex;
+};
+
+#endif // DBIMPORT_H
@@ -0,0 +1,321 @@
+#include "dbmetrics.h"
+
+#include <QRegExp>
+#include <QTextStream>
+
+const QString DbMetrics::OTHER_STATEMENT = "<other>";
+
+namespace
+{
+    const qint64 BUCKET_BOUNDS_US[DbHistogram::BUCKETS - 1] = {
+        50, 100, 250, 500,
+        1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+        1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+    };
+
+    QString escapedLabel(QString value)
+    {
+        value.replace('\\', "\\\\");
+        value.replace('"', "\\\"");
+        value.replace('\n', "\\n");
+        return value;
+    }
+
+    QString seconds(qint64 us)
+    {
+        return QString::number(us / 1000000.0, 'g', 10);
+    }
+
+    typedef QPair<QString, const DbMetrics*> Client;
+
+    void writeHistogram(
+            QTextStream& out,
+            const QString& name,
+            const QString& labels,
+            const DbHistogram& histogram)
+    {
+        quint64 cumulative = 0;
+        for (int i = 0; i < DbHistogram::BUCKETS; ++i)
+        {
+            cumulative += histogram.bucketCount(i);
+            qint64 bound = DbHistogram::bucketBoundUs(i);
+            out << name << "_bucket{" << labels << ",le=\""
+                << (bound < 0 ? QString("+Inf") : seconds(bound))
+                << "\"} " << cumulative << '\n';
+        }
+
+        out << name << "_sum{" << labels << "} "
+            << seconds(histogram.sumUs()) << '\n';
+        out << name << "_count{" << labels << "} " << cumulative << '\n';
+    }
+
+    void writeHistograms(
+            QTextStream& out,
+            const QList<Client>& clients,
+            const QString& name,
+            const QString& help,
+            DbHistogram DbStatementMetrics::*member)
+    {
+        out << "# HELP " << name << ' ' << help << '\n';
+        out << "# TYPE " << name << " histogram\n";
+        for (const Client& client : clients)
+        {
+            QString labels = QString("client=\"%1\"")
+                    .arg(escapedLabel(client.first));
+            writeHistogram(out, name, labels, client.second->total().*member);
+        }
+
+        QString statementName = name;
+        statementName.replace("paralleldb_", "paralleldb_statement_");
+        out << "# HELP " << statementName << ' ' << help
+            << " per statement\n";
+        out << "# TYPE " << statementName << " histogram\n";
+        for (const Client& client : clients)
+        {
+            for (const QString& sql : client.second->statements())
+            {
+                const DbStatementMetrics* statement =
+                        client.second->findStatement(sql);
+                QString labels = QString("client=\"%1\",statement=\"%2\"")
+                        .arg(escapedLabel(client.first),
+                             escapedLabel(sql.simplified().left(200)));
+                writeHistogram(out, statementName, labels, statement->*member);
+            }
+        }
+    }
+
+    void writeCounters(
+            QTextStream& out,
+            const QList<Client>& clients,
+            const QString& name,
+            const QString& help,
+            QAtomicInteger<quint64> DbStatementMetrics::*member)
+    {
+        out << "# HELP " << name << ' ' << help << '\n';
+        out << "# TYPE " << name << " counter\n";
+        for (const Client& client : clients)
+        {
+            out << name << "{client=\"" << escapedLabel(client.first) << "\"} "
+                << (client.second->total().*member).loadAcquire() << '\n';
+        }
+    }
+}
+
+
+DbHistogram::DbHistogram()
+{
+
+}
+
+
+void DbHistogram::observe(qint64 us)
+{
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && us > BUCKET_BOUNDS_US[bucket])
+    {
+        ++bucket;
+    }
+
+    mBuckets[bucket].fetchAndAddRelaxed(1);
+    mCount.fetchAndAddRelaxed(1);
+    mSumUs.fetchAndAddRelaxed(qMax<qint64>(0, us));
+}
+
+
+quint64 DbHistogram::bucketCount(int bucket) const
+{
+    return mBuckets[bucket].loadAcquire();
+}
+
+
+// Upper bound of the bucket holding the q-th sample
+double DbHistogram::quantileUs(double q) const
+{
+    quint64 total = 0;
+    quint64 counts[BUCKETS];
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        counts[i] = bucketCount(i);
+        total += counts[i];
+    }
+
+    if (total == 0)
+        return 0.0;
+
+    quint64 rank = static_cast<quint64>(qBound(0.0, q, 1.0) * (total - 1));
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKETS - 1; ++i)
+    {
+        seen += counts[i];
+        if (seen > rank)
+            return BUCKET_BOUNDS_US[i];
+    }
+
+    return BUCKET_BOUNDS_US[BUCKETS - 2];
+}
+
+
+qint64 DbHistogram::bucketBoundUs(int bucket)
+{
+    return bucket < BUCKETS - 1 ? BUCKET_BOUNDS_US[bucket] : -1;
+}
+
+
+DbMetrics::DbMetrics(int maxStatements)
+    : mMaxStatements(qMax(0, maxStatements))
+{
+
+}
+
+
+// Looked up for every statement execution, mostly under the read lock
+DbStatementMetrics* DbMetrics::statement(const QString& queryString)
+{
+    {
+        QReadLocker locker(&mStatementsLock);
+        auto it = mStatements.constFind(queryString);
+        if (it != mStatements.constEnd())
+            return it.value().data();
+    }
+
+    QWriteLocker locker(&mStatementsLock);
+    QString key = mStatements.size() < mMaxStatements
+            ? queryString
+            : OTHER_STATEMENT;
+    QSharedPointer<DbStatementMetrics>& statement = mStatements[key];
+    if (statement.isNull())
+        statement.reset(new DbStatementMetrics);
+
+    return statement.data();
+}
+
+
+const DbStatementMetrics* DbMetrics::findStatement(
+        const QString& queryString) const
+{
+    QReadLocker locker(&mStatementsLock);
+    return mStatements.value(queryString).data();
+}
+
+
+QStringList DbMetrics::statements() const
+{
+    QReadLocker locker(&mStatementsLock);
+    return mStatements.keys();
+}
+
+
+void DbMetrics::recordError(
+        const QSqlError& error,
+        DbStatementMetrics* statement)
+{
+    mTotal.errors.fetchAndAddRelaxed(1);
+    if (statement)
+        statement->errors.fetchAndAddRelaxed(1);
+
+    QMutexLocker locker(&mErrorsMutex);
+    ++mErrorsBySqlState[sqlStateOf(error)];
+}
+
+
+QMap<QString, quint64> DbMetrics::errorsBySqlState() const
+{
+    QMutexLocker locker(&mErrorsMutex);
+    return mErrorsBySqlState;
+}
+
+
+QString DbMetrics::toPrometheus(const QString& clientName) const
+{
+    return toPrometheus(QList<Client>() << Client(clientName, this));
+}
+
+
+// Prometheus text exposition format, all series of a metric are
+// written together, so clients are iterated for every metric
+QString DbMetrics::toPrometheus(const QList<Client>& clients)
+{
+    QString ans;
+    QTextStream out(&ans);
+
+    writeCounters(out, clients, "paralleldb_queries_total",
+                  "Queries executed", &DbStatementMetrics::executions);
+    writeCounters(out, clients, "paralleldb_rows_total",
+                  "Rows returned", &DbStatementMetrics::rows);
+    writeCounters(out, clients, "paralleldb_bytes_total",
+                  "Estimated bytes returned", &DbStatementMetrics::bytes);
+
+    out << "# HELP paralleldb_in_flight Queries queued or running\n";
+    out << "# TYPE paralleldb_in_flight gauge\n";
+    for (const Client& client : clients)
+    {
+        out << "paralleldb_in_flight{client=\"" << escapedLabel(client.first)
+            << "\"} " << client.second->inFlight() << '\n';
+    }
+
+    out << "# HELP paralleldb_connections_opened_total Connections opened\n";
+    out << "# TYPE paralleldb_connections_opened_total counter\n";
+    for (const Client& client : clients)
+    {
+        out << "paralleldb_connections_opened_total{client=\""
+            << escapedLabel(client.first) << "\"} "
+            << client.second->connectionsOpened() << '\n';
+    }
+
+    out << "# HELP paralleldb_connections_closed_total Connections closed\n";
+    out << "# TYPE paralleldb_connections_closed_total counter\n";
+    for (const Client& client : clients)
+    {
+        out << "paralleldb_connections_closed_total{client=\""
+            << escapedLabel(client.first) << "\"} "
+            << client.second->connectionsClosed() << '\n';
+    }
+
+    out << "# HELP paralleldb_errors_total Failed statements by SQLSTATE\n";
+    out << "# TYPE paralleldb_errors_total counter\n";
+    for (const Client& client : clients)
+    {
+        QMap<QString, quint64> errors = client.second->errorsBySqlState();
+        for (auto it = errors.cbegin(); it != errors.cend(); ++it)
+        {
+            out << "paralleldb_errors_total{client=\""
+                << escapedLabel(client.first) << "\",sqlstate=\""
+                << escapedLabel(it.key()) << "\"} " << it.value() << '\n';
+        }
+    }
+
+    writeHistograms(out, clients, "paralleldb_queue_wait_seconds",
+                    "Time spent queued before a connection picked the query",
+                    &DbStatementMetrics::queueWait);
+    writeHistograms(out, clients, "paralleldb_prepare_seconds",
+                    "Statement prepare time (cached statements included)",
+                    &DbStatementMetrics::prepare);
+    writeHistograms(out, clients, "paralleldb_exec_seconds",
+                    "Statement execution time",
+                    &DbStatementMetrics::exec);
+    writeHistograms(out, clients, "paralleldb_fetch_seconds",
+                    "Time spent fetching the result",
+                    &DbStatementMetrics::fetch);
+
+    out.flush();
+    return ans;
+}
+
+
+// SQLSTATE from the native code (PostgreSQL) or from ODBC diagnostics
+// in the text, the native code itself otherwise
+QString DbMetrics::sqlStateOf(const QSqlError& error)
+{
+    QRegExp sqlState("^[0-9A-Z]{5}$");
+    if (sqlState.exactMatch(error.nativeErrorCode()))
+        return error.nativeErrorCode();
+
+    QRegExp bracketed("\\[([0-9A-Z]{5})\\]");
+    if (bracketed.indexIn(error.driverText() + ' ' + error.databaseText()) >= 0)
+        return bracketed.cap(1);
+
+    if (!error.nativeErrorCode().isEmpty())
+        return "native:" + error.nativeErrorCode();
+
+    return "unknown";
+}
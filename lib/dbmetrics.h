@@ -0,0 +1,108 @@
+#ifndef DBMETRICS_H
+#define DBMETRICS_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QSqlError>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+
+// Latency histogram with fixed buckets, from 50 us up to 60 s.
+// Updated with relaxed atomics only, readers may see a sample counted
+// in a bucket before it is added to the sum.
+class LIBSHARED_EXPORT DbHistogram
+{
+public:
+    static const int BUCKETS = 20;
+
+    DbHistogram();
+    DbHistogram(const DbHistogram&) = delete;
+    void operator=(const DbHistogram&) = delete;
+
+    void observe(qint64 us);
+    quint64 count() const { return mCount.loadAcquire(); }
+    qint64 sumUs() const { return mSumUs.loadAcquire(); }
+    quint64 bucketCount(int bucket) const;
+    double quantileUs(double q) const;
+
+    // Upper bound of the bucket, the last one is unbounded (-1)
+    static qint64 bucketBoundUs(int bucket);
+
+private:
+    QAtomicInteger<quint64> mBuckets[BUCKETS];
+    QAtomicInteger<quint64> mCount;
+    QAtomicInteger<qint64> mSumUs;
+};
+
+// Metrics of one statement (or of all statements of a client)
+struct DbStatementMetrics
+{
+    DbHistogram queueWait;
+    DbHistogram prepare;
+    DbHistogram exec;
+    DbHistogram fetch;
+    QAtomicInteger<quint64> executions;
+    QAtomicInteger<quint64> errors;
+    QAtomicInteger<quint64> rows;
+    QAtomicInteger<quint64> bytes;
+};
+
+// Metrics of one client, shared by all of its pooled connections.
+// Statements are told apart by SQL text; beyond maxStatements distinct
+// ones, the rest are counted together as OTHER_STATEMENT.
+class LIBSHARED_EXPORT DbMetrics
+{
+public:
+    static const QString OTHER_STATEMENT;
+
+    explicit DbMetrics(int maxStatements = 256);
+    DbMetrics(const DbMetrics&) = delete;
+    void operator=(const DbMetrics&) = delete;
+
+    DbStatementMetrics& total() { return mTotal; }
+    const DbStatementMetrics& total() const { return mTotal; }
+    DbStatementMetrics* statement(const QString& queryString);
+    const DbStatementMetrics* findStatement(const QString& queryString) const;
+    QStringList statements() const;
+
+    void queryStarted() { mInFlight.ref(); }
+    void queryFinished() { mInFlight.deref(); }
+    int inFlight() const { return mInFlight.loadAcquire(); }
+    void connectionOpened() { mConnectionsOpened.fetchAndAddRelaxed(1); }
+    void connectionClosed() { mConnectionsClosed.fetchAndAddRelaxed(1); }
+    quint64 connectionsOpened() const { return mConnectionsOpened.loadAcquire(); }
+    quint64 connectionsClosed() const { return mConnectionsClosed.loadAcquire(); }
+    void recordError(const QSqlError& error, DbStatementMetrics* statement);
+    QMap<QString, quint64> errorsBySqlState() const;
+
+    QString toPrometheus(const QString& clientName) const;
+    static QString toPrometheus(
+            const QList<QPair<QString, const DbMetrics*>>& clients);
+    static QString sqlStateOf(const QSqlError& error);
+
+private:
+    int mMaxStatements;
+    DbStatementMetrics mTotal;
+    QHash<QString, QSharedPointer<DbStatementMetrics>> mStatements;
+    QAtomicInt mInFlight;
+    QAtomicInteger<quint64> mConnectionsOpened;
+    QAtomicInteger<quint64> mConnectionsClosed;
+    QMap<QString, quint64> mErrorsBySqlState;
+
+    mutable QReadWriteLock mStatementsLock;
+    mutable QMutex mErrorsMutex;
+};
+
+#endif // DBMETRICS_H
@@ -0,0 +1,1065 @@
+#include "dbodbc.h"
+#include "constants.h"
+#include "dbconnection.h"
+
+#include <QDate>
+#include <QDateTime>
+#include <QSqlDriver>
+#include <QSqlField>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QVector>
+#include <cstring>
+
+static_assert(sizeof(SQLWCHAR) == sizeof(ushort),
+              "SQLWCHAR has to be UTF-16 to pass QString data directly");
+
+namespace
+{
+    // Column-wise bound parameter array
+    struct ParamColumn
+    {
+        SQLSMALLINT cType = SQL_C_CHAR;
+        SQLSMALLINT sqlType = SQL_VARCHAR;
+        SQLULEN columnSize = 0;
+        SQLSMALLINT decimalDigits = 0;
+        SQLLEN width = 0;
+        QByteArray buffer;
+        QVector<SQLLEN> indicators;
+    };
+
+    // Buffer type a value would be bound with
+    QVariant::Type bufferTypeOf(QVariant::Type type)
+    {
+        switch (type)
+        {
+        case QVariant::Bool:
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            return QVariant::LongLong;
+        case QVariant::Double:
+        case QVariant::ByteArray:
+            return type;
+        case QVariant::Date:
+        case QVariant::DateTime:
+            return QVariant::DateTime;
+        default:
+            return QVariant::String;
+        }
+    }
+
+    // All non-null values decide. Integers mixed with doubles are bound
+    // as doubles, any other mix of types as text.
+    QVariant::Type columnTypeOf(const QVariantList& column, int offset, int count)
+    {
+        QVariant::Type ans = QVariant::Invalid;
+        for (int i = offset; i < offset + count; ++i)
+        {
+            if (column[i].isNull())
+                continue;
+
+            QVariant::Type type = bufferTypeOf(column[i].type());
+            if (ans == QVariant::Invalid || ans == type)
+            {
+                ans = type;
+            }
+            else if ((ans == QVariant::LongLong || ans == QVariant::Double) &&
+                     (type == QVariant::LongLong || type == QVariant::Double))
+            {
+                ans = QVariant::Double;
+            }
+            else
+            {
+                return QVariant::String;
+            }
+        }
+
+        return ans == QVariant::Invalid ? QVariant::String : ans;
+    }
+
+    void fillColumn(
+            ParamColumn& param,
+            const QVariantList& column,
+            int offset,
+            int count)
+    {
+        param.indicators.resize(count);
+
+        switch (columnTypeOf(column, offset, count))
+        {
+        case QVariant::Bool:
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+        {
+            param.cType = SQL_C_SBIGINT;
+            param.sqlType = SQL_BIGINT;
+            param.width = sizeof(qint64);
+            param.buffer.resize(count * param.width);
+            qint64* values = reinterpret_cast<qint64*>(param.buffer.data());
+            for (int i = 0; i < count; ++i)
+            {
+                const QVariant& v = column[offset + i];
+                values[i] = v.isNull() ? 0 : v.toLongLong();
+                param.indicators[i] = v.isNull() ? SQL_NULL_DATA : 0;
+            }
+            break;
+        }
+        case QVariant::Double:
+        {
+            param.cType = SQL_C_DOUBLE;
+            param.sqlType = SQL_DOUBLE;
+            param.width = sizeof(double);
+            param.buffer.resize(count * param.width);
+            double* values = reinterpret_cast<double*>(param.buffer.data());
+            for (int i = 0; i < count; ++i)
+            {
+                const QVariant& v = column[offset + i];
+                values[i] = v.isNull() ? 0.0 : v.toDouble();
+                param.indicators[i] = v.isNull() ? SQL_NULL_DATA : 0;
+            }
+            break;
+        }
+        case QVariant::Date:
+        case QVariant::DateTime:
+        {
+            param.cType = SQL_C_TYPE_TIMESTAMP;
+            param.sqlType = SQL_TYPE_TIMESTAMP;
+            param.columnSize = 23;
+            param.decimalDigits = 3;
+            param.width = sizeof(SQL_TIMESTAMP_STRUCT);
+            param.buffer.fill(0, count * param.width);
+            SQL_TIMESTAMP_STRUCT* values =
+                    reinterpret_cast<SQL_TIMESTAMP_STRUCT*>(param.buffer.data());
+            for (int i = 0; i < count; ++i)
+            {
+                const QVariant& v = column[offset + i];
+                param.indicators[i] = v.isNull() ? SQL_NULL_DATA : 0;
+                if (v.isNull())
+                    continue;
+
+                QDateTime dt = v.toDateTime();
+                values[i].year = static_cast<SQLSMALLINT>(dt.date().year());
+                values[i].month = static_cast<SQLUSMALLINT>(dt.date().month());
+                values[i].day = static_cast<SQLUSMALLINT>(dt.date().day());
+                values[i].hour = static_cast<SQLUSMALLINT>(dt.time().hour());
+                values[i].minute = static_cast<SQLUSMALLINT>(dt.time().minute());
+                values[i].second = static_cast<SQLUSMALLINT>(dt.time().second());
+                values[i].fraction = static_cast<SQLUINTEGER>(dt.time().msec()) * 1000000;
+            }
+            break;
+        }
+        case QVariant::ByteArray:
+        {
+            int maxLen = 1;
+            for (int i = offset; i < offset + count; ++i)
+                maxLen = qMax(maxLen, column[i].toByteArray().size());
+
+            param.cType = SQL_C_BINARY;
+            param.sqlType = maxLen > 8000 ? SQL_LONGVARBINARY : SQL_VARBINARY;
+            param.columnSize = maxLen;
+            param.width = maxLen;
+            param.buffer.fill(0, count * param.width);
+            for (int i = 0; i < count; ++i)
+            {
+                const QVariant& v = column[offset + i];
+                QByteArray bytes = v.toByteArray();
+                std::memcpy(param.buffer.data() + i * param.width,
+                            bytes.constData(), bytes.size());
+                param.indicators[i] = v.isNull() ? SQL_NULL_DATA : bytes.size();
+            }
+            break;
+        }
+        default:
+        {
+            int maxLen = 1;
+            for (int i = offset; i < offset + count; ++i)
+                maxLen = qMax(maxLen, column[i].toString().size());
+
+            param.cType = SQL_C_WCHAR;
+            param.sqlType = maxLen > 4000 ? SQL_WLONGVARCHAR : SQL_WVARCHAR;
+            param.columnSize = maxLen;
+            param.width = (maxLen + 1) * sizeof(SQLWCHAR);
+            param.buffer.fill(0, count * param.width);
+            for (int i = 0; i < count; ++i)
+            {
+                const QVariant& v = column[offset + i];
+                QString str = v.toString();
+                std::memcpy(param.buffer.data() + i * param.width,
+                            str.utf16(), str.size() * sizeof(SQLWCHAR));
+                param.indicators[i] = v.isNull()
+                        ? SQL_NULL_DATA
+                        : static_cast<SQLLEN>(str.size() * sizeof(SQLWCHAR));
+            }
+            break;
+        }
+        }
+    }
+
+    // SQL Server types not in sqlext.h
+    const SQLSMALLINT SS_TIME2 = -154;
+
+    // Wider columns (MAX types, xml...) are read with SQLGetData
+    const SQLULEN MAX_BOUND_CHARS = 4000;
+    const SQLULEN MAX_BOUND_BYTES = 8000;
+    const int GET_DATA_CHUNK_BYTES = 32 * 1024;
+    const int FETCH_BUFFER_BYTES = 8 * 1024 * 1024;
+
+    // Column-wise bound result array
+    struct ResultColumn
+    {
+        SQLSMALLINT cType = SQL_C_WCHAR;
+        SQLLEN width = 0;
+        bool bindable = true;
+        QByteArray buffer;
+        QVector<SQLLEN> indicators;
+    };
+
+    // Same field types as QODBC reports, except DECIMAL and NUMERIC:
+    // their exact text is kept and converted to double by value()
+    DbResultSet::ColumnType describeColumn(
+            SQLHSTMT hstmt,
+            int index,
+            QSqlField& field,
+            ResultColumn& column)
+    {
+        SQLWCHAR name[256];
+        SQLSMALLINT nameLen = 0;
+        SQLSMALLINT sqlType = 0;
+        SQLULEN size = 0;
+        SQLSMALLINT digits = 0;
+        SQLSMALLINT nullable = 0;
+        SQLDescribeColW(hstmt, static_cast<SQLUSMALLINT>(index + 1),
+                        name, 256, &nameLen, &sqlType, &size, &digits, &nullable);
+
+        QString fieldName = QString::fromUtf16(
+                    reinterpret_cast<const ushort*>(name), qBound(0, int(nameLen), 255));
+        DbResultSet::ColumnType type = DbResultSet::ColumnType::TEXT;
+        QVariant::Type fieldType = QVariant::String;
+
+        switch (sqlType)
+        {
+        case SQL_BIT:
+        case SQL_TINYINT:
+        case SQL_SMALLINT:
+        case SQL_INTEGER:
+        case SQL_BIGINT:
+            fieldType = sqlType == SQL_BIT ? QVariant::Bool :
+                        sqlType == SQL_BIGINT ? QVariant::LongLong : QVariant::Int;
+            type = DbResultSet::ColumnType::INTEGER;
+            column.cType = SQL_C_SBIGINT;
+            column.width = sizeof(qint64);
+            break;
+        case SQL_REAL:
+        case SQL_FLOAT:
+        case SQL_DOUBLE:
+            fieldType = QVariant::Double;
+            type = DbResultSet::ColumnType::REAL;
+            column.cType = SQL_C_DOUBLE;
+            column.width = sizeof(double);
+            break;
+        case SQL_DECIMAL:
+        case SQL_NUMERIC:
+            // Sign, decimal point and terminator
+            fieldType = QVariant::Double;
+            column.width = static_cast<SQLLEN>((size + 3) * sizeof(SQLWCHAR));
+            break;
+        case SQL_TYPE_DATE:
+            fieldType = QVariant::Date;
+            type = DbResultSet::ColumnType::VARIANT;
+            column.cType = SQL_C_TYPE_DATE;
+            column.width = sizeof(SQL_DATE_STRUCT);
+            break;
+        case SQL_TYPE_TIME:
+        case SS_TIME2:
+            fieldType = QVariant::Time;
+            type = DbResultSet::ColumnType::VARIANT;
+            column.cType = SQL_C_TYPE_TIME;
+            column.width = sizeof(SQL_TIME_STRUCT);
+            break;
+        case SQL_TYPE_TIMESTAMP:
+            fieldType = QVariant::DateTime;
+            type = DbResultSet::ColumnType::VARIANT;
+            column.cType = SQL_C_TYPE_TIMESTAMP;
+            column.width = sizeof(SQL_TIMESTAMP_STRUCT);
+            break;
+        case SQL_BINARY:
+        case SQL_VARBINARY:
+        case SQL_LONGVARBINARY:
+            fieldType = QVariant::ByteArray;
+            type = DbResultSet::ColumnType::BLOB;
+            column.cType = SQL_C_BINARY;
+            column.bindable = size > 0 && size <= MAX_BOUND_BYTES;
+            column.width = column.bindable ? static_cast<SQLLEN>(size) : 0;
+            break;
+        default:
+            column.bindable = size > 0 && size <= MAX_BOUND_CHARS;
+            column.width = column.bindable
+                    ? static_cast<SQLLEN>((size + 1) * sizeof(SQLWCHAR))
+                    : 0;
+            break;
+        }
+
+        field = QSqlField(fieldName, fieldType);
+        field.setRequiredStatus(nullable == SQL_NO_NULLS
+                                ? QSqlField::Required
+                                : QSqlField::Optional);
+        return type;
+    }
+
+    // Cell row of a bound array (or of a single SQLGetData value).
+    // Fails on truncated data, the bound width was too small.
+    bool appendCell(
+            DbResultSet& result,
+            int index,
+            const ResultColumn& column,
+            int row)
+    {
+        SQLLEN indicator = column.indicators[row];
+        if (indicator == SQL_NULL_DATA)
+        {
+            result.appendNull(index);
+            return true;
+        }
+
+        const char* cell = column.buffer.constData() + row * column.width;
+        switch (column.cType)
+        {
+        case SQL_C_SBIGINT:
+            result.appendInt(index, *reinterpret_cast<const qint64*>(cell));
+            break;
+        case SQL_C_DOUBLE:
+            result.appendDouble(index, *reinterpret_cast<const double*>(cell));
+            break;
+        case SQL_C_TYPE_DATE:
+        {
+            const SQL_DATE_STRUCT* d = reinterpret_cast<const SQL_DATE_STRUCT*>(cell);
+            result.appendVariant(index, QDate(d->year, d->month, d->day));
+            break;
+        }
+        case SQL_C_TYPE_TIME:
+        {
+            const SQL_TIME_STRUCT* t = reinterpret_cast<const SQL_TIME_STRUCT*>(cell);
+            result.appendVariant(index, QTime(t->hour, t->minute, t->second));
+            break;
+        }
+        case SQL_C_TYPE_TIMESTAMP:
+        {
+            const SQL_TIMESTAMP_STRUCT* ts =
+                    reinterpret_cast<const SQL_TIMESTAMP_STRUCT*>(cell);
+            result.appendVariant(index, QDateTime(
+                                     QDate(ts->year, ts->month, ts->day),
+                                     QTime(ts->hour, ts->minute, ts->second,
+                                           static_cast<int>(ts->fraction / 1000000))));
+            break;
+        }
+        case SQL_C_BINARY:
+            if (indicator == SQL_NO_TOTAL || indicator > column.width)
+                return false;
+
+            result.appendBlob(index, cell, static_cast<int>(indicator));
+            break;
+        default:
+            if (indicator == SQL_NO_TOTAL ||
+                    indicator > column.width - static_cast<SQLLEN>(sizeof(SQLWCHAR)))
+                return false;
+
+            result.appendText(index, reinterpret_cast<const QChar*>(cell),
+                              static_cast<int>(indicator / sizeof(SQLWCHAR)));
+            break;
+        }
+
+        return true;
+    }
+
+    // Whole value of a long column, read in chunks
+    bool appendLongCell(
+            SQLHSTMT hstmt,
+            DbResultSet& result,
+            int index,
+            const ResultColumn& column,
+            QByteArray& chunk)
+    {
+        SQLLEN terminator = column.cType == SQL_C_BINARY ? 0 : sizeof(SQLWCHAR);
+        QByteArray data;
+        forever
+        {
+            SQLLEN indicator = 0;
+            SQLRETURN retcode = SQLGetData(
+                        hstmt, static_cast<SQLUSMALLINT>(index + 1), column.cType,
+                        chunk.data(), chunk.size(), &indicator);
+            if (retcode == SQL_NO_DATA)
+                break;
+            if (!SQL_SUCCEEDED(retcode))
+                return false;
+
+            if (indicator == SQL_NULL_DATA)
+            {
+                result.appendNull(index);
+                return true;
+            }
+
+            SQLLEN available = chunk.size() - terminator;
+            if (indicator != SQL_NO_TOTAL && indicator < available)
+                available = indicator;
+
+            data.append(chunk.constData(), static_cast<int>(available));
+            if (retcode == SQL_SUCCESS)
+                break;
+        }
+
+        if (column.cType == SQL_C_BINARY)
+        {
+            result.appendBlob(index, data.constData(), data.size());
+        }
+        else
+        {
+            result.appendText(index, reinterpret_cast<const QChar*>(data.constData()),
+                              data.size() / static_cast<int>(sizeof(SQLWCHAR)));
+        }
+
+        return true;
+    }
+
+    // Block fetch: rowArraySize rows per SQLFetch into bound arrays
+    bool fetchBlocks(
+            SQLHSTMT hstmt,
+            QVector<ResultColumn>& columns,
+            int rowArraySize,
+            DbResultSet& result)
+    {
+        SQLULEN fetched = 0;
+        QVector<SQLUSMALLINT> status(rowArraySize, SQL_ROW_NOROW);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_BIND_TYPE,
+                       reinterpret_cast<SQLPOINTER>(SQL_BIND_BY_COLUMN), 0);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_ARRAY_SIZE,
+                       reinterpret_cast<SQLPOINTER>(static_cast<SQLULEN>(rowArraySize)), 0);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_ROW_STATUS_PTR, status.data(), 0);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+
+        for (int c = 0; c < columns.size(); ++c)
+        {
+            ResultColumn& column = columns[c];
+            column.buffer.fill(0, rowArraySize * column.width);
+            column.indicators.resize(rowArraySize);
+            SQLBindCol(hstmt, static_cast<SQLUSMALLINT>(c + 1), column.cType,
+                       column.buffer.data(), column.width, column.indicators.data());
+        }
+
+        SQLRETURN retcode;
+        while (SQL_SUCCEEDED(retcode = SQLFetch(hstmt)))
+        {
+            for (SQLULEN row = 0; row < fetched; ++row)
+            {
+                if (status[row] == SQL_ROW_ERROR)
+                    return false;
+
+                for (int c = 0; c < columns.size(); ++c)
+                {
+                    if (!appendCell(result, c, columns[c], static_cast<int>(row)))
+                        return false;
+                }
+
+                result.finishRow();
+            }
+        }
+
+        SQLFreeStmt(hstmt, SQL_UNBIND);
+        return retcode == SQL_NO_DATA;
+    }
+
+    // Row by row with SQLGetData, when a column is too wide to bind
+    bool fetchRows(
+            SQLHSTMT hstmt,
+            QVector<ResultColumn>& columns,
+            DbResultSet& result)
+    {
+        QByteArray chunk(GET_DATA_CHUNK_BYTES, 0);
+        for (ResultColumn& column : columns)
+        {
+            column.buffer.fill(0, column.width);
+            column.indicators.resize(1);
+        }
+
+        SQLRETURN retcode;
+        while (SQL_SUCCEEDED(retcode = SQLFetch(hstmt)))
+        {
+            for (int c = 0; c < columns.size(); ++c)
+            {
+                ResultColumn& column = columns[c];
+                bool succ;
+                if (column.cType == SQL_C_WCHAR || column.cType == SQL_C_BINARY)
+                {
+                    succ = appendLongCell(hstmt, result, c, column, chunk);
+                }
+                else
+                {
+                    succ = SQL_SUCCEEDED(SQLGetData(
+                                             hstmt, static_cast<SQLUSMALLINT>(c + 1),
+                                             column.cType, column.buffer.data(),
+                                             column.width, column.indicators.data()))
+                            && appendCell(result, c, column, 0);
+                }
+
+                if (!succ)
+                    return false;
+            }
+
+            result.finishRow();
+        }
+
+        return retcode == SQL_NO_DATA;
+    }
+
+    // Statement with the key of a blob bound as parameter number
+    SQLHSTMT prepareBlobStatement(
+            SQLHDBC hdbc,
+            const QString& queryString,
+            ParamColumn& key,
+            SQLUSMALLINT number,
+            QString& errorText)
+    {
+        SQLHSTMT hstmt = nullptr;
+        if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &hstmt)))
+        {
+            errorText = DbOdbc::diagnosticsText(SQL_HANDLE_DBC, hdbc);
+            return nullptr;
+        }
+
+        SQLRETURN retcode = SQLPrepareW(
+                    hstmt,
+                    reinterpret_cast<SQLWCHAR*>(const_cast<ushort*>(queryString.utf16())),
+                    SQL_NTS);
+        if (SQL_SUCCEEDED(retcode))
+        {
+            retcode = SQLBindParameter(
+                        hstmt, number, SQL_PARAM_INPUT, key.cType, key.sqlType,
+                        key.columnSize, key.decimalDigits, key.buffer.data(),
+                        key.width, key.indicators.data());
+        }
+
+        if (!SQL_SUCCEEDED(retcode))
+        {
+            errorText = DbOdbc::diagnosticsText(SQL_HANDLE_STMT, hstmt);
+            SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+            return nullptr;
+        }
+
+        return hstmt;
+    }
+
+    // Some drivers need the full length of a data-at-execution value
+    // before the first SQLPutData
+    bool needsLongDataLength(SQLHDBC hdbc)
+    {
+        SQLWCHAR answer[2] = { 0, 0 };
+        SQLSMALLINT length = 0;
+        SQLRETURN retcode = SQLGetInfoW(
+                    hdbc, SQL_NEED_LONG_DATA_LEN, answer, sizeof(answer), &length);
+        return SQL_SUCCEEDED(retcode) && answer[0] == 'Y';
+    }
+}
+
+
+bool DbOdbc::isOdbc(const QSqlDatabase& db)
+{
+    return db.driverName().startsWith("QODBC");
+}
+
+
+SQLHDBC DbOdbc::connectionHandle(const QSqlDatabase& db)
+{
+    if (!isOdbc(db) || !db.isOpen())
+        return nullptr;
+
+    QVariant v = db.driver()->handle();
+    if (!v.isValid() || v.isNull() || qstrcmp(v.typeName(), "SQLHANDLE") != 0)
+        return nullptr;
+
+    return *static_cast<SQLHDBC*>(v.data());
+}
+
+
+QMap<QString, QString> DbOdbc::diagnostics(
+        SQLSMALLINT handleType,
+        SQLHANDLE handle)
+{
+    QMap<QString, QString> diagData;
+    SQLCHAR sqlState[6], msg[SQL_MAX_MESSAGE_LENGTH];
+    SQLINTEGER nativeError;
+    SQLSMALLINT msgLen, i = 1;
+
+    while (SQL_SUCCEEDED(SQLGetDiagRec(handleType, handle, i, sqlState,
+                                       &nativeError, msg, sizeof (msg),
+                                       &msgLen)))
+    {
+        diagData.insert(
+                    QString::fromUtf8(reinterpret_cast<char*>(sqlState)),
+                    QString::fromUtf8(reinterpret_cast<char*>(msg)));
+        ++i;
+    }
+
+    return diagData;
+}
+
+
+QString DbOdbc::diagnosticsText(SQLSMALLINT handleType, SQLHANDLE handle)
+{
+    QStringList lines;
+    QMap<QString, QString> diagData = diagnostics(handleType, handle);
+    for (auto it = diagData.cbegin(); it != diagData.cend(); ++it)
+    {
+        lines.append(QString("[%1] %2").arg(it.key(), it.value()));
+    }
+
+    return lines.join("; ");
+}
+
+
+// SQLSTATE of the first diagnostic record as native code, the retry
+// policy classifies by it
+QSqlError DbOdbc::diagnosticsError(SQLSMALLINT handleType, SQLHANDLE handle)
+{
+    SQLCHAR sqlState[6];
+    SQLINTEGER nativeError;
+    SQLSMALLINT msgLen;
+    QString code;
+    if (SQL_SUCCEEDED(SQLGetDiagRec(handleType, handle, 1, sqlState,
+                                    &nativeError, nullptr, 0, &msgLen)))
+    {
+        code = QString::fromUtf8(reinterpret_cast<char*>(sqlState));
+    }
+
+    return QSqlError(
+                QString(),
+                diagnosticsText(handleType, handle),
+                QSqlError::StatementError,
+                code);
+}
+
+
+// Executes the statement once per paramsetSize rows with ODBC parameter
+// arrays (SQL_ATTR_PARAMSET_SIZE). Statement has to use ? placeholders.
+// A cancelled connection stops the batch, rows not sent count as failed.
+DbBatchResult DbOdbc::executeBatch(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QVariantList>& columns,
+        int paramsetSize)
+{
+    DbBatchResult ans;
+    SQLHDBC hdbc = connectionHandle(connection.database());
+    if (hdbc == nullptr)
+    {
+        ans.errorText = "No ODBC connection handle";
+        return ans;
+    }
+
+    SQLHSTMT hstmt = nullptr;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &hstmt)))
+    {
+        ans.setError(diagnosticsError(SQL_HANDLE_DBC, hdbc));
+        return ans;
+    }
+
+    SQLRETURN retcode = SQLPrepareW(
+                hstmt,
+                reinterpret_cast<SQLWCHAR*>(const_cast<ushort*>(queryString.utf16())),
+                SQL_NTS);
+    if (!SQL_SUCCEEDED(retcode))
+    {
+        ans.setError(diagnosticsError(SQL_HANDLE_STMT, hstmt));
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return ans;
+    }
+
+    int rows = columns.isEmpty() ? 0 : columns.first().size();
+    paramsetSize = qMax(1, paramsetSize);
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_BIND_TYPE,
+                   reinterpret_cast<SQLPOINTER>(SQL_PARAM_BIND_BY_COLUMN), 0);
+
+    for (int offset = 0; offset < rows; offset += paramsetSize)
+    {
+        int count = qMin(paramsetSize, rows - offset);
+        QVector<ParamColumn> params(columns.size());
+        QVector<SQLUSMALLINT> status(count, SQL_PARAM_UNUSED);
+        SQLULEN processed = 0;
+
+        for (int c = 0; c < columns.size(); ++c)
+        {
+            ParamColumn& param = params[c];
+            fillColumn(param, columns[c], offset, count);
+            SQLBindParameter(
+                        hstmt,
+                        static_cast<SQLUSMALLINT>(c + 1),
+                        SQL_PARAM_INPUT,
+                        param.cType,
+                        param.sqlType,
+                        param.columnSize,
+                        param.decimalDigits,
+                        param.buffer.data(),
+                        param.width,
+                        param.indicators.data());
+        }
+
+        SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMSET_SIZE,
+                       reinterpret_cast<SQLPOINTER>(static_cast<SQLULEN>(count)), 0);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_STATUS_PTR, status.data(), 0);
+        SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &processed, 0);
+
+        if (!connection.beginStatement(hstmt))
+        {
+            ans.setError(connection.cancelError());
+            for (int i = offset; i < rows; ++i)
+            {
+                ans.failedRows.append(i);
+            }
+            break;
+        }
+
+        retcode = SQLExecute(hstmt);
+        if (retcode == SQL_ERROR && ans.errorText.isEmpty())
+            ans.setError(diagnosticsError(SQL_HANDLE_STMT, hstmt));
+
+        for (int i = 0; i < count; ++i)
+        {
+            bool failed = status[i] == SQL_PARAM_ERROR ||
+                    status[i] == SQL_PARAM_UNUSED ||
+                    (status[i] == SQL_PARAM_DIAG_UNAVAILABLE &&
+                     retcode == SQL_ERROR);
+            if (failed)
+                ans.failedRows.append(offset + i);
+        }
+
+        SQLLEN rowCount = 0;
+        if (SQL_SUCCEEDED(SQLRowCount(hstmt, &rowCount)) && rowCount > 0)
+            ans.rowsAffected += rowCount;
+
+        // Every row may produce its own result, all of them have to be
+        // consumed before the statement is executed again
+        while (SQL_SUCCEEDED(SQLMoreResults(hstmt)))
+        {
+            if (SQL_SUCCEEDED(SQLRowCount(hstmt, &rowCount)) && rowCount > 0)
+                ans.rowsAffected += rowCount;
+        }
+
+        connection.endStatement();
+        SQLFreeStmt(hstmt, SQL_CLOSE);
+        SQLFreeStmt(hstmt, SQL_RESET_PARAMS);
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+
+    ans.succ = ans.failedRows.isEmpty() && ans.errorText.isEmpty();
+    return ans;
+}
+
+
+// Fetches the rows of a query straight into the typed columns of
+// result, without QSqlRecord and QVariant per cell. Up to rowArraySize
+// rows come with one SQLFetch (SQL_ATTR_ROW_ARRAY_SIZE), fewer when the
+// bound buffers would get too big. Results with long columns (MAX types,
+// xml...) are fetched row by row with SQLGetData.
+bool DbOdbc::executeResultSet(
+        DbConnection& connection,
+        const QString& queryString,
+        int rowArraySize,
+        DbResultSet& result,
+        QString& errorText)
+{
+    result.clear();
+    SQLHDBC hdbc = connectionHandle(connection.database());
+    if (hdbc == nullptr)
+    {
+        errorText = "No ODBC connection handle";
+        return false;
+    }
+
+    SQLHSTMT hstmt = nullptr;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &hstmt)))
+    {
+        errorText = diagnosticsText(SQL_HANDLE_DBC, hdbc);
+        return false;
+    }
+
+    if (!connection.beginStatement(hstmt))
+    {
+        errorText = connection.cancelError().text();
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return false;
+    }
+
+    bool succ = false;
+    SQLRETURN retcode = SQLExecDirectW(
+                hstmt,
+                reinterpret_cast<SQLWCHAR*>(const_cast<ushort*>(queryString.utf16())),
+                SQL_NTS);
+    SQLSMALLINT columnCount = 0;
+    if (SQL_SUCCEEDED(retcode) || retcode == SQL_NO_DATA)
+        succ = SQL_SUCCEEDED(SQLNumResultCols(hstmt, &columnCount));
+
+    if (succ && columnCount > 0)
+    {
+        QSqlRecord record;
+        QVector<DbResultSet::ColumnType> types(columnCount);
+        QVector<ResultColumn> columns(columnCount);
+        bool bindable = true;
+        SQLLEN rowWidth = 0;
+        for (int c = 0; c < columnCount; ++c)
+        {
+            QSqlField field;
+            types[c] = describeColumn(hstmt, c, field, columns[c]);
+            record.append(field);
+            bindable = bindable && columns[c].bindable;
+            rowWidth += columns[c].width + sizeof(SQLLEN);
+        }
+
+        result.setColumns(record, types);
+        if (bindable)
+        {
+            int rows = qBound(1, rowArraySize,
+                              static_cast<int>(qMax<SQLLEN>(1, FETCH_BUFFER_BYTES / rowWidth)));
+            succ = fetchBlocks(hstmt, columns, rows, result);
+        }
+        else
+        {
+            succ = fetchRows(hstmt, columns, result);
+        }
+    }
+
+    if (!succ)
+    {
+        errorText = connection.isCancelled()
+                ? connection.cancelError().text()
+                : diagnosticsText(SQL_HANDLE_STMT, hstmt);
+        if (errorText.isEmpty())
+            errorText = "Fetched data does not fit the bound column buffers";
+    }
+
+    connection.endStatement();
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return succ;
+}
+
+
+// Value of the only column of queryString ("SELECT blob ... WHERE key = ?"),
+// read with SQLGetData chunkSize bytes at a time
+DbBlobResult DbOdbc::readBlob(
+        DbConnection& connection,
+        const QString& queryString,
+        const QVariant& key,
+        QIODevice* target,
+        int chunkSize)
+{
+    DbBlobResult ans;
+    SQLHDBC hdbc = connectionHandle(connection.database());
+    if (hdbc == nullptr)
+    {
+        ans.errorText = "No ODBC connection handle";
+        return ans;
+    }
+
+    ParamColumn keyParam;
+    fillColumn(keyParam, QVariantList { key }, 0, 1);
+    SQLHSTMT hstmt = prepareBlobStatement(hdbc, queryString, keyParam, 1, ans.errorText);
+    if (hstmt == nullptr)
+        return ans;
+
+    if (!connection.beginStatement(hstmt))
+    {
+        ans.errorText = connection.cancelError().text();
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return ans;
+    }
+
+    SQLRETURN retcode = SQLExecute(hstmt);
+    if (SQL_SUCCEEDED(retcode))
+        retcode = SQLFetch(hstmt);
+    if (retcode == SQL_NO_DATA)
+        ans.errorText = "No row with the blob key";
+
+    QByteArray chunk(qMax(1, chunkSize), 0);
+    bool failed = !SQL_SUCCEEDED(retcode);
+    while (!failed)
+    {
+        SQLLEN indicator = 0;
+        retcode = SQLGetData(hstmt, 1, SQL_C_BINARY, chunk.data(), chunk.size(), &indicator);
+        if (retcode == SQL_NO_DATA)
+            break;
+
+        failed = !SQL_SUCCEEDED(retcode);
+        if (failed)
+            break;
+
+        if (indicator == SQL_NULL_DATA)
+        {
+            ans.null = true;
+            break;
+        }
+
+        SQLLEN available = chunk.size();
+        if (indicator != SQL_NO_TOTAL && indicator < available)
+            available = indicator;
+
+        failed = !DbBlob::write(target, chunk.constData(), available, ans);
+        if (retcode == SQL_SUCCESS)
+            break;
+    }
+
+    if (failed && ans.errorText.isEmpty())
+    {
+        ans.errorText = connection.isCancelled()
+                ? connection.cancelError().text()
+                : diagnosticsText(SQL_HANDLE_STMT, hstmt);
+    }
+
+    connection.endStatement();
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
+
+
+// Executes queryString ("UPDATE ... SET blob = ? WHERE key = ?") with
+// the blob as data-at-execution parameter, sent with SQLPutData
+// chunkSize bytes at a time until the source has no more data
+DbBlobResult DbOdbc::writeBlob(
+        DbConnection& connection,
+        const QString& queryString,
+        const QVariant& key,
+        QIODevice* source,
+        int chunkSize)
+{
+    DbBlobResult ans;
+    SQLHDBC hdbc = connectionHandle(connection.database());
+    if (hdbc == nullptr)
+    {
+        ans.errorText = "No ODBC connection handle";
+        return ans;
+    }
+
+    ParamColumn keyParam;
+    fillColumn(keyParam, QVariantList { key }, 0, 1);
+    SQLHSTMT hstmt = prepareBlobStatement(hdbc, queryString, keyParam, 2, ans.errorText);
+    if (hstmt == nullptr)
+        return ans;
+
+    SQLLEN blobIndicator = SQL_DATA_AT_EXEC;
+    if (needsLongDataLength(hdbc))
+    {
+        if (source->isSequential())
+        {
+            ans.errorText = "The ODBC driver needs the blob size, "
+                            "a sequential device does not know it";
+            SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+            return ans;
+        }
+
+        blobIndicator = SQL_LEN_DATA_AT_EXEC(
+                    static_cast<SQLLEN>(source->size() - source->pos()));
+    }
+
+    if (!SQL_SUCCEEDED(SQLBindParameter(
+                           hstmt, 1, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
+                           0, 0, nullptr, 0, &blobIndicator)))
+    {
+        ans.errorText = diagnosticsText(SQL_HANDLE_STMT, hstmt);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return ans;
+    }
+
+    if (!connection.beginStatement(hstmt))
+    {
+        ans.errorText = connection.cancelError().text();
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return ans;
+    }
+
+    SQLPOINTER token = nullptr;
+    SQLRETURN retcode = SQLExecute(hstmt);
+    if (retcode == SQL_NEED_DATA)
+        retcode = SQLParamData(hstmt, &token);
+
+    if (retcode == SQL_NEED_DATA)
+    {
+        // A read of 0 bytes only means no data yet on sequential devices
+        // (sockets, processes), they are waited for until they end
+        QByteArray chunk(qMax(1, chunkSize), 0);
+        bool sent = false;
+        while (!source->atEnd() || !sent)
+        {
+            if (connection.isCancelled())
+            {
+                ans.errorText = connection.cancelError().text();
+                break;
+            }
+
+            if (source->isSequential() && source->bytesAvailable() == 0 &&
+                    !source->atEnd() &&
+                    !source->waitForReadyRead(DbConstants::DEFAULT_BLOB_READ_TIMEOUT_MS))
+            {
+                ans.errorText = source->errorString().isEmpty()
+                        ? QString("Timed out waiting for blob data")
+                        : source->errorString();
+                break;
+            }
+
+            qint64 read = source->read(chunk.data(), chunk.size());
+            if (read < 0)
+            {
+                ans.errorText = source->errorString();
+                break;
+            }
+
+            // Empty blob still needs one call, no call at all means NULL
+            if (read == 0 && sent && source->isSequential())
+                continue;
+            else if (read == 0 && sent)
+                break;
+
+            if (!SQL_SUCCEEDED(SQLPutData(hstmt, chunk.data(), static_cast<SQLLEN>(read))))
+            {
+                ans.errorText = diagnosticsText(SQL_HANDLE_STMT, hstmt);
+                break;
+            }
+
+            ans.bytes += read;
+            sent = true;
+        }
+
+        if (ans.errorText.isEmpty())
+        {
+            retcode = SQLParamData(hstmt, &token);
+        }
+        else
+        {
+            // Ends the data-at-execution sequence without executing
+            SQLCancel(hstmt);
+        }
+    }
+
+    // SQL_NO_DATA: the update matched no row
+    SQLLEN rowCount = 0;
+    if (ans.errorText.isEmpty() && retcode != SQL_NO_DATA && !SQL_SUCCEEDED(retcode))
+    {
+        ans.errorText = connection.isCancelled()
+                ? connection.cancelError().text()
+                : diagnosticsText(SQL_HANDLE_STMT, hstmt);
+    }
+    else if (ans.errorText.isEmpty() &&
+             (retcode == SQL_NO_DATA ||
+              (SQL_SUCCEEDED(SQLRowCount(hstmt, &rowCount)) && rowCount == 0)))
+    {
+        ans.errorText = "No row with the blob key";
+    }
+
+    connection.endStatement();
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
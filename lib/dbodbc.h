@@ -0,0 +1,60 @@
+#ifndef DBODBC_H
+#define DBODBC_H
+
+#include <QList>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QString>
+#include <QVariant>
+#include "dbbatchresult.h"
+#include "dbblob.h"
+#include "dbresultset.h"
+
+class DbConnection;
+
+#if defined(_WIN32) && defined(_MSC_VER)
+    #include <Windows.h>
+#endif
+
+#include <sql.h>
+#include <sqlext.h>
+
+// Native ODBC paths for connections opened through QODBC/QODBC3.
+// All functions have to be called from the thread owning the connection.
+namespace DbOdbc
+{
+    bool isOdbc(const QSqlDatabase& db);
+    SQLHDBC connectionHandle(const QSqlDatabase& db);
+    QMap<QString, QString> diagnostics(
+            SQLSMALLINT handleType,
+            SQLHANDLE handle);
+    QString diagnosticsText(SQLSMALLINT handleType, SQLHANDLE handle);
+    QSqlError diagnosticsError(SQLSMALLINT handleType, SQLHANDLE handle);
+
+    DbBatchResult executeBatch(
+            DbConnection& connection,
+            const QString& queryString,
+            const QList<QVariantList>& columns,
+            int paramsetSize);
+    bool executeResultSet(
+            DbConnection& connection,
+            const QString& queryString,
+            int rowArraySize,
+            DbResultSet& result,
+            QString& errorText);
+    DbBlobResult readBlob(
+            DbConnection& connection,
+            const QString& queryString,
+            const QVariant& key,
+            QIODevice* target,
+            int chunkSize);
+    DbBlobResult writeBlob(
+            DbConnection& connection,
+            const QString& queryString,
+            const QVariant& key,
+            QIODevice* source,
+            int chunkSize);
+}
+
+#endif // DBODBC_H
@@ -0,0 +1,188 @@
+#include "dbpage.h"
+#include "dbodbc.h"
+
+#include <QDataStream>
+#include <QHash>
+#include <QRegExp>
+#include <QSqlDriver>
+
+namespace
+{
+    const quint8 TOKEN_VERSION = 1;
+
+    // Tokens of one query must not be replayed on another, nor on
+    // the same query with other parameters
+    quint32 fingerprint(
+            const QString& queryString,
+            const DbPageOptions& options,
+            const DbParams& params)
+    {
+        QByteArray bound;
+        QDataStream stream(&bound, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        for (int i = 0; i < params.size(); ++i)
+        {
+            stream << params.placeholder(i) << params.value(i);
+        }
+
+        return qHash(queryString)
+                ^ qHash(options.keyColumns.join(','))
+                ^ qHash(bound)
+                ^ (options.descending ? 1u : 0u);
+    }
+
+    QByteArray encode(const QByteArray& data)
+    {
+        return data.toBase64(QByteArray::Base64UrlEncoding
+                             | QByteArray::OmitTrailingEquals);
+    }
+
+    QByteArray decode(const QByteArray& token)
+    {
+        return QByteArray::fromBase64(token, QByteArray::Base64UrlEncoding);
+    }
+}
+
+
+// Wraps the query so that only the rows following lastKey are read:
+// SELECT * FROM (query) AS page_rows WHERE (k1, k2) > (?, ?) ORDER BY k1, k2
+// with the row comparison spelled out, not every engine has one.
+// One row more than the page is read to know whether another follows.
+// The key values are appended to params, named when the query uses
+// named placeholders. The query itself must not be ordered.
+QString DbPaging::keysetQuery(
+        const QSqlDatabase& db,
+        const QString& queryString,
+        const DbPageOptions& options,
+        const QVariantList& lastKey,
+        DbParams& params)
+{
+    QStringList keys;
+    for (const QString& column : options.keyColumns)
+    {
+        keys.append(db.driver()->escapeIdentifier(column, QSqlDriver::FieldName));
+    }
+
+    bool named = params.size() > 0 && !params.placeholder(0).isEmpty();
+    QString comparison = options.descending ? " < " : " > ";
+    QStringList alternatives;
+    for (int i = 0; i < keys.size() && i < lastKey.size(); ++i)
+    {
+        QStringList terms;
+        for (int j = 0; j <= i; ++j)
+        {
+            QString placeholder = "?";
+            if (named)
+            {
+                placeholder = QString(":page_key_%1").arg(params.size());
+                params.bind(placeholder, lastKey[j]);
+            }
+            else
+            {
+                params.add(lastKey[j]);
+            }
+
+            terms.append(keys[j] + (j < i ? " = " : comparison) + placeholder);
+        }
+        alternatives.append("(" + terms.join(" AND ") + ")");
+    }
+
+    QStringList order;
+    for (const QString& key : keys)
+    {
+        order.append(key + (options.descending ? " DESC" : " ASC"));
+    }
+
+    QString source = queryString.trimmed();
+    source.remove(QRegExp(";+\\s*$"));
+    int limit = qMax(1, options.pageSize) + 1;
+    bool top = DbOdbc::isOdbc(db);
+
+    QString ans = "SELECT ";
+    if (top)
+        ans += QString("TOP (%1) ").arg(limit);
+
+    ans += "* FROM (" + source + ") AS page_rows";
+    if (!alternatives.isEmpty())
+        ans += " WHERE " + alternatives.join(" OR ");
+
+    ans += " ORDER BY " + order.join(", ");
+    if (!top)
+        ans += QString(" LIMIT %1").arg(limit);
+
+    return ans;
+}
+
+
+QVariantList DbPaging::keyOf(const QSqlRecord& record, const QStringList& keyColumns)
+{
+    QVariantList ans;
+    for (const QString& column : keyColumns)
+    {
+        ans.append(record.value(column));
+    }
+
+    return ans;
+}
+
+
+QByteArray DbPaging::keysetToken(
+        const QString& queryString,
+        const DbPageOptions& options,
+        const DbParams& params,
+        const QVariantList& lastKey)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << TOKEN_VERSION << static_cast<quint8>(DbPageOptions::Mode::KEYSET)
+           << fingerprint(queryString, options, params) << lastKey;
+    return encode(data);
+}
+
+
+bool DbPaging::readKeysetToken(
+        const QByteArray& token,
+        const QString& queryString,
+        const DbPageOptions& options,
+        const DbParams& params,
+        QVariantList& lastKey)
+{
+    QDataStream stream(decode(token));
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 version = 0;
+    quint8 mode = 0;
+    quint32 hash = 0;
+    stream >> version >> mode >> hash >> lastKey;
+
+    return stream.status() == QDataStream::Ok
+            && version == TOKEN_VERSION
+            && mode == DbPageOptions::Mode::KEYSET
+            && hash == fingerprint(queryString, options, params)
+            && lastKey.size() == options.keyColumns.size();
+}
+
+
+QByteArray DbPaging::cursorToken(const QByteArray& id)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << TOKEN_VERSION << static_cast<quint8>(DbPageOptions::Mode::CURSOR) << id;
+    return encode(data);
+}
+
+
+bool DbPaging::readCursorToken(const QByteArray& token, QByteArray& id)
+{
+    QDataStream stream(decode(token));
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 version = 0;
+    quint8 mode = 0;
+    stream >> version >> mode >> id;
+
+    return stream.status() == QDataStream::Ok
+            && version == TOKEN_VERSION
+            && mode == DbPageOptions::Mode::CURSOR
+            && !id.isEmpty();
+}
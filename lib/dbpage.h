@@ -0,0 +1,64 @@
+#ifndef DBPAGE_H
+#define DBPAGE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QByteArray>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include "dbparams.h"
+
+// How selectPage() walks through the rows of a query
+struct DbPageOptions
+{
+    enum Mode { KEYSET, CURSOR };
+
+    Mode mode = KEYSET;
+    int pageSize = 100;
+    // KEYSET: result columns the pages are ordered by. Together they have
+    // to identify a row and must not be NULL, e.g. (created, id).
+    QStringList keyColumns;
+    bool descending = false;
+};
+
+struct DbPage
+{
+    QList<QSqlRecord> rows;
+    // Passed to the next selectPage() call, empty on the last page
+    QByteArray token;
+    bool hasMore = false;
+};
+
+namespace DbPaging
+{
+    LIBSHARED_EXPORT QString keysetQuery(
+            const QSqlDatabase& db,
+            const QString& queryString,
+            const DbPageOptions& options,
+            const QVariantList& lastKey,
+            DbParams& params);
+    LIBSHARED_EXPORT QVariantList keyOf(const QSqlRecord& record, const QStringList& keyColumns);
+    LIBSHARED_EXPORT QByteArray keysetToken(
+            const QString& queryString,
+            const DbPageOptions& options,
+            const DbParams& params,
+            const QVariantList& lastKey);
+    LIBSHARED_EXPORT bool readKeysetToken(
+            const QByteArray& token,
+            const QString& queryString,
+            const DbPageOptions& options,
+            const DbParams& params,
+            QVariantList& lastKey);
+    LIBSHARED_EXPORT QByteArray cursorToken(const QByteArray& id);
+    LIBSHARED_EXPORT bool readCursorToken(const QByteArray& token, QByteArray& id);
+}
+
+#endif // DBPAGE_H
@@ -0,0 +1,72 @@
+#include "dbparams.h"
+
+DbParams::DbParams()
+{
+
+}
+
+
+DbParams::DbParams(std::initializer_list<QVariant> values)
+{
+    mParams.reserve(static_cast<int>(values.size()));
+    for (const QVariant& value : values)
+    {
+        add(value);
+    }
+}
+
+
+DbParams& DbParams::add(const QVariant& value)
+{
+    Param param;
+    param.value = value;
+    mParams.append(param);
+    return *this;
+}
+
+
+DbParams& DbParams::addNull(QVariant::Type type)
+{
+    return add(QVariant(type));
+}
+
+
+DbParams& DbParams::bind(const QString& placeholder, const QVariant& value)
+{
+    Param param;
+    param.placeholder = placeholder;
+    param.value = value;
+    mParams.append(param);
+    return *this;
+}
+
+
+DbParams& DbParams::bindNull(const QString& placeholder, QVariant::Type type)
+{
+    return bind(placeholder, QVariant(type));
+}
+
+
+// Positional parameters are bound by their index among the positional
+// ones, named ones by their placeholder. Only blobs are bound as
+// binaries.
+void DbParams::bindTo(QSqlQuery& query) const
+{
+    int position = 0;
+    for (int i = 0; i < mParams.size(); ++i)
+    {
+        const Param& param = mParams[i];
+        QSql::ParamType paramType = QSql::In;
+        if (param.value.type() == QVariant::ByteArray)
+            paramType |= QSql::Binary;
+
+        if (param.placeholder.isEmpty())
+        {
+            query.bindValue(position++, param.value, paramType);
+        }
+        else
+        {
+            query.bindValue(param.placeholder, param.value, paramType);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef DBPARAMS_H
+#define DBPARAMS_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QSqlQuery>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <initializer_list>
+
+// Typed parameters of a statement. Values keep their own type (int,
+// double, string, datetime, blob or typed null), so the driver binds
+// them natively instead of as binaries. Parameters are bound by position
+// (add) or by placeholder name (bind). The set is cheap to move and is
+// moved, not copied, into the worker executing the statement.
+class LIBSHARED_EXPORT DbParams
+{
+public:
+    DbParams();
+    DbParams(std::initializer_list<QVariant> values);
+    DbParams(const DbParams&) = default;
+    DbParams(DbParams&&) = default;
+    DbParams& operator=(const DbParams&) = default;
+    DbParams& operator=(DbParams&&) = default;
+
+    DbParams& add(const QVariant& value);
+    DbParams& addNull(QVariant::Type type);
+    DbParams& bind(const QString& placeholder, const QVariant& value);
+    DbParams& bindNull(const QString& placeholder, QVariant::Type type);
+
+    int size() const { return mParams.size(); }
+    bool isEmpty() const { return mParams.isEmpty(); }
+    QString placeholder(int i) const { return mParams.at(i).placeholder; }
+    QVariant value(int i) const { return mParams.at(i).value; }
+
+    void bindTo(QSqlQuery& query) const;
+
+private:
+    struct Param
+    {
+        QString placeholder;
+        QVariant value;
+    };
+
+    QVector<Param> mParams;
+};
+
+#endif // DBPARAMS_H
@@ -0,0 +1,190 @@
+#include "dbpartition.h"
+#include "dbodbc.h"
+#include "dbscatter.h"
+
+#include <QDateTime>
+#include <QRegExp>
+#include <QSqlDriver>
+#include <algorithm>
+
+namespace
+{
+    QString source(const QString& queryString)
+    {
+        QString ans = queryString.trimmed();
+        ans.remove(QRegExp(";+\\s*$"));
+        return ans;
+    }
+
+    bool isInteger(const QVariant& value)
+    {
+        switch (value.type())
+        {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Same placeholder style as the query's own parameters
+    QString bind(DbParams& params, const QVariant& value)
+    {
+        if (params.size() > 0 && !params.placeholder(0).isEmpty())
+        {
+            QString placeholder = QString(":part_key_%1").arg(params.size());
+            params.bind(placeholder, value);
+            return placeholder;
+        }
+
+        params.add(value);
+        return "?";
+    }
+}
+
+
+QString DbPartition::boundsQuery(
+        const QSqlDatabase& db,
+        const QString& queryString,
+        const QString& keyColumn)
+{
+    QString key = db.driver()->escapeIdentifier(keyColumn, QSqlDriver::FieldName);
+    return "SELECT MIN(" + key + "), MAX(" + key + ") FROM ("
+            + source(queryString) + ") AS bound_rows";
+}
+
+
+// Equal widths of the key range. Numbers, dates and timestamps can be
+// split, anything else (or an empty range) stays one part.
+QVariantList DbPartition::split(const QVariant& min, const QVariant& max, int parts)
+{
+    QVariantList ans;
+    if (parts <= 1 || min.isNull() || max.isNull())
+        return ans;
+
+    if (isInteger(min) && isInteger(max))
+    {
+        qint64 low = min.toLongLong();
+        double width = (static_cast<double>(max.toLongLong()) - low) / parts;
+        qint64 previous = low;
+        for (int i = 1; i < parts; ++i)
+        {
+            qint64 boundary = low + static_cast<qint64>(width * i);
+            if (boundary > previous)
+                ans.append(boundary);
+
+            previous = boundary;
+        }
+    }
+    else if (min.type() == QVariant::Double || max.type() == QVariant::Double)
+    {
+        double low = min.toDouble();
+        double width = (max.toDouble() - low) / parts;
+        for (int i = 1; i < parts && width > 0; ++i)
+        {
+            ans.append(low + width * i);
+        }
+    }
+    else if (min.type() == QVariant::DateTime && max.type() == QVariant::DateTime)
+    {
+        QDateTime low = min.toDateTime();
+        qint64 width = low.msecsTo(max.toDateTime()) / parts;
+        for (int i = 1; i < parts && width > 0; ++i)
+        {
+            ans.append(low.addMSecs(width * i));
+        }
+    }
+    else if (min.type() == QVariant::Date && max.type() == QVariant::Date)
+    {
+        QDate low = min.toDate();
+        qint64 width = low.daysTo(max.toDate()) / parts;
+        for (int i = 1; i < parts && width > 0; ++i)
+        {
+            ans.append(low.addDays(width * i));
+        }
+    }
+
+    return ans;
+}
+
+
+// Random keys, drawn by the server. Costs one pass over the keys.
+QString DbPartition::sampleQuery(
+        const QSqlDatabase& db,
+        const QString& queryString,
+        const QString& keyColumn,
+        int sampleSize)
+{
+    QString key = db.driver()->escapeIdentifier(keyColumn, QSqlDriver::FieldName);
+    QString from = " FROM (" + source(queryString) + ") AS sample_rows WHERE "
+            + key + " IS NOT NULL";
+    int limit = qMax(1, sampleSize);
+
+    if (DbOdbc::isOdbc(db))
+        return QString("SELECT TOP (%1) ").arg(limit) + key + from + " ORDER BY NEWID()";
+
+    QString random = db.driverName().startsWith("QMYSQL") ? "RAND()" : "RANDOM()";
+    return "SELECT " + key + from + " ORDER BY " + random
+            + QString(" LIMIT %1").arg(limit);
+}
+
+
+// Every part gets about the same share of the sample. Repeated keys
+// can not be split, they leave fewer parts.
+QVariantList DbPartition::quantiles(QVariantList keys, int parts)
+{
+    QVariantList ans;
+    if (parts <= 1 || keys.isEmpty())
+        return ans;
+
+    std::sort(keys.begin(), keys.end(), [](const QVariant& left, const QVariant& right)
+    {
+        return DbScatter::compare(left, right) < 0;
+    });
+
+    for (int i = 1; i < parts; ++i)
+    {
+        const QVariant& boundary = keys[static_cast<int>(
+                    static_cast<qint64>(keys.size()) * i / parts)];
+        if (ans.isEmpty() || DbScatter::compare(boundary, ans.last()) > 0)
+            ans.append(boundary);
+    }
+
+    return ans;
+}
+
+
+QString DbPartition::rangeQuery(
+        const QSqlDatabase& db,
+        const QString& queryString,
+        const QString& keyColumn,
+        const QVariantList& boundaries,
+        int part,
+        DbParams& params)
+{
+    if (boundaries.isEmpty())
+        return queryString;
+
+    QString key = db.driver()->escapeIdentifier(keyColumn, QSqlDriver::FieldName);
+    QString condition;
+    if (part <= 0)
+    {
+        condition = key + " < " + bind(params, boundaries.first())
+                + " OR " + key + " IS NULL";
+    }
+    else if (part >= boundaries.size())
+    {
+        condition = key + " >= " + bind(params, boundaries.last());
+    }
+    else
+    {
+        condition = key + " >= " + bind(params, boundaries[part - 1]);
+        condition += " AND " + key + " < " + bind(params, boundaries[part]);
+    }
+
+    return "SELECT * FROM (" + source(queryString) + ") AS part_rows WHERE "
+            + condition;
+}
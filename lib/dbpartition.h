@@ -0,0 +1,120 @@
+#ifndef DBPARTITION_H
+#define DBPARTITION_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <functional>
+#include "dbparams.h"
+
+// How selectParallel() splits a query into key ranges
+struct DbScanOptions
+{
+    enum Boundaries { MIN_MAX, SAMPLED };
+
+    QString keyColumn;
+    // Ranges run at once, each on its own pooled connection
+    int parallelism = 4;
+    // MIN_MAX: equal widths of a number or date key, cheap but blind
+    // to skew. SAMPLED: quantiles of randomly drawn keys, any type.
+    Boundaries boundaries = MIN_MAX;
+    int sampleSize = 10000;
+};
+
+// Splits the rows of a query into ranges of one key column. N-1
+// boundaries make N parts: part 0 holds the keys below the first
+// boundary and NULL keys, the last one everything from the last
+// boundary on, so rows written after the split are not lost.
+namespace DbPartition
+{
+    LIBSHARED_EXPORT QString boundsQuery(
+            const QSqlDatabase& db,
+            const QString& queryString,
+            const QString& keyColumn);
+    LIBSHARED_EXPORT QVariantList split(const QVariant& min, const QVariant& max, int parts);
+    LIBSHARED_EXPORT QString sampleQuery(
+            const QSqlDatabase& db,
+            const QString& queryString,
+            const QString& keyColumn,
+            int sampleSize);
+    LIBSHARED_EXPORT QVariantList quantiles(QVariantList keys, int parts);
+    LIBSHARED_EXPORT QString rangeQuery(
+            const QSqlDatabase& db,
+            const QString& queryString,
+            const QString& keyColumn,
+            const QVariantList& boundaries,
+            int part,
+            DbParams& params);
+}
+
+// Results of the parts of one partitioned query. The last part done
+// combines them in part (key) order and reports the result.
+template <typename T>
+class DbPartJob
+{
+public:
+    typedef std::function<T(const QVector<T>&)> Combine;
+
+    explicit DbPartJob(Combine combine)
+        : mCombine(std::move(combine)),
+        mPending(0)
+    {
+        mPromise.reportStarted();
+    }
+
+    DbPartJob(const DbPartJob&) = delete;
+    void operator=(const DbPartJob&) = delete;
+
+    QFuture<T> future() { return mPromise.future(); }
+
+    void start(int parts)
+    {
+        QMutexLocker locker(&mMutex);
+        mResults.resize(parts);
+        mPending = parts;
+    }
+
+    void finish(int part, const T& result)
+    {
+        QMutexLocker locker(&mMutex);
+        mResults[part] = result;
+        if (--mPending > 0)
+            return;
+
+        T ans = mCombine(mResults);
+        mResults.clear();
+        locker.unlock();
+        report(ans);
+    }
+
+    // Before any part was started
+    void fail(const T& result)
+    {
+        report(result);
+    }
+
+private:
+    void report(const T& result)
+    {
+        mPromise.reportResult(result);
+        mPromise.reportFinished();
+    }
+
+    Combine mCombine;
+    QFutureInterface<T> mPromise;
+    QVector<T> mResults;
+    int mPending;
+    QMutex mMutex;
+};
+
+#endif // DBPARTITION_H
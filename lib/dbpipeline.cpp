@@ -0,0 +1,88 @@
+#include "dbpipeline.h"
+#include "paralleldbclient.h"
+#include "utils.h"
+
+DbPipeline::DbPipeline(ParallelDbClient* client, DbConnectionPool* pool)
+    : mClient(client),
+    mPool(pool),
+    mWorkerId(pool->reserve(1))
+{
+    if (mWorkerId < 0)
+    {
+        emit mClient->dbError(QSqlError(
+                                  QString(),
+                                  "No pooled connection left for a pipeline",
+                                  QSqlError::ConnectionError));
+    }
+}
+
+
+DbPipeline::~DbPipeline()
+{
+    close();
+}
+
+
+QFuture<QList<QSqlRecord>> DbPipeline::select(
+        const QString& queryString,
+        DbParams params)
+{
+    QMutexLocker locker(&mMutex);
+    if (mWorkerId < 0 || mClient.isNull() || mPool.isNull())
+        return Db::readyFuture(QList<QSqlRecord>());
+
+    return mPool->runPinned<QList<QSqlRecord>>(
+                mWorkerId,
+                mClient->bounded<QList<QSqlRecord>>(mClient->measured<QList<QSqlRecord>>(
+                    queryString,
+                    std::bind(
+                        &ParallelDbClient::executeParamsQuery,
+                        mClient.data(),
+                        std::placeholders::_1,
+                        queryString,
+                        std::move(params)))),
+                mClient->deadline());
+}
+
+
+QFuture<bool> DbPipeline::exec(const QString& queryString, DbParams params)
+{
+    QMutexLocker locker(&mMutex);
+    if (mWorkerId < 0 || mClient.isNull() || mPool.isNull())
+        return Db::readyFuture(false);
+
+    mClient->markWrite();
+    return mPool->runPinned<bool>(
+                mWorkerId,
+                mClient->invalidating<bool>(
+                    queryString,
+                    mClient->bounded<bool>(mClient->measured<bool>(
+                        queryString,
+                        std::bind(
+                            &ParallelDbClient::executeParamsNonQuery,
+                            mClient.data(),
+                            std::placeholders::_1,
+                            queryString,
+                            std::move(params))))),
+                mClient->deadline());
+}
+
+
+// Requests queued so far are still executed
+void DbPipeline::close()
+{
+    QMutexLocker locker(&mMutex);
+    if (mWorkerId >= 0)
+    {
+        if (!mPool.isNull())
+            mPool->release(mWorkerId);
+        mWorkerId = -1;
+    }
+}
+
+
+bool DbPipeline::isOpen() const
+{
+    QMutexLocker locker(&mMutex);
+    return mWorkerId >= 0;
+}
@@ -0,0 +1,56 @@
+#ifndef DBPIPELINE_H
+#define DBPIPELINE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QSqlRecord>
+#include "dbconnectionpool.h"
+#include "dbparams.h"
+
+class ParallelDbClient;
+
+// Submission queue of one pooled connection. Requests pushed here skip
+// the shared pool queue: the reserved worker takes everything queued so
+// far in one go and executes it back-to-back, in submission order.
+// Meant for high rates of small requests. close() (or destruction) gives
+// the connection back once the queued requests are done. At least one
+// connection is always left for the shared queue, a pipeline beyond that
+// is closed from the start.
+class LIBSHARED_EXPORT DbPipeline
+{
+    friend ParallelDbClient;
+
+public:
+    ~DbPipeline();
+    DbPipeline(const DbPipeline&) = delete;
+    void operator=(const DbPipeline&) = delete;
+
+    QFuture<QList<QSqlRecord>> select(
+            const QString& queryString,
+            DbParams params = DbParams());
+    QFuture<bool> exec(
+            const QString& queryString,
+            DbParams params = DbParams());
+    void close();
+    bool isOpen() const;
+
+private:
+    DbPipeline(ParallelDbClient* client, DbConnectionPool* pool);
+
+    // Guarded, the client (and its pool) may be destroyed first
+    QPointer<ParallelDbClient> mClient;
+    QPointer<DbConnectionPool> mPool;
+    int mWorkerId;
+
+    mutable QMutex mMutex;
+};
+
+#endif // DBPIPELINE_H
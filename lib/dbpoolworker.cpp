@@ -0,0 +1,103 @@
+#include "dbpoolworker.h"
+#include "dbconnectionpool.h"
+
+DbPoolWorker::DbPoolWorker(DbConnectionPool* pool, int id)
+    : mPool(pool),
+    mId(id),
+    mGeneration(0),
+    mConnected(false)
+{
+
+}
+
+
+void DbPoolWorker::run()
+{
+    QQueue<DbConnectionPool::Task> tasks;
+
+    while (mPool->takeTasks(mId, tasks))
+    {
+        prepareConnection();
+
+        if (tasks.isEmpty())
+        {
+            checkConnection();
+            continue;
+        }
+
+        while (!tasks.isEmpty())
+        {
+            // Tasks queued without a watch must not see the
+            // cancel of the previous one
+            mConnection->startTask(QDeadlineTimer(QDeadlineTimer::Forever));
+            DbConnectionPool::Task task = tasks.dequeue();
+            task(*mConnection);
+        }
+
+        reportState(mConnection->isOpen());
+        mPool->taskFinished(mId);
+    }
+
+    mConnection.reset();
+}
+
+
+// A reserved worker keeps its connection until it is released, the
+// transaction or cursor open on it would be lost with a reconnect
+void DbPoolWorker::prepareConnection()
+{
+    if (!mConnection.isNull() &&
+            (mGeneration == mPool->generation() || mPool->isReserved(mId)))
+        return;
+
+    // Old connection has to be removed before the new one
+    // is added, they may share the same name
+    mConnection.reset();
+    mConnected = false;
+
+    QString connectionName;
+    DbConfig config;
+    int statementCacheSize = 0;
+    DbMetrics* metrics = nullptr;
+    mGeneration = mPool->snapshot(
+                connectionName, config, statementCacheSize, metrics);
+    mConnection.reset(new DbConnection(
+                          QString("%1#%2").arg(connectionName).arg(mId),
+                          config,
+                          statementCacheSize,
+                          &mPool->mStatementCacheStats,
+                          metrics));
+}
+
+
+// Opens the connection ahead of traffic, or re-opens it when it died
+// while idle, so the next query does not pay for the reconnect
+void DbPoolWorker::checkConnection()
+{
+    if (mConnection->isOpen() && mConnection->ping())
+    {
+        reportState(true);
+        return;
+    }
+
+    if (mConnection->isOpen())
+    {
+        reportState(false);
+        reportState(mConnection->reconnect());
+    }
+    else
+    {
+        reportState(mConnection->open());
+    }
+}
+
+
+void DbPoolWorker::reportState(bool connected)
+{
+    if (connected == mConnected)
+        return;
+
+    mConnected = connected;
+    emit mPool->connectionStateChanged(
+                mConnection->getConnectionName(), connected);
+}
@@ -0,0 +1,35 @@
+#ifndef DBPOOLWORKER_H
+#define DBPOOLWORKER_H
+
+#include <QScopedPointer>
+#include <QThread>
+#include "dbconnection.h"
+
+class DbConnectionPool;
+
+// Worker thread of DbConnectionPool. Owns one connection for its
+// whole lifetime and re-creates it whenever the pool configuration
+// changes, once it is no longer reserved.
+class DbPoolWorker : public QThread
+{
+public:
+    DbPoolWorker(DbConnectionPool* pool, int id);
+    int id() const { return mId; }
+
+protected:
+    void run() override;
+
+private:
+    void prepareConnection();
+    void checkConnection();
+    void reportState(bool connected);
+
+    DbConnectionPool* mPool;
+    int mId;
+    // Created, used and destroyed by the worker thread only
+    QScopedPointer<DbConnection> mConnection;
+    quint64 mGeneration;
+    bool mConnected;
+};
+
+#endif // DBPOOLWORKER_H
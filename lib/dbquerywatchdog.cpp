@@ -0,0 +1,110 @@
+#include "dbquerywatchdog.h"
+#include "constants.h"
+#include "dbconnection.h"
+
+DbQueryWatchdog::DbQueryWatchdog()
+    : mCancelling(nullptr),
+    mStopping(false)
+{
+
+}
+
+
+DbQueryWatchdog::~DbQueryWatchdog()
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mStopping = true;
+        mChanged.wakeAll();
+    }
+
+    wait();
+}
+
+
+// The thread is started with the first watched task
+void DbQueryWatchdog::watch(
+        DbConnection* connection,
+        const QFutureInterfaceBase& future,
+        const QDeadlineTimer& deadline)
+{
+    QMutexLocker locker(&mMutex);
+    Watch watched;
+    watched.future = future;
+    watched.deadline = deadline;
+    mWatched.insert(connection, watched);
+
+    if (!isRunning())
+        start();
+
+    mChanged.wakeAll();
+}
+
+
+// Waits for a cancel in progress, the connection may go away after it
+void DbQueryWatchdog::unwatch(DbConnection* connection)
+{
+    QMutexLocker locker(&mMutex);
+    mWatched.remove(connection);
+    while (mCancelling == connection)
+        mCancelDone.wait(&mMutex);
+}
+
+
+// Cancelled futures are only noticed by polling, deadlines wake
+// the thread exactly. Cancels run without the lock, a MySQL KILL opens
+// a connection of its own and would hold up every watch() meanwhile.
+void DbQueryWatchdog::run()
+{
+    QMutexLocker locker(&mMutex);
+    while (!mStopping)
+    {
+        if (mWatched.isEmpty())
+        {
+            mChanged.wait(&mMutex);
+            continue;
+        }
+
+        qint64 timeout = DbConstants::DEFAULT_CANCEL_POLL_MS;
+        QList<QPair<DbConnection*, bool>> expiredConnections;
+        for (auto it = mWatched.begin(); it != mWatched.end(); ++it)
+        {
+            Watch& watched = it.value();
+            if (watched.cancelled)
+                continue;
+
+            bool expired = watched.deadline.hasExpired();
+            if (expired || watched.future.isCanceled())
+            {
+                watched.cancelled = true;
+                expiredConnections.append(qMakePair(it.key(), expired));
+                continue;
+            }
+
+            qint64 remaining = watched.deadline.remainingTime();
+            if (remaining >= 0)
+                timeout = qMin(timeout, remaining);
+        }
+
+        // unwatch() waits for the cancel of its connection to finish. A
+        // connection watched again meanwhile runs the next task already.
+        for (const QPair<DbConnection*, bool>& expired : expiredConnections)
+        {
+            auto it = mWatched.constFind(expired.first);
+            if (it == mWatched.constEnd() || !it.value().cancelled)
+                continue;
+
+            mCancelling = expired.first;
+            locker.unlock();
+            expired.first->cancel(expired.second);
+            locker.relock();
+            mCancelling = nullptr;
+            mCancelDone.wakeAll();
+        }
+
+        if (!expiredConnections.isEmpty())
+            continue;
+
+        mChanged.wait(&mMutex, static_cast<unsigned long>(qMax<qint64>(1, timeout)));
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef DBQUERYWATCHDOG_H
+#define DBQUERYWATCHDOG_H
+
+#include <QDeadlineTimer>
+#include <QFutureInterfaceBase>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+class DbConnection;
+
+// Thread of DbConnectionPool watching the tasks its workers run. The
+// statement of a task is cancelled on the server once the caller
+// cancels its future or its deadline passes.
+class DbQueryWatchdog : public QThread
+{
+public:
+    DbQueryWatchdog();
+    ~DbQueryWatchdog();
+
+    void watch(
+            DbConnection* connection,
+            const QFutureInterfaceBase& future,
+            const QDeadlineTimer& deadline);
+    void unwatch(DbConnection* connection);
+
+protected:
+    void run() override;
+
+private:
+    struct Watch
+    {
+        QFutureInterfaceBase future;
+        QDeadlineTimer deadline;
+        bool cancelled = false;
+    };
+
+    QHash<DbConnection*, Watch> mWatched;
+    // Cancelled outside mMutex, unwatch() of it waits on mCancelDone
+    DbConnection* mCancelling;
+    bool mStopping;
+
+    QMutex mMutex;
+    QWaitCondition mChanged;
+    QWaitCondition mCancelDone;
+};
+
+#endif // DBQUERYWATCHDOG_H
@@ -0,0 +1,352 @@
+#include "dbresultcache.h"
+#include "constants.h"
+
+#include <QDataStream>
+#include <QRegExp>
+
+namespace
+{
+    const QString IDENTIFIER = "([\\w\\.\\[\\]\"`]+)";
+
+    // dbo.[Users] and users are the same table for invalidation
+    QString normalizedTable(QString name)
+    {
+        name.remove(QRegExp("[\\[\\]\"`]"));
+        int dot = name.lastIndexOf('.');
+        if (dot >= 0)
+            name = name.mid(dot + 1);
+
+        return name.toLower();
+    }
+}
+
+
+DbResultCache::DbResultCache()
+    : mEnabled(false),
+    mMaxBytes(DbConstants::DEFAULT_RESULT_CACHE_BYTES),
+    mTtlMs(DbConstants::DEFAULT_RESULT_CACHE_TTL_MS),
+    mBytes(0),
+    mStamp(0),
+    mAllInvalidatedAt(0),
+    mPrunedStamp(0)
+{
+    mClock.start();
+}
+
+
+void DbResultCache::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&mMutex);
+    mEnabled = enabled;
+    if (!enabled)
+    {
+        mEntries.clear();
+        mByTable.clear();
+        mRecentlyUsed.clear();
+        mBytes = 0;
+        mAllInvalidatedAt = ++mStamp;
+    }
+}
+
+
+void DbResultCache::setLimits(qint64 maxBytes, int ttlMs)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxBytes = qMax<qint64>(0, maxBytes);
+    mTtlMs = qMax(0, ttlMs);
+    while (mBytes > mMaxBytes && !mRecentlyUsed.empty())
+    {
+        remove(mEntries.find(mRecentlyUsed.back()));
+    }
+}
+
+
+bool DbResultCache::isEnabled() const
+{
+    QMutexLocker locker(&mMutex);
+    return mEnabled;
+}
+
+
+qint64 DbResultCache::maxBytes() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMaxBytes;
+}
+
+
+int DbResultCache::ttlMs() const
+{
+    QMutexLocker locker(&mMutex);
+    return mTtlMs;
+}
+
+
+bool DbResultCache::find(const QByteArray& key, QList<QSqlRecord>& rows)
+{
+    QMutexLocker locker(&mMutex);
+    auto it = mEntries.find(key);
+    if (it != mEntries.end() && it->expiresAt <= mClock.elapsed())
+    {
+        remove(it);
+        it = mEntries.end();
+    }
+
+    if (it == mEntries.end())
+    {
+        mMisses.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    mRecentlyUsed.splice(mRecentlyUsed.begin(), mRecentlyUsed, it->position);
+    mHits.fetchAndAddRelaxed(1);
+    rows = it->rows;
+    return true;
+}
+
+
+// Taken before the query is sent. A result read while one of its tables
+// was written is not cached, it may already be stale.
+quint64 DbResultCache::stamp() const
+{
+    QMutexLocker locker(&mMutex);
+    return mStamp;
+}
+
+
+void DbResultCache::insert(
+        const QByteArray& key,
+        const QString& queryString,
+        const QList<QSqlRecord>& rows,
+        quint64 stamp)
+{
+    QStringList tables = tablesOf(queryString);
+    qint64 bytes = sizeOf(rows) + key.size();
+
+    QMutexLocker locker(&mMutex);
+    if (!mEnabled || bytes > mMaxBytes || changedSince(tables, stamp))
+        return;
+
+    auto it = mEntries.find(key);
+    if (it != mEntries.end())
+        remove(it);
+
+    while (mBytes + bytes > mMaxBytes && !mRecentlyUsed.empty())
+    {
+        remove(mEntries.find(mRecentlyUsed.back()));
+    }
+
+    mRecentlyUsed.push_front(key);
+    Entry entry;
+    entry.rows = rows;
+    entry.tables = tables;
+    entry.bytes = bytes;
+    entry.expiresAt = mClock.elapsed() + mTtlMs;
+    entry.position = mRecentlyUsed.begin();
+    mEntries.insert(key, entry);
+    mBytes += bytes;
+
+    for (const QString& table : tables)
+    {
+        mByTable[table].insert(key);
+    }
+}
+
+
+// Called for every write. A statement whose tables can not be
+// recognized drops the whole cache.
+void DbResultCache::invalidate(const QString& queryString)
+{
+    QStringList tables = tablesOf(queryString);
+    QMutexLocker locker(&mMutex);
+    invalidateTables(tables);
+}
+
+
+void DbResultCache::invalidateTable(const QString& table)
+{
+    QMutexLocker locker(&mMutex);
+    invalidateTables(QStringList() << normalizedTable(table));
+}
+
+
+void DbResultCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    invalidateTables(QStringList());
+}
+
+
+double DbResultCache::hitRatio() const
+{
+    quint64 hitCount = hits();
+    quint64 total = hitCount + misses();
+    return total == 0 ? 0.0 : static_cast<double>(hitCount) / total;
+}
+
+
+qint64 DbResultCache::memoryUsage() const
+{
+    QMutexLocker locker(&mMutex);
+    return mBytes;
+}
+
+
+int DbResultCache::size() const
+{
+    QMutexLocker locker(&mMutex);
+    return mEntries.size();
+}
+
+
+QByteArray DbResultCache::key(const QString& queryString, const DbParams& params)
+{
+    QByteArray ans;
+    QDataStream stream(&ans, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << queryString << params.size();
+    for (int i = 0; i < params.size(); ++i)
+    {
+        stream << params.placeholder(i) << params.value(i);
+    }
+
+    return ans;
+}
+
+
+// Tables following FROM, JOIN, INTO, UPDATE and TABLE, including
+// comma separated FROM lists. Good enough for the usual statements,
+// it is not an SQL parser.
+QStringList DbResultCache::tablesOf(const QString& queryString)
+{
+    QStringList ans;
+    QRegExp keyword("\\b(?:from|join|into|update|table)\\s+" + IDENTIFIER,
+                    Qt::CaseInsensitive);
+    QRegExp next("^\\s*(?:(?:as\\s+)?\\w+\\s*)?,\\s*" + IDENTIFIER,
+                 Qt::CaseInsensitive);
+
+    int pos = 0;
+    while ((pos = keyword.indexIn(queryString, pos)) >= 0)
+    {
+        pos += keyword.matchedLength();
+        QString table = normalizedTable(keyword.cap(1));
+        if (!table.isEmpty() && !ans.contains(table))
+            ans.append(table);
+
+        while (next.indexIn(queryString.mid(pos)) >= 0)
+        {
+            pos += next.matchedLength();
+            table = normalizedTable(next.cap(1));
+            if (!table.isEmpty() && !ans.contains(table))
+                ans.append(table);
+        }
+    }
+
+    return ans;
+}
+
+
+// Rough estimate, QSqlRecord keeps field names and values in each row
+qint64 DbResultCache::sizeOf(const QList<QSqlRecord>& rows)
+{
+    qint64 ans = 0;
+    for (const QSqlRecord& record : rows)
+    {
+        ans += 64;
+        for (int i = 0; i < record.count(); ++i)
+        {
+            QVariant value = record.value(i);
+            ans += 32 + record.fieldName(i).size() * 2;
+            if (value.type() == QVariant::ByteArray)
+                ans += value.toByteArray().size();
+            else if (value.type() == QVariant::String)
+                ans += value.toString().size() * 2;
+            else
+                ans += 16;
+        }
+    }
+
+    return ans;
+}
+
+
+void DbResultCache::remove(QHash<QByteArray, Entry>::iterator it)
+{
+    if (it == mEntries.end())
+        return;
+
+    for (const QString& table : it->tables)
+    {
+        auto keys = mByTable.find(table);
+        if (keys == mByTable.end())
+            continue;
+
+        keys->remove(it.key());
+        if (keys->isEmpty())
+            mByTable.erase(keys);
+    }
+
+    mBytes -= it->bytes;
+    mRecentlyUsed.erase(it->position);
+    mEntries.erase(it);
+}
+
+
+// Empty list means all tables. Writes older than the TTL are forgotten,
+// a read that started before them is not cached anyway.
+void DbResultCache::invalidateTables(const QStringList& tables)
+{
+    ++mStamp;
+    qint64 now = mClock.elapsed();
+    for (auto it = mInvalidatedAt.begin(); it != mInvalidatedAt.end();)
+    {
+        if (now - it->at > mTtlMs)
+        {
+            mPrunedStamp = qMax(mPrunedStamp, it->stamp);
+            it = mInvalidatedAt.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (tables.isEmpty())
+    {
+        mAllInvalidatedAt = mStamp;
+        mEntries.clear();
+        mByTable.clear();
+        mRecentlyUsed.clear();
+        mBytes = 0;
+        return;
+    }
+
+    for (const QString& table : tables)
+    {
+        Invalidation invalidation;
+        invalidation.stamp = mStamp;
+        invalidation.at = now;
+        mInvalidatedAt.insert(table, invalidation);
+        QSet<QByteArray> keys = mByTable.take(table);
+        for (const QByteArray& key : keys)
+        {
+            remove(mEntries.find(key));
+        }
+    }
+}
+
+
+bool DbResultCache::changedSince(const QStringList& tables, quint64 stamp) const
+{
+    if (mAllInvalidatedAt > stamp || mPrunedStamp > stamp)
+        return true;
+
+    for (const QString& table : tables)
+    {
+        auto it = mInvalidatedAt.constFind(table);
+        if (it != mInvalidatedAt.constEnd() && it->stamp > stamp)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,104 @@
+#ifndef DBRESULTCACHE_H
+#define DBRESULTCACHE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <list>
+#include "dbparams.h"
+
+// LRU cache of select() results keyed by SQL text and bound parameters.
+// Entries expire after ttlMs and are dropped when a write through the
+// same client touches one of the tables they were read from. Memory
+// use is estimated from the cached values. Thread-safe.
+class LIBSHARED_EXPORT DbResultCache
+{
+public:
+    DbResultCache();
+    DbResultCache(const DbResultCache&) = delete;
+    void operator=(const DbResultCache&) = delete;
+
+    void setEnabled(bool enabled);
+    void setLimits(qint64 maxBytes, int ttlMs);
+    bool isEnabled() const;
+    qint64 maxBytes() const;
+    int ttlMs() const;
+
+    bool find(const QByteArray& key, QList<QSqlRecord>& rows);
+    quint64 stamp() const;
+    void insert(
+            const QByteArray& key,
+            const QString& queryString,
+            const QList<QSqlRecord>& rows,
+            quint64 stamp);
+    void invalidate(const QString& queryString);
+    void invalidateTable(const QString& table);
+    void clear();
+
+    quint64 hits() const { return mHits.loadAcquire(); }
+    quint64 misses() const { return mMisses.loadAcquire(); }
+    double hitRatio() const;
+    qint64 memoryUsage() const;
+    int size() const;
+
+    static QByteArray key(
+            const QString& queryString,
+            const DbParams& params = DbParams());
+    static QStringList tablesOf(const QString& queryString);
+    static qint64 sizeOf(const QList<QSqlRecord>& rows);
+
+private:
+    // Last write of a table, by stamp and by time (mClock)
+    struct Invalidation
+    {
+        quint64 stamp;
+        qint64 at;
+    };
+
+    struct Entry
+    {
+        QList<QSqlRecord> rows;
+        QStringList tables;
+        qint64 bytes;
+        qint64 expiresAt;
+        std::list<QByteArray>::iterator position;
+    };
+
+    void remove(QHash<QByteArray, Entry>::iterator it);
+    void invalidateTables(const QStringList& tables);
+    bool changedSince(const QStringList& tables, quint64 stamp) const;
+
+    bool mEnabled;
+    qint64 mMaxBytes;
+    int mTtlMs;
+    qint64 mBytes;
+    quint64 mStamp;
+    quint64 mAllInvalidatedAt;
+    // Pruned after the TTL, reads taken before the newest pruned stamp
+    // count as changed
+    QHash<QString, Invalidation> mInvalidatedAt;
+    quint64 mPrunedStamp;
+    QHash<QString, QSet<QByteArray>> mByTable;
+    QHash<QByteArray, Entry> mEntries;
+    std::list<QByteArray> mRecentlyUsed;
+    QElapsedTimer mClock;
+    QAtomicInteger<quint64> mHits;
+    QAtomicInteger<quint64> mMisses;
+
+    mutable QMutex mMutex;
+};
+
+#endif // DBRESULTCACHE_H
@@ -0,0 +1,467 @@
+#include "dbresultset.h"
+
+#include <QSqlField>
+
+DbResultSet::DbResultSet()
+    : mRowCount(0)
+{
+
+}
+
+
+// Has to be called before the first row is appended
+void DbResultSet::setColumns(const QSqlRecord& record)
+{
+    clear();
+    mFields = record;
+    mFields.clearValues();
+
+    mColumns.resize(record.count());
+    for (int i = 0; i < record.count(); ++i)
+    {
+        Column& column = mColumns[i];
+        column.name = record.fieldName(i);
+        column.fieldType = record.field(i).type();
+        column.type = columnTypeOf(column.fieldType);
+        column.offsets.append(0);
+    }
+}
+
+
+// Column types chosen by the caller instead of derived from the fields.
+// Numbers kept as TEXT (exact decimals) are also handed out as text,
+// a conversion to double would round them.
+void DbResultSet::setColumns(
+        const QSqlRecord& record,
+        const QVector<ColumnType>& types)
+{
+    setColumns(record);
+    for (int i = 0; i < mColumns.size() && i < types.size(); ++i)
+    {
+        Column& column = mColumns[i];
+        column.type = types[i];
+        if (column.type == ColumnType::TEXT &&
+                columnTypeOf(column.fieldType) != ColumnType::TEXT &&
+                columnTypeOf(column.fieldType) != ColumnType::VARIANT)
+        {
+            column.fieldType = QVariant::String;
+            QSqlField field = mFields.field(i);
+            field.setType(QVariant::String);
+            mFields.replace(i, field);
+        }
+    }
+}
+
+
+void DbResultSet::appendNull(int column)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, true);
+
+    switch (c.type)
+    {
+    case ColumnType::INTEGER:
+        c.ints.append(0);
+        break;
+    case ColumnType::REAL:
+        c.reals.append(0.0);
+        break;
+    case ColumnType::TEXT:
+    case ColumnType::BLOB:
+        c.offsets.append(c.arena.size());
+        break;
+    case ColumnType::VARIANT:
+        c.variants.append(QVariant(c.fieldType));
+        break;
+    }
+}
+
+
+void DbResultSet::appendInt(int column, qint64 value)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, false);
+    c.ints.append(value);
+}
+
+
+void DbResultSet::appendDouble(int column, double value)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, false);
+    c.reals.append(value);
+}
+
+
+// UTF-16 text, stored as UTF-8 like the values of appendRow()
+void DbResultSet::appendText(int column, const QChar* data, int size)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, false);
+    c.arena.append(QString::fromRawData(data, size).toUtf8());
+    c.offsets.append(c.arena.size());
+}
+
+
+void DbResultSet::appendBlob(int column, const char* data, int size)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, false);
+    c.arena.append(data, size);
+    c.offsets.append(c.arena.size());
+}
+
+
+void DbResultSet::appendVariant(int column, const QVariant& value)
+{
+    Column& c = mColumns[column];
+    appendNullBit(c, value.isNull());
+    c.variants.append(value);
+}
+
+
+void DbResultSet::appendRow(const QSqlQuery& query)
+{
+    for (int i = 0; i < mColumns.size(); ++i)
+    {
+        appendValue(mColumns[i], query.isNull(i) ? QVariant() : query.value(i));
+    }
+
+    ++mRowCount;
+}
+
+
+void DbResultSet::appendRow(const QVector<QVariant>& values)
+{
+    for (int i = 0; i < mColumns.size(); ++i)
+    {
+        appendValue(mColumns[i], i < values.size() ? values[i] : QVariant());
+    }
+
+    ++mRowCount;
+}
+
+
+void DbResultSet::reserve(int rows)
+{
+    for (Column& column : mColumns)
+    {
+        switch (column.type)
+        {
+        case ColumnType::INTEGER:
+            column.ints.reserve(rows);
+            break;
+        case ColumnType::REAL:
+            column.reals.reserve(rows);
+            break;
+        case ColumnType::TEXT:
+        case ColumnType::BLOB:
+            column.offsets.reserve(rows + 1);
+            break;
+        case ColumnType::VARIANT:
+            column.variants.reserve(rows);
+            break;
+        }
+
+        column.nulls.reserve(rows / 64 + 1);
+    }
+}
+
+
+void DbResultSet::clear()
+{
+    mColumns.clear();
+    mFields.clear();
+    mRowCount = 0;
+}
+
+
+// Memory taken by the stored values, without the container overhead
+qint64 DbResultSet::byteSize() const
+{
+    qint64 ans = 0;
+    for (const Column& column : mColumns)
+    {
+        ans += column.ints.size() * sizeof(qint64);
+        ans += column.reals.size() * sizeof(double);
+        ans += column.arena.size();
+        ans += column.offsets.size() * sizeof(int);
+        ans += column.variants.size() * sizeof(QVariant);
+        ans += column.nulls.size() * sizeof(quint64);
+    }
+
+    return ans;
+}
+
+
+QString DbResultSet::columnName(int column) const
+{
+    return mColumns.at(column).name;
+}
+
+
+int DbResultSet::columnIndex(const QString& name) const
+{
+    for (int i = 0; i < mColumns.size(); ++i)
+    {
+        if (mColumns[i].name.compare(name, Qt::CaseInsensitive) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+
+DbResultSet::ColumnType DbResultSet::columnType(int column) const
+{
+    return mColumns.at(column).type;
+}
+
+
+QVariant::Type DbResultSet::fieldType(int column) const
+{
+    return mColumns.at(column).fieldType;
+}
+
+
+bool DbResultSet::isNull(int row, int column) const
+{
+    return nullBit(mColumns.at(column), row);
+}
+
+
+qint64 DbResultSet::intValue(int row, int column) const
+{
+    const Column& c = mColumns.at(column);
+    switch (c.type)
+    {
+    case ColumnType::INTEGER:
+        return c.ints.at(row);
+    case ColumnType::REAL:
+        return static_cast<qint64>(c.reals.at(row));
+    default:
+        return value(row, column).toLongLong();
+    }
+}
+
+
+double DbResultSet::doubleValue(int row, int column) const
+{
+    const Column& c = mColumns.at(column);
+    switch (c.type)
+    {
+    case ColumnType::INTEGER:
+        return static_cast<double>(c.ints.at(row));
+    case ColumnType::REAL:
+        return c.reals.at(row);
+    default:
+        return value(row, column).toDouble();
+    }
+}
+
+
+QString DbResultSet::stringValue(int row, int column) const
+{
+    const Column& c = mColumns.at(column);
+    if (c.type == ColumnType::TEXT)
+    {
+        int begin = c.offsets.at(row);
+        return QString::fromUtf8(
+                    c.arena.constData() + begin,
+                    c.offsets.at(row + 1) - begin);
+    }
+
+    return value(row, column).toString();
+}
+
+
+QByteArray DbResultSet::blobValue(int row, int column) const
+{
+    const Column& c = mColumns.at(column);
+    if (c.type == ColumnType::BLOB)
+    {
+        int begin = c.offsets.at(row);
+        return c.arena.mid(begin, c.offsets.at(row + 1) - begin);
+    }
+
+    return value(row, column).toByteArray();
+}
+
+
+QVariant DbResultSet::value(int row, int column) const
+{
+    const Column& c = mColumns.at(column);
+    if (nullBit(c, row))
+        return QVariant(c.fieldType);
+
+    QVariant v;
+    switch (c.type)
+    {
+    case ColumnType::INTEGER:
+        v = c.ints.at(row);
+        break;
+    case ColumnType::REAL:
+        v = c.reals.at(row);
+        break;
+    case ColumnType::TEXT:
+        v = stringValue(row, column);
+        break;
+    case ColumnType::BLOB:
+        v = blobValue(row, column);
+        break;
+    case ColumnType::VARIANT:
+        return c.variants.at(row);
+    }
+
+    v.convert(c.fieldType);
+    return v;
+}
+
+
+QVariant DbResultSet::value(int row, const QString& name) const
+{
+    int column = columnIndex(name);
+    return column < 0 ? QVariant() : value(row, column);
+}
+
+
+// Row in the QSqlRecord form returned by select()
+QSqlRecord DbResultSet::record(int row) const
+{
+    QSqlRecord rec = mFields;
+    for (int i = 0; i < mColumns.size(); ++i)
+    {
+        rec.setValue(i, value(row, i));
+    }
+
+    return rec;
+}
+
+
+const qint64* DbResultSet::intColumn(int column) const
+{
+    const Column& c = mColumns.at(column);
+    return c.type == ColumnType::INTEGER ? c.ints.constData() : nullptr;
+}
+
+
+const double* DbResultSet::doubleColumn(int column) const
+{
+    const Column& c = mColumns.at(column);
+    return c.type == ColumnType::REAL ? c.reals.constData() : nullptr;
+}
+
+
+DbResultSet::ColumnType DbResultSet::columnTypeOf(QVariant::Type type)
+{
+    switch (type)
+    {
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        return ColumnType::INTEGER;
+    case QVariant::Double:
+        return ColumnType::REAL;
+    case QVariant::String:
+        return ColumnType::TEXT;
+    case QVariant::ByteArray:
+        return ColumnType::BLOB;
+    default:
+        return ColumnType::VARIANT;
+    }
+}
+
+
+// Null cells still take a slot in the typed vector,
+// so row indices stay the same in every column
+void DbResultSet::appendValue(Column& column, const QVariant& value)
+{
+    bool null = value.isNull();
+    appendNullBit(column, null);
+
+    bool ok = true;
+    switch (column.type)
+    {
+    case ColumnType::INTEGER:
+    {
+        qint64 v = null ? 0 : value.toLongLong(&ok);
+        if (ok)
+            column.ints.append(v);
+        break;
+    }
+    case ColumnType::REAL:
+    {
+        double v = null ? 0.0 : value.toDouble(&ok);
+        if (ok)
+            column.reals.append(v);
+        break;
+    }
+    case ColumnType::TEXT:
+        if (!null)
+            column.arena.append(value.toString().toUtf8());
+        column.offsets.append(column.arena.size());
+        break;
+    case ColumnType::BLOB:
+        if (!null)
+            column.arena.append(value.toByteArray());
+        column.offsets.append(column.arena.size());
+        break;
+    case ColumnType::VARIANT:
+        column.variants.append(value);
+        break;
+    }
+
+    // Value that is no number in a numeric column (SQLite 'abc' in an
+    // INTEGER column), the column is kept as variants from now on
+    if (!ok)
+    {
+        toVariants(column);
+        column.variants.append(value);
+    }
+}
+
+
+// Values of the rows before the current one
+void DbResultSet::toVariants(Column& column)
+{
+    QVector<QVariant> variants;
+    variants.reserve(mRowCount + 1);
+    for (int row = 0; row < mRowCount; ++row)
+    {
+        QVariant v;
+        if (nullBit(column, row))
+            v = QVariant(column.fieldType);
+        else if (column.type == ColumnType::INTEGER)
+            v = column.ints.at(row);
+        else
+            v = column.reals.at(row);
+
+        if (!v.isNull())
+            v.convert(column.fieldType);
+        variants.append(v);
+    }
+
+    column.variants.swap(variants);
+    column.ints.clear();
+    column.reals.clear();
+    column.type = ColumnType::VARIANT;
+}
+
+
+void DbResultSet::appendNullBit(Column& column, bool null)
+{
+    int row = mRowCount;
+    if (row / 64 >= column.nulls.size())
+        column.nulls.append(0);
+
+    if (null)
+        column.nulls[row / 64] |= (Q_UINT64_C(1) << (row % 64));
+}
+
+
+bool DbResultSet::nullBit(const Column& column, int row)
+{
+    return (column.nulls.at(row / 64) >> (row % 64)) & 1;
+}
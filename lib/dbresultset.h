@@ -0,0 +1,95 @@
+#ifndef DBRESULTSET_H
+#define DBRESULTSET_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QByteArray>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+// Column oriented result of a select. Field metadata is stored once,
+// values in typed column vectors: integers and reals in contiguous
+// arrays, strings and blobs in one byte arena per column, nulls in
+// a bitmap. Types without a dedicated vector (dates, times...) are kept
+// as QVariant.
+class LIBSHARED_EXPORT DbResultSet
+{
+public:
+    enum ColumnType { INTEGER, REAL, TEXT, BLOB, VARIANT };
+
+    DbResultSet();
+
+    void setColumns(const QSqlRecord& record);
+    void appendRow(const QSqlQuery& query);
+    void appendRow(const QVector<QVariant>& values);
+    void reserve(int rows);
+    void clear();
+
+    // Native fetch paths fill a row one column at a time and then call
+    // finishRow(). Every column gets exactly one value of its type.
+    void setColumns(const QSqlRecord& record, const QVector<ColumnType>& types);
+    void appendNull(int column);
+    void appendInt(int column, qint64 value);
+    void appendDouble(int column, double value);
+    void appendText(int column, const QChar* data, int size);
+    void appendBlob(int column, const char* data, int size);
+    void appendVariant(int column, const QVariant& value);
+    void finishRow() { ++mRowCount; }
+
+    int rowCount() const { return mRowCount; }
+    qint64 byteSize() const;
+    int columnCount() const { return mColumns.size(); }
+    bool isEmpty() const { return mRowCount == 0; }
+    QString columnName(int column) const;
+    int columnIndex(const QString& name) const;
+    ColumnType columnType(int column) const;
+    QVariant::Type fieldType(int column) const;
+
+    bool isNull(int row, int column) const;
+    qint64 intValue(int row, int column) const;
+    double doubleValue(int row, int column) const;
+    QString stringValue(int row, int column) const;
+    QByteArray blobValue(int row, int column) const;
+    QVariant value(int row, int column) const;
+    QVariant value(int row, const QString& name) const;
+    QSqlRecord record(int row) const;
+
+    // Direct access for scans, valid until the result set is modified.
+    // Null when a value did not fit the column type, see columnType().
+    const qint64* intColumn(int column) const;
+    const double* doubleColumn(int column) const;
+
+    static ColumnType columnTypeOf(QVariant::Type type);
+
+private:
+    struct Column
+    {
+        QString name;
+        QVariant::Type fieldType;
+        ColumnType type;
+        QVector<qint64> ints;
+        QVector<double> reals;
+        QByteArray arena;
+        QVector<int> offsets;
+        QVector<QVariant> variants;
+        QVector<quint64> nulls;
+    };
+
+    void appendValue(Column& column, const QVariant& value);
+    void toVariants(Column& column);
+    void appendNullBit(Column& column, bool null);
+    static bool nullBit(const Column& column, int row);
+
+    QVector<Column> mColumns;
+    QSqlRecord mFields;
+    int mRowCount;
+};
+
+#endif // DBRESULTSET_H
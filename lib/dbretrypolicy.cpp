@@ -0,0 +1,193 @@
+#include "dbretrypolicy.h"
+
+#include <QRegExp>
+#include <random>
+
+DbRetryPolicy::DbRetryPolicy()
+    : mMaxAttempts(1),
+    mInitialBackoffMs(DbConstants::DEFAULT_RETRY_INITIAL_BACKOFF_MS),
+    mMaxBackoffMs(DbConstants::DEFAULT_RETRY_MAX_BACKOFF_MS),
+    mBudgetRatio(DbConstants::DEFAULT_RETRY_BUDGET_RATIO),
+    mBudgetMinRetries(DbConstants::DEFAULT_RETRY_BUDGET_MIN_RETRIES)
+{
+    // Serialization failure / deadlock victim, timeouts
+    setSqlState("40001", ErrorClass::TRANSIENT);
+    setSqlState("40P01", ErrorClass::TRANSIENT);
+    setSqlState("HYT00", ErrorClass::TRANSIENT);
+    setSqlState("HYT01", ErrorClass::TRANSIENT);
+
+    // Connection failures
+    setSqlState("08001", ErrorClass::CONNECTION);
+    setSqlState("08003", ErrorClass::CONNECTION);
+    setSqlState("08006", ErrorClass::CONNECTION);
+    setSqlState("08007", ErrorClass::CONNECTION);
+    setSqlState("08S01", ErrorClass::CONNECTION);
+
+    // SQL Server deadlock victim, MySQL lock wait timeout and deadlock,
+    // SQLite busy and locked database
+    setNativeError(1205, ErrorClass::TRANSIENT);
+    setNativeError(1213, ErrorClass::TRANSIENT);
+    setNativeError(5, ErrorClass::TRANSIENT, "QSQLITE");
+    setNativeError(6, ErrorClass::TRANSIENT, "QSQLITE");
+
+    // MySQL server gone away / lost connection, connection reset
+    setNativeError(2006, ErrorClass::CONNECTION);
+    setNativeError(2013, ErrorClass::CONNECTION);
+    setNativeError(10053, ErrorClass::CONNECTION);
+    setNativeError(10054, ErrorClass::CONNECTION);
+}
+
+
+void DbRetryPolicy::setBackoff(int initialBackoffMs, int maxBackoffMs)
+{
+    mInitialBackoffMs = qMax(0, initialBackoffMs);
+    mMaxBackoffMs = qMax(mInitialBackoffMs, maxBackoffMs);
+}
+
+
+// Retries are allowed for ratio of the requests, up to minRetries
+// of them may be spent at once before any request paid for them
+void DbRetryPolicy::setBudget(double ratio, int minRetries)
+{
+    mBudgetRatio = qMax(0.0, ratio);
+    mBudgetMinRetries = qMax(0, minRetries);
+}
+
+
+void DbRetryPolicy::setSqlState(const QString& sqlState, ErrorClass errorClass)
+{
+    mSqlStates.insert(sqlState.toUpper(), errorClass);
+}
+
+
+void DbRetryPolicy::setNativeError(
+        int nativeError,
+        ErrorClass errorClass,
+        const QString& driverPrefix)
+{
+    mNativeErrors[driverPrefix].insert(nativeError, errorClass);
+}
+
+
+void DbRetryPolicy::clearClassification()
+{
+    mSqlStates.clear();
+    mNativeErrors.clear();
+}
+
+
+// Codes registered for the driver win over the ones for all drivers
+DbRetryPolicy::ErrorClass DbRetryPolicy::classify(
+        const QSqlError& error,
+        const QString& driverName) const
+{
+    if (!error.isValid())
+        return ErrorClass::PERMANENT;
+
+    bool ok = false;
+    int nativeError = error.nativeErrorCode().toInt(&ok);
+    if (ok)
+    {
+        for (auto it = mNativeErrors.constBegin(); it != mNativeErrors.constEnd(); ++it)
+        {
+            if (!it.key().isEmpty() && driverName.startsWith(it.key()) &&
+                    it.value().contains(nativeError))
+                return it.value().value(nativeError);
+        }
+
+        const QHash<int, ErrorClass> all = mNativeErrors.value(QString());
+        if (all.contains(nativeError))
+            return all.value(nativeError);
+    }
+
+    // Drivers put the SQLSTATE either in the native code (PostgreSQL)
+    // or in the message ("[08S01] ..." of ODBC diagnostics)
+    QString text = error.nativeErrorCode() + ' ' +
+            error.driverText() + ' ' + error.databaseText();
+    QRegExp sqlState("\\b([0-9A-Z]{5})\\b");
+    int pos = 0;
+    while ((pos = sqlState.indexIn(text, pos)) >= 0)
+    {
+        pos += sqlState.matchedLength();
+        auto it = mSqlStates.constFind(sqlState.cap(1));
+        if (it != mSqlStates.constEnd())
+            return it.value();
+    }
+
+    if (error.type() == QSqlError::ConnectionError)
+        return ErrorClass::CONNECTION;
+
+    return ErrorClass::PERMANENT;
+}
+
+
+bool DbRetryPolicy::isRetryable(
+        const QSqlError& error,
+        bool write,
+        const QString& driverName) const
+{
+    switch (classify(error, driverName))
+    {
+    case ErrorClass::TRANSIENT:
+        return true;
+    case ErrorClass::CONNECTION:
+        return !write;
+    default:
+        return false;
+    }
+}
+
+
+// Delay before the given retry (attempt 2 is the first one)
+int DbRetryPolicy::backoffMs(int attempt) const
+{
+    qint64 ceiling = mInitialBackoffMs;
+    for (int i = 2; i < attempt && ceiling < mMaxBackoffMs; ++i)
+    {
+        ceiling *= 2;
+    }
+
+    ceiling = qMin<qint64>(ceiling, mMaxBackoffMs);
+    if (ceiling <= 0)
+        return 0;
+
+    thread_local std::mt19937 generator(std::random_device{}());
+    std::uniform_int_distribution<qint64> jitter(0, ceiling);
+    return static_cast<int>(jitter(generator));
+}
+
+
+DbRetryBudget::DbRetryBudget()
+    : mRatio(DbConstants::DEFAULT_RETRY_BUDGET_RATIO),
+    mTokens(DbConstants::DEFAULT_RETRY_BUDGET_MIN_RETRIES),
+    mMaxTokens(DbConstants::DEFAULT_RETRY_BUDGET_MIN_RETRIES)
+{
+
+}
+
+
+void DbRetryBudget::reset(double ratio, int minRetries)
+{
+    QMutexLocker locker(&mMutex);
+    mRatio = ratio;
+    mMaxTokens = qMax(1, minRetries);
+    mTokens = mMaxTokens;
+}
+
+
+void DbRetryBudget::deposit()
+{
+    QMutexLocker locker(&mMutex);
+    mTokens = qMin(mMaxTokens, mTokens + mRatio);
+}
+
+
+bool DbRetryBudget::withdraw()
+{
+    QMutexLocker locker(&mMutex);
+    if (mTokens < 1.0)
+        return false;
+
+    mTokens -= 1.0;
+    return true;
+}
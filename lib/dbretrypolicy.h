@@ -0,0 +1,84 @@
+#ifndef DBRETRYPOLICY_H
+#define DBRETRYPOLICY_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QHash>
+#include <QMutex>
+#include <QSqlError>
+#include <QString>
+#include "constants.h"
+
+// Which failed statements are executed again and when. Errors are
+// classified by SQLSTATE (found in the native code or the error text)
+// and by native driver codes, which may be limited to the Qt drivers
+// whose name starts with a prefix (SQLite's 5 is no busy database on
+// MySQL). TRANSIENT errors (deadlock victim,
+// timeout, busy database) left nothing behind and are retried for reads
+// and writes; CONNECTION errors only for reads, a write may have been
+// applied before the connection broke. Backoff grows exponentially
+// from initialBackoffMs up to maxBackoffMs with full jitter.
+class LIBSHARED_EXPORT DbRetryPolicy
+{
+public:
+    enum ErrorClass { PERMANENT, TRANSIENT, CONNECTION };
+
+    DbRetryPolicy();
+
+    void setMaxAttempts(int attempts) { mMaxAttempts = qMax(1, attempts); }
+    void setBackoff(int initialBackoffMs, int maxBackoffMs);
+    void setBudget(double ratio, int minRetries);
+    void setSqlState(const QString& sqlState, ErrorClass errorClass);
+    void setNativeError(
+            int nativeError,
+            ErrorClass errorClass,
+            const QString& driverPrefix = QString());
+    void clearClassification();
+
+    int getMaxAttempts() const { return mMaxAttempts; }
+    int getInitialBackoff() const { return mInitialBackoffMs; }
+    int getMaxBackoff() const { return mMaxBackoffMs; }
+    double getBudgetRatio() const { return mBudgetRatio; }
+    int getBudgetMinRetries() const { return mBudgetMinRetries; }
+    bool isEnabled() const { return mMaxAttempts > 1; }
+
+    ErrorClass classify(const QSqlError& error, const QString& driverName) const;
+    bool isRetryable(const QSqlError& error, bool write, const QString& driverName) const;
+    int backoffMs(int attempt) const;
+
+private:
+    int mMaxAttempts;
+    int mInitialBackoffMs;
+    int mMaxBackoffMs;
+    double mBudgetRatio;
+    int mBudgetMinRetries;
+    QHash<QString, ErrorClass> mSqlStates;
+    // Driver prefix (empty for all drivers) -> native code -> class
+    QHash<QString, QHash<int, ErrorClass>> mNativeErrors;
+};
+
+// Limits retries to a ratio of requests, so a failing database is not
+// hammered with retries on top of the regular load. Every request
+// deposits ratio of a token, every retry takes a whole one.
+class LIBSHARED_EXPORT DbRetryBudget
+{
+public:
+    DbRetryBudget();
+
+    void reset(double ratio, int minRetries);
+    void deposit();
+    bool withdraw();
+
+private:
+    double mRatio;
+    double mTokens;
+    double mMaxTokens;
+
+    QMutex mMutex;
+};
+
+#endif // DBRETRYPOLICY_H
@@ -0,0 +1,136 @@
+#include "dbrowstream.h"
+
+DbRowStream::Channel::Channel(int maxPendingChunks)
+    : mMaxPendingChunks(qMax(1, maxPendingChunks)),
+    mCancelled(false),
+    mFinished(false),
+    mSucceeded(false)
+{
+
+}
+
+
+// Called by the producer, blocks while the consumer is behind.
+// Returns false when the consumer is gone or cancelled the stream.
+bool DbRowStream::Channel::push(const QList<QSqlRecord>& chunk)
+{
+    QMutexLocker locker(&mMutex);
+    while (mChunks.size() >= mMaxPendingChunks && !mCancelled)
+    {
+        mSpaceAvailable.wait(&mMutex);
+    }
+
+    if (mCancelled)
+        return false;
+
+    mChunks.enqueue(chunk);
+    mChunkAvailable.wakeOne();
+    return true;
+}
+
+
+// Called by the consumer, blocks until a chunk is available.
+// Returns false when all rows were delivered or the stream was cancelled.
+bool DbRowStream::Channel::take(QList<QSqlRecord>& chunk)
+{
+    QMutexLocker locker(&mMutex);
+    while (mChunks.isEmpty() && !mFinished && !mCancelled)
+    {
+        mChunkAvailable.wait(&mMutex);
+    }
+
+    if (mChunks.isEmpty() || mCancelled)
+        return false;
+
+    chunk = mChunks.dequeue();
+    mSpaceAvailable.wakeOne();
+    return true;
+}
+
+
+// The first call decides, later ones are ignored
+void DbRowStream::Channel::finish(bool succ)
+{
+    QMutexLocker locker(&mMutex);
+    if (mFinished)
+        return;
+
+    mFinished = true;
+    mSucceeded = succ;
+    mChunkAvailable.wakeAll();
+}
+
+
+void DbRowStream::Channel::cancel()
+{
+    QMutexLocker locker(&mMutex);
+    mCancelled = true;
+    mChunks.clear();
+    mChunkAvailable.wakeAll();
+    mSpaceAvailable.wakeAll();
+}
+
+
+bool DbRowStream::Channel::isCancelled() const
+{
+    QMutexLocker locker(&mMutex);
+    return mCancelled;
+}
+
+
+bool DbRowStream::Channel::isFinished() const
+{
+    QMutexLocker locker(&mMutex);
+    return mFinished;
+}
+
+
+bool DbRowStream::Channel::succeeded() const
+{
+    QMutexLocker locker(&mMutex);
+    return mSucceeded;
+}
+
+
+DbRowStream::DbRowStream(int maxPendingChunks)
+    : mChannel(new Channel(maxPendingChunks))
+{
+
+}
+
+
+DbRowStream::~DbRowStream()
+{
+    // Unblocks the producer if the consumer gives up early
+    mChannel->cancel();
+}
+
+
+bool DbRowStream::next(QList<QSqlRecord>& chunk)
+{
+    return mChannel->take(chunk);
+}
+
+
+void DbRowStream::cancel()
+{
+    mChannel->cancel();
+}
+
+
+bool DbRowStream::isCancelled() const
+{
+    return mChannel->isCancelled();
+}
+
+
+bool DbRowStream::isFinished() const
+{
+    return mChannel->isFinished();
+}
+
+
+bool DbRowStream::succeeded() const
+{
+    return mChannel->succeeded();
+}
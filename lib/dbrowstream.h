@@ -0,0 +1,67 @@
+#ifndef DBROWSTREAM_H
+#define DBROWSTREAM_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QSqlRecord>
+#include <QWaitCondition>
+#include "constants.h"
+
+// Consumer side of a streamed select. Chunks of rows are handed over
+// through a bounded channel: the worker fetching them blocks while
+// maxPendingChunks are waiting, so a slow consumer holds back the fetch
+// instead of piling rows up in memory. Destroying the stream (or calling
+// cancel()) stops the fetch early.
+class LIBSHARED_EXPORT DbRowStream
+{
+public:
+    class Channel
+    {
+    public:
+        explicit Channel(int maxPendingChunks);
+
+        bool push(const QList<QSqlRecord>& chunk);
+        bool take(QList<QSqlRecord>& chunk);
+        void finish(bool succ);
+        void cancel();
+        bool isCancelled() const;
+        bool isFinished() const;
+        bool succeeded() const;
+
+    private:
+        int mMaxPendingChunks;
+        bool mCancelled;
+        bool mFinished;
+        bool mSucceeded;
+        QQueue<QList<QSqlRecord>> mChunks;
+
+        mutable QMutex mMutex;
+        QWaitCondition mChunkAvailable;
+        QWaitCondition mSpaceAvailable;
+    };
+
+    explicit DbRowStream(int maxPendingChunks = DbConstants::DEFAULT_STREAM_PENDING_CHUNKS);
+    ~DbRowStream();
+    DbRowStream(const DbRowStream&) = delete;
+    void operator=(const DbRowStream&) = delete;
+
+    bool next(QList<QSqlRecord>& chunk);
+    void cancel();
+    bool isCancelled() const;
+    bool isFinished() const;
+    bool succeeded() const;
+    QSharedPointer<Channel> channel() const { return mChannel; }
+
+private:
+    QSharedPointer<Channel> mChannel;
+};
+
+#endif // DBROWSTREAM_H
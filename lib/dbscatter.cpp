@@ -0,0 +1,198 @@
+#include "dbscatter.h"
+
+#include <QDateTime>
+#include <QSqlField>
+
+namespace
+{
+    bool isIntegral(QVariant::Type type)
+    {
+        return type == QVariant::Int || type == QVariant::UInt ||
+                type == QVariant::LongLong || type == QVariant::ULongLong ||
+                type == QVariant::Bool;
+    }
+
+    bool isNumeric(QVariant::Type type)
+    {
+        return isIntegral(type) || type == QVariant::Double;
+    }
+
+    QList<QSqlRecord> concat(const QVector<QList<QSqlRecord>>& shards)
+    {
+        QList<QSqlRecord> rows;
+        for (auto& shard : shards)
+        {
+            rows.append(shard);
+        }
+
+        return rows;
+    }
+
+    // k-way merge, shards are few, so the head of every one is scanned
+    QList<QSqlRecord> ordered(
+            const QVector<QList<QSqlRecord>>& shards,
+            const DbScatterOptions& options)
+    {
+        QList<QSqlRecord> rows;
+        QVector<int> heads(shards.size(), 0);
+
+        forever
+        {
+            int best = -1;
+            for (int i = 0; i < shards.size(); ++i)
+            {
+                if (heads[i] >= shards[i].size())
+                    continue;
+
+                if (best < 0)
+                {
+                    best = i;
+                    continue;
+                }
+
+                int cmp = DbScatter::compare(
+                            shards[i][heads[i]].value(options.keyColumn),
+                            shards[best][heads[best]].value(options.keyColumn));
+                if (options.descending ? cmp > 0 : cmp < 0)
+                    best = i;
+            }
+
+            if (best < 0)
+                break;
+
+            rows.append(shards[best][heads[best]++]);
+        }
+
+        return rows;
+    }
+
+    QList<QSqlRecord> aggregate(
+            const QVector<QList<QSqlRecord>>& shards,
+            const DbScatterOptions& options)
+    {
+        QList<QSqlRecord> rows;
+        QList<QSqlRecord> all = concat(shards);
+
+        // Every shard counted its own rows (COUNT(*)), the counts add up
+        if (options.mode == DbScatterOptions::MergeMode::COUNT)
+        {
+            QString name = "count";
+            qint64 count = 0;
+            for (auto& row : all)
+            {
+                if (row.isEmpty())
+                    continue;
+
+                name = row.fieldName(0);
+                count += row.value(0).toLongLong();
+            }
+
+            QSqlRecord rec;
+            rec.append(QSqlField(name, QVariant::LongLong));
+            rec.setValue(0, count);
+            rows.append(rec);
+            return rows;
+        }
+
+        if (all.isEmpty())
+            return rows;
+
+        QSqlRecord rec;
+        const QSqlRecord& first = all.first();
+        for (int c = 0; c < first.count(); ++c)
+        {
+            if (!options.keyColumn.isEmpty() &&
+                first.fieldName(c).compare(options.keyColumn, Qt::CaseInsensitive) != 0)
+            {
+                continue;
+            }
+
+            QSqlField field = first.field(c);
+            QVariant acc;
+            bool integral = true;
+            qint64 intSum = 0;
+            double sum = 0.0;
+
+            for (auto& row : all)
+            {
+                QVariant v = row.value(c);
+                if (v.isNull())
+                    continue;
+
+                if (options.mode == DbScatterOptions::MergeMode::SUM)
+                {
+                    integral = integral && isIntegral(v.type());
+                    intSum += v.toLongLong();
+                    sum += v.toDouble();
+                }
+                else if (acc.isNull())
+                {
+                    acc = v;
+                }
+                else
+                {
+                    int cmp = DbScatter::compare(v, acc);
+                    if (options.mode == DbScatterOptions::MergeMode::MIN ? cmp < 0 : cmp > 0)
+                        acc = v;
+                }
+            }
+
+            if (options.mode == DbScatterOptions::MergeMode::SUM)
+            {
+                acc = integral ? QVariant(intSum) : QVariant(sum);
+                field.setType(acc.type());
+            }
+
+            field.setValue(acc);
+            rec.append(field);
+        }
+
+        rows.append(rec);
+        return rows;
+    }
+}
+
+
+// Nulls go first, numbers and dates compare by value, the rest as strings
+int DbScatter::compare(const QVariant& left, const QVariant& right)
+{
+    if (left.isNull() || right.isNull())
+        return (left.isNull() ? 0 : 1) - (right.isNull() ? 0 : 1);
+
+    if (isNumeric(left.type()) && isNumeric(right.type()))
+    {
+        if (isIntegral(left.type()) && isIntegral(right.type()))
+        {
+            qint64 l = left.toLongLong(), r = right.toLongLong();
+            return l < r ? -1 : (l > r ? 1 : 0);
+        }
+
+        double l = left.toDouble(), r = right.toDouble();
+        return l < r ? -1 : (l > r ? 1 : 0);
+    }
+
+    if (left.canConvert<QDateTime>() && right.canConvert<QDateTime>() &&
+        (left.type() == QVariant::Date || left.type() == QVariant::DateTime))
+    {
+        QDateTime l = left.toDateTime(), r = right.toDateTime();
+        return l < r ? -1 : (l > r ? 1 : 0);
+    }
+
+    return left.toString().compare(right.toString());
+}
+
+
+QList<QSqlRecord> DbScatter::merge(
+        const QVector<QList<QSqlRecord>>& shards,
+        const DbScatterOptions& options)
+{
+    switch (options.mode)
+    {
+    case DbScatterOptions::MergeMode::CONCAT:
+        return concat(shards);
+    case DbScatterOptions::MergeMode::ORDERED:
+        return ordered(shards, options);
+    default:
+        return aggregate(shards, options);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef DBSCATTER_H
+#define DBSCATTER_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QList>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+// How results of one query sent to many clients (shards) are combined
+struct DbScatterOptions
+{
+    enum MergeMode { CONCAT, ORDERED, SUM, COUNT, MIN, MAX };
+
+    MergeMode mode = CONCAT;
+    // ORDERED: merge key, every shard has to return rows sorted by it.
+    // SUM/MIN/MAX: aggregated column, empty means every column.
+    // COUNT: shards return their count in the first column.
+    QString keyColumn;
+    bool descending = false;
+    // Per shard, shards not done in time are left out of the result
+    int timeoutMs = 30000;
+};
+
+struct DbScatterResult
+{
+    QList<QSqlRecord> rows;
+    QStringList completed;
+    QStringList failed;
+    QStringList timedOut;
+
+    bool isPartial() const { return !failed.isEmpty() || !timedOut.isEmpty(); }
+};
+
+namespace DbScatter
+{
+    LIBSHARED_EXPORT int compare(const QVariant& left, const QVariant& right);
+    LIBSHARED_EXPORT QList<QSqlRecord> merge(
+            const QVector<QList<QSqlRecord>>& shards,
+            const DbScatterOptions& options);
+}
+
+#endif // DBSCATTER_H
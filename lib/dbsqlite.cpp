@@ -0,0 +1,317 @@
+#include "dbsqlite.h"
+#include "dbconnection.h"
+
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <limits>
+
+#ifdef DB_SYSTEM_SQLITE
+#include <sqlite3.h>
+
+namespace
+{
+    QString escaped(const QSqlDatabase& db, const QString& name, QSqlDriver::IdentifierType type)
+    {
+        return db.driver()->escapeIdentifier(name, type);
+    }
+
+    // Blob handles address rows by rowid. Only tables with a rowid
+    // (not WITHOUT ROWID) can be streamed.
+    bool findRow(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            qint64& rowid,
+            bool& null,
+            DbBlobResult& result)
+    {
+        QSqlDatabase db = connection.database();
+        QSqlQuery query = connection.statement(
+                    "SELECT rowid, "
+                    + escaped(db, location.column, QSqlDriver::FieldName)
+                    + " IS NULL FROM "
+                    + escaped(db, location.table, QSqlDriver::TableName)
+                    + " WHERE "
+                    + escaped(db, location.keyColumn, QSqlDriver::FieldName)
+                    + " = ?");
+        query.bindValue(0, location.key);
+
+        bool found = false;
+        if (!connection.exec(query))
+        {
+            result.errorText = query.lastError().text();
+        }
+        else if (!query.next())
+        {
+            result.errorText = "No row with the blob key";
+        }
+        else
+        {
+            rowid = query.value(0).toLongLong();
+            null = query.value(1).toBool();
+            found = true;
+        }
+
+        connection.finish(query);
+        return found;
+    }
+
+    bool openBlob(
+            sqlite3* handle,
+            const DbBlobLocation& location,
+            qint64 rowid,
+            bool write,
+            sqlite3_blob** blob,
+            DbBlobResult& result)
+    {
+        int rc = sqlite3_blob_open(
+                    handle,
+                    "main",
+                    location.table.toUtf8().constData(),
+                    location.column.toUtf8().constData(),
+                    rowid,
+                    write ? 1 : 0,
+                    blob);
+        if (rc == SQLITE_OK)
+            return true;
+
+        result.errorText = QString::fromUtf8(sqlite3_errmsg(handle));
+        return false;
+    }
+
+    bool begin(QSqlDatabase& db, DbBlobResult& result)
+    {
+        if (db.transaction())
+            return true;
+
+        result.errorText = db.lastError().text();
+        return false;
+    }
+}
+#endif
+
+
+bool DbSqlite::isSqlite(const QSqlDatabase& db)
+{
+    return db.driverName() == "QSQLITE";
+}
+
+
+bool DbSqlite::hasNativeBlob(const QSqlDatabase& db)
+{
+#ifdef DB_SYSTEM_SQLITE
+    return isSqlite(db);
+#else
+    Q_UNUSED(db);
+    return false;
+#endif
+}
+
+
+#ifdef DB_SYSTEM_SQLITE
+sqlite3* DbSqlite::connectionHandle(const QSqlDatabase& db)
+{
+    if (!isSqlite(db) || !db.isOpen())
+        return nullptr;
+
+    QVariant v = db.driver()->handle();
+    if (!v.isValid() || v.isNull() || qstrcmp(v.typeName(), "sqlite3*") != 0)
+        return nullptr;
+
+    return *static_cast<sqlite3**>(v.data());
+}
+
+
+// Incremental blob I/O (sqlite3_blob_read), chunkSize bytes at a time.
+// Runs in a transaction, so the row can not change between the lookup
+// and the last chunk.
+DbBlobResult DbSqlite::readBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* target,
+        int chunkSize)
+{
+    DbBlobResult ans;
+    QSqlDatabase db = connection.database();
+    sqlite3* handle = connectionHandle(db);
+    if (handle == nullptr)
+    {
+        ans.errorText = "No SQLite connection handle";
+        return ans;
+    }
+
+    if (!begin(db, ans))
+        return ans;
+
+    qint64 rowid = 0;
+    sqlite3_blob* blob = nullptr;
+    if (findRow(connection, location, rowid, ans.null, ans) && !ans.null &&
+            openBlob(handle, location, rowid, false, &blob, ans))
+    {
+        int size = sqlite3_blob_bytes(blob);
+        QByteArray chunk(qMax(1, chunkSize), 0);
+        for (int offset = 0; offset < size; offset += chunk.size())
+        {
+            if (connection.isCancelled())
+            {
+                ans.errorText = connection.cancelError().text();
+                break;
+            }
+
+            int count = qMin(chunk.size(), size - offset);
+            if (sqlite3_blob_read(blob, chunk.data(), count, offset) != SQLITE_OK)
+            {
+                ans.errorText = QString::fromUtf8(sqlite3_errmsg(handle));
+                break;
+            }
+
+            if (!DbBlob::write(target, chunk.constData(), count, ans))
+                break;
+        }
+
+        sqlite3_blob_close(blob);
+    }
+
+    db.commit();
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
+
+
+// The value is first set to a zeroblob of the final size, then filled
+// with sqlite3_blob_write, chunkSize bytes at a time. Blob handles can
+// not grow, so the source has to know its size (random access device).
+DbBlobResult DbSqlite::writeBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* source,
+        int chunkSize)
+{
+    DbBlobResult ans;
+    QSqlDatabase db = connection.database();
+    sqlite3* handle = connectionHandle(db);
+    if (handle == nullptr)
+    {
+        ans.errorText = "No SQLite connection handle";
+        return ans;
+    }
+
+    if (source->isSequential())
+    {
+        ans.errorText = "SQLite blobs can only be written from random access devices";
+        return ans;
+    }
+
+    qint64 size = source->size() - source->pos();
+    if (size > std::numeric_limits<int>::max())
+    {
+        ans.errorText = "Blob is too big for SQLite";
+        return ans;
+    }
+
+    if (!begin(db, ans))
+        return ans;
+
+    QSqlQuery query = connection.statement(
+                "UPDATE "
+                + escaped(db, location.table, QSqlDriver::TableName)
+                + " SET "
+                + escaped(db, location.column, QSqlDriver::FieldName)
+                + " = zeroblob(?) WHERE "
+                + escaped(db, location.keyColumn, QSqlDriver::FieldName)
+                + " = ?");
+    query.bindValue(0, size);
+    query.bindValue(1, location.key);
+    if (!connection.exec(query))
+        ans.errorText = query.lastError().text();
+    else if (query.numRowsAffected() == 0)
+        ans.errorText = "No row with the blob key";
+    connection.finish(query);
+
+    qint64 rowid = 0;
+    bool null = false;
+    sqlite3_blob* blob = nullptr;
+    if (ans.errorText.isEmpty() &&
+            findRow(connection, location, rowid, null, ans) &&
+            openBlob(handle, location, rowid, true, &blob, ans))
+    {
+        QByteArray chunk(qMax(1, chunkSize), 0);
+        for (int offset = 0; offset < size; offset += chunk.size())
+        {
+            if (connection.isCancelled())
+            {
+                ans.errorText = connection.cancelError().text();
+                break;
+            }
+
+            int count = static_cast<int>(qMin<qint64>(chunk.size(), size - offset));
+            if (source->read(chunk.data(), count) != count)
+            {
+                ans.errorText = source->errorString().isEmpty()
+                        ? QString("Source device ended before its size")
+                        : source->errorString();
+                break;
+            }
+
+            if (sqlite3_blob_write(blob, chunk.constData(), count, offset) != SQLITE_OK)
+            {
+                ans.errorText = QString::fromUtf8(sqlite3_errmsg(handle));
+                break;
+            }
+
+            ans.bytes += count;
+        }
+
+        if (sqlite3_blob_close(blob) != SQLITE_OK && ans.errorText.isEmpty())
+            ans.errorText = QString::fromUtf8(sqlite3_errmsg(handle));
+    }
+
+    if (ans.errorText.isEmpty() && !db.commit())
+        ans.errorText = db.lastError().text();
+    if (!ans.errorText.isEmpty())
+        db.rollback();
+
+    ans.succ = ans.errorText.isEmpty();
+    return ans;
+}
+#else
+sqlite3* DbSqlite::connectionHandle(const QSqlDatabase& db)
+{
+    Q_UNUSED(db);
+    return nullptr;
+}
+
+
+DbBlobResult DbSqlite::readBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* target,
+        int chunkSize)
+{
+    Q_UNUSED(connection);
+    Q_UNUSED(location);
+    Q_UNUSED(target);
+    Q_UNUSED(chunkSize);
+
+    DbBlobResult ans;
+    ans.errorText = "Native SQLite blob I/O needs Qt built with system SQLite";
+    return ans;
+}
+
+
+DbBlobResult DbSqlite::writeBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* source,
+        int chunkSize)
+{
+    Q_UNUSED(connection);
+    Q_UNUSED(location);
+    Q_UNUSED(source);
+    Q_UNUSED(chunkSize);
+
+    DbBlobResult ans;
+    ans.errorText = "Native SQLite blob I/O needs Qt built with system SQLite";
+    return ans;
+}
+#endif
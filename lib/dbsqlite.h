@@ -0,0 +1,34 @@
+#ifndef DBSQLITE_H
+#define DBSQLITE_H
+
+#include <QIODevice>
+#include <QSqlDatabase>
+#include <QVariant>
+#include "dbblob.h"
+
+class DbConnection;
+struct sqlite3;
+
+// Native SQLite paths for connections opened through QSQLITE. They are
+// only built in when Qt's driver uses the system SQLite the library is
+// linked against (DB_SYSTEM_SQLITE), see hasNativeBlob().
+// All functions have to be called from the thread owning the connection.
+namespace DbSqlite
+{
+    bool isSqlite(const QSqlDatabase& db);
+    bool hasNativeBlob(const QSqlDatabase& db);
+    sqlite3* connectionHandle(const QSqlDatabase& db);
+
+    DbBlobResult readBlob(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* target,
+            int chunkSize);
+    DbBlobResult writeBlob(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* source,
+            int chunkSize);
+}
+
+#endif // DBSQLITE_H
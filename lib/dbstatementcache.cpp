@@ -0,0 +1,76 @@
+#include "dbstatementcache.h"
+
+DbStatementCache::DbStatementCache(int capacity, DbStatementCacheStats* stats)
+    : mCapacity(qMax(0, capacity)),
+    mStats(stats)
+{
+
+}
+
+
+DbStatementCache::~DbStatementCache()
+{
+    clear();
+}
+
+
+QSqlQuery DbStatementCache::statement(
+        const QSqlDatabase& db,
+        const QString& queryString)
+{
+    auto it = mStatements.find(queryString);
+    if (it != mStatements.end())
+    {
+        mRecentlyUsed.splice(
+                    mRecentlyUsed.begin(),
+                    mRecentlyUsed,
+                    it->position);
+        if (mStats)
+            mStats->hits.fetchAndAddRelaxed(1);
+
+        return it->query;
+    }
+
+    if (mStats)
+        mStats->misses.fetchAndAddRelaxed(1);
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Failed statements are not cached, exec() will report the error
+    if (!query.prepare(queryString) || mCapacity == 0)
+        return query;
+
+    while (mStatements.size() >= mCapacity)
+    {
+        evict();
+    }
+
+    mRecentlyUsed.push_front(queryString);
+    Entry entry;
+    entry.query = query;
+    entry.position = mRecentlyUsed.begin();
+    mStatements.insert(queryString, entry);
+
+    return query;
+}
+
+
+void DbStatementCache::clear()
+{
+    mStatements.clear();
+    mRecentlyUsed.clear();
+}
+
+
+void DbStatementCache::evict()
+{
+    if (mRecentlyUsed.empty())
+        return;
+
+    mStatements.remove(mRecentlyUsed.back());
+    mRecentlyUsed.pop_back();
+
+    if (mStats)
+        mStats->evictions.fetchAndAddRelaxed(1);
+}
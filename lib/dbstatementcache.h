@@ -0,0 +1,55 @@
+#ifndef DBSTATEMENTCACHE_H
+#define DBSTATEMENTCACHE_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <list>
+
+// Counters shared by all statement caches of one pool
+struct DbStatementCacheStats
+{
+    QAtomicInteger<quint64> hits;
+    QAtomicInteger<quint64> misses;
+    QAtomicInteger<quint64> evictions;
+};
+
+// LRU cache of prepared statements of one connection, keyed by SQL text.
+// Like the connection itself, it may only be used by one thread.
+class LIBSHARED_EXPORT DbStatementCache
+{
+public:
+    DbStatementCache(int capacity, DbStatementCacheStats* stats = nullptr);
+    ~DbStatementCache();
+    DbStatementCache(const DbStatementCache&) = delete;
+    void operator=(const DbStatementCache&) = delete;
+
+    QSqlQuery statement(const QSqlDatabase& db, const QString& queryString);
+    void clear();
+    int capacity() const { return mCapacity; }
+    int size() const { return mStatements.size(); }
+
+private:
+    struct Entry
+    {
+        QSqlQuery query;
+        std::list<QString>::iterator position;
+    };
+
+    void evict();
+
+    int mCapacity;
+    DbStatementCacheStats* mStats;
+    QHash<QString, Entry> mStatements;
+    std::list<QString> mRecentlyUsed;
+};
+
+#endif // DBSTATEMENTCACHE_H
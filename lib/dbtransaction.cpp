@@ -0,0 +1,237 @@
+#include "dbtransaction.h"
+#include "paralleldbclient.h"
+#include "utils.h"
+
+DbTransaction::DbTransaction(ParallelDbClient* client, DbConnectionPool* pool)
+    : mClient(client),
+    mPool(pool),
+    mWorkerId(pool->reserve(1)),
+    mActive(false),
+    mState(new State),
+    mStatements(0)
+{
+    if (mWorkerId < 0)
+    {
+        mBegun = Db::readyFuture(false);
+        emit mClient->dbError(QSqlError(
+                                  QString(),
+                                  "No pooled connection left for a transaction",
+                                  QSqlError::TransactionError));
+        return;
+    }
+
+    mActive = true;
+    mBegun = mPool->runPinned<bool>(
+                mWorkerId,
+                std::bind(
+                    &DbTransaction::execute,
+                    client,
+                    mState,
+                    std::placeholders::_1,
+                    Command::BEGIN,
+                    0),
+                QDeadlineTimer(QDeadlineTimer::Forever),
+                false);
+}
+
+
+DbTransaction::~DbTransaction()
+{
+    if (isActive())
+    {
+        finish(Command::ROLLBACK);
+    }
+}
+
+
+QFuture<bool> DbTransaction::exec(const QString& queryString, DbParams params)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mActive || mClient.isNull() || mPool.isNull())
+        return Db::readyFuture(false);
+
+    mWritten.append(queryString);
+    ++mStatements;
+    mClient->markWrite();
+    return mPool->runPinned<bool>(
+                mWorkerId,
+                mClient->bounded<bool>(mClient->measured<bool>(
+                    queryString,
+                    std::bind(
+                        &DbTransaction::executeStatement,
+                        mClient.data(),
+                        mState,
+                        std::placeholders::_1,
+                        queryString,
+                        std::move(params)))),
+                mClient->deadline());
+}
+
+
+QFuture<QList<QSqlRecord>> DbTransaction::select(
+        const QString& queryString,
+        DbParams params)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mActive || mClient.isNull() || mPool.isNull())
+        return Db::readyFuture(QList<QSqlRecord>());
+
+    return mPool->runPinned<QList<QSqlRecord>>(
+                mWorkerId,
+                mClient->bounded<QList<QSqlRecord>>(mClient->measured<QList<QSqlRecord>>(
+                    queryString,
+                    std::bind(
+                        &DbTransaction::executeSelect,
+                        mClient.data(),
+                        mState,
+                        std::placeholders::_1,
+                        queryString,
+                        std::move(params)))),
+                mClient->deadline());
+}
+
+
+QFuture<bool> DbTransaction::commit()
+{
+    return finish(Command::COMMIT);
+}
+
+
+QFuture<bool> DbTransaction::rollback()
+{
+    return finish(Command::ROLLBACK);
+}
+
+
+bool DbTransaction::isActive() const
+{
+    QMutexLocker locker(&mMutex);
+    return mActive;
+}
+
+
+// Last pinned task, the worker goes back to the pool once it is done
+QFuture<bool> DbTransaction::finish(Command command)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mActive)
+        return Db::readyFuture(false);
+
+    // The pool of a destroyed client rolled the transaction back
+    // when it closed the connection
+    mActive = false;
+    if (mClient.isNull() || mPool.isNull())
+        return Db::readyFuture(false);
+
+    std::function<bool(DbConnection&)> task = std::bind(
+                &DbTransaction::execute,
+                mClient.data(),
+                mState,
+                std::placeholders::_1,
+                command,
+                mStatements);
+
+    // Written rows become visible to other connections with the commit
+    if (command == Command::COMMIT)
+    {
+        for (const QString& queryString : mWritten)
+        {
+            task = mClient->invalidating<bool>(queryString, task);
+        }
+    }
+
+    mWritten.clear();
+    QFuture<bool> future = mPool->runPinned<bool>(
+                mWorkerId,
+                task,
+                QDeadlineTimer(QDeadlineTimer::Forever),
+                false);
+    mPool->release(mWorkerId);
+
+    return future;
+}
+
+
+// COMMIT rolls back when not all of the statements went through, the
+// caller would get a partial commit otherwise
+bool DbTransaction::execute(
+        ParallelDbClient* client,
+        QSharedPointer<State> state,
+        DbConnection& connection,
+        Command command,
+        int statements)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+
+    client->openDb(connection);
+    if (db.isOpen())
+    {
+        QSqlError error;
+        switch (command)
+        {
+        case Command::BEGIN:
+            succ = db.transaction();
+            state->begun = succ;
+            break;
+        case Command::COMMIT:
+            if (state->begun && state->succeeded < statements)
+            {
+                db.rollback();
+                error = QSqlError(
+                            QString(),
+                            "Transaction rolled back, a statement failed",
+                            QSqlError::TransactionError);
+            }
+            else
+            {
+                succ = state->begun && db.commit();
+            }
+            break;
+        case Command::ROLLBACK:
+            succ = state->begun && db.rollback();
+            break;
+        }
+
+        if (!succ)
+        {
+            client->fail(connection, error.isValid() ? error : db.lastError());
+        }
+    }
+
+    return succ;
+}
+
+
+// Statements of a transaction that failed to start are not executed,
+// they would be auto-committed one by one otherwise
+bool DbTransaction::executeStatement(
+        ParallelDbClient* client,
+        QSharedPointer<State> state,
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params)
+{
+    if (!state->begun)
+        return false;
+
+    bool succ = client->executeParamsNonQuery(connection, queryString, params);
+    if (succ)
+        ++state->succeeded;
+
+    return succ;
+}
+
+
+QList<QSqlRecord> DbTransaction::executeSelect(
+        ParallelDbClient* client,
+        QSharedPointer<State> state,
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params)
+{
+    if (!state->begun)
+        return QList<QSqlRecord>();
+
+    return client->executeParamsQuery(connection, queryString, params);
+}
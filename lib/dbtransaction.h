@@ -0,0 +1,97 @@
+#ifndef DBTRANSACTION_H
+#define DBTRANSACTION_H
+
+#if defined(LIB_LIBRARY)
+# define LIBSHARED_EXPORT Q_DECL_EXPORT
+#else
+# define LIBSHARED_EXPORT Q_DECL_IMPORT
+#endif
+
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QSqlRecord>
+#include <QStringList>
+#include "dbconnection.h"
+#include "dbconnectionpool.h"
+#include "dbparams.h"
+
+class ParallelDbClient;
+
+// Transaction pinned to one pooled connection. All statements queued
+// through it run on that connection, in order, without blocking the
+// caller. commit()/rollback() end the transaction and give the
+// connection back to the pool. A transaction still active when
+// destroyed is rolled back. At least one connection is always left for
+// the shared queue, a transaction beyond that fails from the start.
+class LIBSHARED_EXPORT DbTransaction
+{
+    friend ParallelDbClient;
+
+public:
+    enum Command { BEGIN, COMMIT, ROLLBACK };
+
+    ~DbTransaction();
+    DbTransaction(const DbTransaction&) = delete;
+    void operator=(const DbTransaction&) = delete;
+
+    QFuture<bool> begun() const { return mBegun; }
+    QFuture<bool> exec(
+            const QString& queryString,
+            DbParams params = DbParams());
+    QFuture<QList<QSqlRecord>> select(
+            const QString& queryString,
+            DbParams params = DbParams());
+    QFuture<bool> commit();
+    QFuture<bool> rollback();
+    bool isActive() const;
+
+private:
+    // Only touched by the pinned worker, tasks run one after another
+    struct State
+    {
+        bool begun = false;
+        // Statements of exec() that went through, one that failed or
+        // was cancelled makes COMMIT roll back
+        int succeeded = 0;
+    };
+
+    DbTransaction(ParallelDbClient* client, DbConnectionPool* pool);
+    QFuture<bool> finish(Command command);
+    static bool execute(
+            ParallelDbClient* client,
+            QSharedPointer<State> state,
+            DbConnection& connection,
+            Command command,
+            int statements);
+    static bool executeStatement(
+            ParallelDbClient* client,
+            QSharedPointer<State> state,
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params);
+    static QList<QSqlRecord> executeSelect(
+            ParallelDbClient* client,
+            QSharedPointer<State> state,
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params);
+
+    // Guarded, the client (and its pool) may be destroyed first
+    QPointer<ParallelDbClient> mClient;
+    QPointer<DbConnectionPool> mPool;
+    int mWorkerId;
+    bool mActive;
+    QFuture<bool> mBegun;
+    QSharedPointer<State> mState;
+    // Statements queued through exec()
+    int mStatements;
+    // Statements to drop from the result cache on commit
+    QStringList mWritten;
+
+    mutable QMutex mMutex;
+};
+
+#endif // DBTRANSACTION_H
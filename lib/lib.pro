@@ -2,7 +2,7 @@ TARGET = paralleldbclient
 TEMPLATE = lib
 
 QT -= gui
-QT += network sql
+QT += network sql concurrent
 
 CONFIG += c++11
 
@@ -17,7 +17,32 @@ SOURCES += \
     dbconfig.cpp \
     paralleldbfactory.cpp \
     paralleldbmetainfo.cpp \
-    utils.cpp
+    utils.cpp \
+    dbconnection.cpp \
+    dbconnectionpool.cpp \
+    dbpoolworker.cpp \
+    dbstatementcache.cpp \
+    dbrowstream.cpp \
+    dbresultset.cpp \
+    dbodbc.cpp \
+    dbparams.cpp \
+    dbtransaction.cpp \
+    dbpipeline.cpp \
+    dbscatter.cpp \
+    dbresultcache.cpp \
+    dbretrypolicy.cpp \
+    dbmetrics.cpp \
+    dbhostcache.cpp \
+    dbdeadline.cpp \
+    dbquerywatchdog.cpp \
+    dbpage.cpp \
+    dbcursor.cpp \
+    dbcsv.cpp \
+    dbimport.cpp \
+    dbpartition.cpp \
+    dbexport.cpp \
+    dbblob.cpp \
+    dbsqlite.cpp
 
 HEADERS += \
     paralleldbclient.h \
@@ -25,11 +50,53 @@ HEADERS += \
     constants.h \
     paralleldbfactory.h \
     paralleldbmetainfo.h \
-    utils.h
+    utils.h \
+    dbconnection.h \
+    dbconnectionpool.h \
+    dbpoolworker.h \
+    dbstatementcache.h \
+    dbrowstream.h \
+    dbresultset.h \
+    dbbatchresult.h \
+    dbodbc.h \
+    dbparams.h \
+    dbtransaction.h \
+    dbpipeline.h \
+    dbscatter.h \
+    dbresultcache.h \
+    dbretrypolicy.h \
+    dbmetrics.h \
+    dbhostcache.h \
+    dbdeadline.h \
+    dbquerywatchdog.h \
+    dbpage.h \
+    dbcursor.h \
+    dbcsv.h \
+    dbimport.h \
+    dbpartition.h \
+    dbexport.h \
+    dbblob.h \
+    dbsqlite.h
+
+# Native SQLite calls (interrupt, incremental blob I/O) go to the handle
+# of Qt's driver, they are only safe when that driver uses the same
+# system library. Build with CONFIG+=system_sqlite where qmake can not
+# tell.
+qtConfig(system-sqlite)|system_sqlite {
+    DEFINES += DB_SYSTEM_SQLITE
+    LIBS += -lsqlite3
+}
 
 unix {
     LIBS += -lodbc
-    headers.files = paralleldbfactory.h paralleldbclient.h dbconfig.h
+    headers.files = paralleldbfactory.h paralleldbclient.h dbconfig.h \
+        dbconnection.h dbconnectionpool.h dbstatementcache.h \
+        dbrowstream.h dbresultset.h dbbatchresult.h \
+        dbparams.h dbtransaction.h dbpipeline.h \
+        dbscatter.h dbresultcache.h dbretrypolicy.h dbmetrics.h \
+        dbhostcache.h dbdeadline.h dbpage.h dbcursor.h \
+        dbimport.h dbexport.h dbblob.h \
+        constants.h dbpartition.h paralleldbmetainfo.h
     headers.path = /usr/include
     target.path = /usr/lib
     INSTALLS += target headers
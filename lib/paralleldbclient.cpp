@@ -1,4 +1,12 @@
 #include "paralleldbclient.h"
+#include "dbodbc.h"
+#include "dbpartition.h"
+#include "dbscatter.h"
+#include "dbsqlite.h"
+#include "utils.h"
+
+#include <QThread>
+#include <QUuid>
 
 #ifdef _MSC_VER
    #define LOG(msg, useLog) \
@@ -15,7 +23,13 @@ ParallelDbClient::ParallelDbClient(
         QObject* parent)
     : ParallelDbMetainfo(parent),
     mConnectionName(connectionName),
-    mUseLog(false)
+    mUseLog(false),
+    mReplicaSelection(ReplicaSelection::LEAST_OUTSTANDING),
+    mNextReplica(0),
+    mReadYourWrites(false),
+    mReadYourWritesMs(DbConstants::DEFAULT_READ_YOUR_WRITES_MS),
+    mQueryTimeoutMs(DbConstants::DEFAULT_QUERY_TIMEOUT_MS),
+    mNativeFetchRows(0)
 {
     // mConfig has to be assigned here!
     // In list initialization it causes the following error:
@@ -24,13 +38,41 @@ ParallelDbClient::ParallelDbClient(
     // It is because DbConfig, as inherited from QOBject,
     // can not have copy c-tor!
     mConfig = config;
+    mClock.start();
+    mPool = createPool(mConnectionName, mConfig);
     verifyPresenceOfRequestedDriver();
     applyConfig();
+
+    connect(&mCursorSweep, &QTimer::timeout, this, &ParallelDbClient::sweepCursors);
+    mCursorSweep.start(DbConstants::DEFAULT_CURSOR_SWEEP_MS);
 }
 
 
 ParallelDbClient::~ParallelDbClient()
 {
+    // Open cursors queue their close on the pools
+    mCursorSweep.stop();
+    QMutexLocker locker(&mCursorMutex);
+    QHash<QByteArray, PagingCursor> cursors;
+    cursors.swap(mCursors);
+    locker.unlock();
+    cursors.clear();
+
+    // Pools have to be stopped first, their workers still call execute*
+    // methods while draining the queues. Calls still holding a pool
+    // only find it stopped.
+    QList<QSharedPointer<Replica>> replicas;
+    {
+        QMutexLocker routingLocker(&mRoutingMutex);
+        replicas.swap(mReplicas);
+    }
+
+    for (const QSharedPointer<Replica>& replica : replicas)
+        replica->pool->stop();
+
+    mPool->stop();
+    mPool.clear();
+
     QSqlDatabase db = QSqlDatabase::database(mConnectionName);
     if (db.isOpen())
     {
@@ -41,6 +83,56 @@ ParallelDbClient::~ParallelDbClient()
 }
 
 
+// New pools take over the settings of the primary one
+QSharedPointer<DbConnectionPool> ParallelDbClient::createPool(
+        const QString& connectionName,
+        const DbConfig& config)
+{
+    QSharedPointer<DbConnectionPool> pool(
+                new DbConnectionPool(
+                    connectionName,
+                    config,
+                    1,
+                    qMax(1, QThread::idealThreadCount())),
+                &DbConnectionPool::destroy);
+    if (mPool.isNull())
+    {
+        pool->setStatementCacheSize(DbConstants::DEFAULT_STATEMENT_CACHE_SIZE);
+    }
+    else
+    {
+        pool->setSize(mPool->getMinSize(), mPool->getMaxSize());
+        pool->setMaxQueueDepth(mPool->getMaxQueueDepth());
+        pool->setOverflowPolicy(mPool->getOverflowPolicy());
+        pool->setStatementCacheSize(mPool->getStatementCacheSize());
+        pool->setHealthCheckInterval(mPool->getHealthCheckInterval());
+        pool->setPriorityWeights(
+                    mPool->getPriorityWeight(DbConnectionPool::Priority::INTERACTIVE),
+                    mPool->getPriorityWeight(DbConnectionPool::Priority::NORMAL),
+                    mPool->getPriorityWeight(DbConnectionPool::Priority::BULK));
+        pool->setMaxBulkWorkers(mPool->getMaxBulkWorkers());
+        if (mPool->getHealthCheckInterval() > 0)
+            pool->checkConnections();
+    }
+
+    pool->setMetrics(&mMetrics);
+    connect(pool.data(), &DbConnectionPool::connectionStateChanged,
+            this, &ParallelDbClient::connectionStateChanged);
+
+    connect(pool.data(), &DbConnectionPool::taskRejected,
+            this, [this](int queueDepth)
+    {
+        LOG(QString("query rejected, %1 queries already queued")
+            .arg(queueDepth), mUseLog);
+        emit dbError(QSqlError(
+                         QString(),
+                         "Query rejected, the queue is full",
+                         QSqlError::UnknownError));
+    });
+    return pool;
+}
+
+
 bool ParallelDbClient::verifyPresenceOfRequestedDriver()
 {
     bool succ = true;
@@ -191,388 +283,2300 @@ void ParallelDbClient::applyConfig()
     closeDb();
 
     QSqlDatabase db = QSqlDatabase::database(mConnectionName, false);
+    DbConnection::configure(db, mConfig);
 
-    if (mConfig.getDbEngine() == DbConfig::DbEngine::SQLITE)
-    {
-        // TODO: What if sqlite is secured?!
-        db.setDatabaseName(getDbname());
-    }
-    else if (mConfig.getDbEngine() == DbConfig::DbEngine::MYSQL)
-    {
-        db.setHostName(getIp().toString());
-        db.setPort(getPort());
-        db.setDatabaseName(getDbname());
-        db.setUserName(getUsername());
-        db.setPassword(getPassword());
-    }
-    else if (mConfig.getDbEngine() == DbConfig::DbEngine::MSSQL_SQLAUTH)
-    {
-        db.setDatabaseName(
-                    QString("DRIVER={%1};SERVER=%2,%3;DATABASE=%4;UID=%5;PWD=%6")
-                    .arg(mConfig.getOdbcName())
-                    .arg(mConfig.getIp().toString())
-                    .arg(mConfig.getPort())
-                    .arg(mConfig.getDbname())
-                    .arg(mConfig.getUsername())
-                    .arg(mConfig.getPassword()));
-    }
-    else if (mConfig.getDbEngine() == DbConfig::DbEngine::MSSQL_WINAUTH)
+    // Pooled connections are re-created by their workers
+    // before the next query is executed
+    mPool->setConnectionName(mConnectionName);
+    mPool->setDbConfig(mConfig);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (int i = 0; i < mReplicas.size(); ++i)
     {
-        db.setDatabaseName(
-                    QString("DRIVER={%1};SERVER=%2,%3;DATABASE=%4")
-                    .arg(mConfig.getOdbcName())
-                    .arg(mConfig.getIp().toString())
-                    .arg(mConfig.getPort())
-                    .arg(mConfig.getDbname()));
+        mReplicas[i]->pool->setConnectionName(
+                    QString("%1-replica%2").arg(mConnectionName).arg(i));
     }
 }
 
-// TODO: add db per thread?! Include thread id
-// https://stackoverflow.com/questions/47457478/using-qsqlquery-from-multiple-threads
-void ParallelDbClient::addDb()
+
+void ParallelDbClient::setPoolSize(int minSize, int maxSize)
 {
-    if (!QSqlDatabase::contains(mConnectionName))
-    {
-        QSqlDatabase::addDatabase(
-                    mConfig.getDbDriver(),
-                    mConnectionName);
-    }
+    mPool->setSize(minSize, maxSize);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setSize(minSize, maxSize);
 }
 
 
-void ParallelDbClient::closeDb()
+int ParallelDbClient::getPoolMinSize() const
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName, false);
-    if (db.isOpen())
-    {
-        db.close();
-    }
+    return mPool->getMinSize();
 }
 
 
-void ParallelDbClient::openDb()
+int ParallelDbClient::getPoolMaxSize() const
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName, true);
-    if (!db.isOpen())
-    {
-        bool succ = db.open();
-        if (!succ)
-            emit dbError(db.lastError());
-    }
+    return mPool->getMaxSize();
 }
 
 
-QFuture<QList<QSqlRecord>> ParallelDbClient::sendQuery(
-        const QString& queryString)
+int ParallelDbClient::getPoolSize() const
 {
-    // Copy of an operand is always passed by QtConcurrent::run() to the function!
-    QFuture<QList<QSqlRecord>> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeQuery,
-                queryString);
-    return future;
+    return mPool->size();
 }
 
 
-QFuture<QList<QSqlRecord>> ParallelDbClient::sendBindedQuery(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+void ParallelDbClient::setMaxQueueDepth(int depth)
 {
-    QFuture<QList<QSqlRecord>> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeBindedQuery,
-                queryString,
-                placeholders,
-                binaries);
-    return future;
+    mPool->setMaxQueueDepth(depth);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setMaxQueueDepth(depth);
 }
 
 
-QFuture<bool> ParallelDbClient::sendNonQuery(
-        const QString& queryString)
+void ParallelDbClient::setOverflowPolicy(
+        DbConnectionPool::OverflowPolicy policy)
 {
-    QFuture<bool> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeNonQuery,
-                queryString);
-    return future;
+    mPool->setOverflowPolicy(policy);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setOverflowPolicy(policy);
 }
 
 
-QFuture<bool> ParallelDbClient::sendBindedNonQuery(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+int ParallelDbClient::getMaxQueueDepth() const
 {
-    QFuture<bool> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeBindedNonQuery,
-                queryString,
-                placeholders,
-                binaries);
-    return future;
+    return mPool->getMaxQueueDepth();
 }
 
 
-QFuture<QList<QSqlRecord>> ParallelDbClient::select(const QString& queryString)
+DbConnectionPool::OverflowPolicy ParallelDbClient::getOverflowPolicy() const
 {
-    // Copy of an operand is always passed by QtConcurrent::run() to the function!
-    QFuture<QList<QSqlRecord>> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeQuery,
-                queryString);
-    return future;
+    return mPool->getOverflowPolicy();
 }
 
 
-QFuture<QList<QSqlRecord>> ParallelDbClient::select(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+int ParallelDbClient::getQueueDepth() const
 {
-    QFuture<QList<QSqlRecord>> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeBindedQuery,
-                queryString,
-                placeholders,
-                binaries);
-    return future;
+    return mPool->queueDepth();
 }
 
 
-QFuture<bool> ParallelDbClient::insert(const QString &queryString)
+int ParallelDbClient::getActiveWorkers() const
 {
-    QFuture<bool> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeNonQuery,
-                queryString);
-    return future;
+    return mPool->activeCount();
 }
 
 
-QFuture<bool> ParallelDbClient::update(const QString &queryString)
+// Size of the prepared statement cache of every pooled connection,
+// 0 disables caching
+void ParallelDbClient::setStatementCacheSize(int size)
 {
-    return insert(queryString);
+    mPool->setStatementCacheSize(size);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setStatementCacheSize(size);
 }
 
 
-QFuture<bool> ParallelDbClient::del(const QString &queryString)
+int ParallelDbClient::getStatementCacheSize() const
 {
-    return insert(queryString);
+    return mPool->getStatementCacheSize();
 }
 
 
-QFuture<bool> ParallelDbClient::insert(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+quint64 ParallelDbClient::getStatementCacheHits() const
 {
-    QFuture<bool> future = QtConcurrent::run(
-                this,
-                &ParallelDbClient::executeBindedNonQuery,
-                queryString,
-                placeholders,
-                binaries);
-    return future;
+    return mPool->statementCacheStats().hits.loadAcquire();
 }
 
 
-QFuture<bool> ParallelDbClient::update(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+quint64 ParallelDbClient::getStatementCacheMisses() const
 {
-    return insert(queryString, placeholders, binaries);
+    return mPool->statementCacheStats().misses.loadAcquire();
 }
 
 
-QList<QSqlRecord> ParallelDbClient::executeQuery(
-        const QString& queryString)
+quint64 ParallelDbClient::getStatementCacheEvictions() const
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName);
-    QList<QSqlRecord> ans;
+    return mPool->statementCacheStats().evictions.loadAcquire();
+}
 
-    QMutexLocker lock(&mMutex);
-    openDb();
-    if (db.isOpen())
-    {
-        LOG("database " + db.databaseName() + " opened", mUseLog);
 
-        QSqlQuery query(db);
-        query.setForwardOnly(true);
-        query.prepare(queryString);
-        // TODO: consider using query.exec(queryString)
-        if (query.exec())
-        {
-            while (query.next())
-            {
-                ans.append(query.record());
-            }
+// Reads (select*, sendQuery, sendBindedQuery) are spread over replicas,
+// writes, transactions and pipelines always go to the primary database.
+// Replicas use the pool settings of the primary.
+void ParallelDbClient::addReplica(const DbConfig& config)
+{
+    QSharedPointer<Replica> replica(new Replica);
+    QMutexLocker locker(&mRoutingMutex);
+    replica->pool = createPool(
+                QString("%1-replica%2")
+                .arg(mConnectionName).arg(mReplicas.size()),
+                config);
+    mReplicas.append(replica);
+}
 
-            LOG("query executed successfully!", mUseLog);
-        }
-        else
-        {
-            LOG("query not executed " + query.lastError().text(), mUseLog);
-            emit dbError(db.lastError());
-        }
-    }
-    else
+
+void ParallelDbClient::clearReplicas()
+{
+    QList<QSharedPointer<Replica>> replicas;
     {
-        LOG("database " + db.databaseName() + " is not opened", mUseLog);
-        emit dbError(db.lastError());
+        QMutexLocker locker(&mRoutingMutex);
+        replicas.swap(mReplicas);
     }
 
-    return ans;
+    // Reads already routed to a replica keep it, and its pool, alive.
+    // The pool drains its queue once the last of them is done.
+    replicas.clear();
 }
 
 
-QList<QSqlRecord> ParallelDbClient::executeBindedQuery(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+int ParallelDbClient::getReplicaCount() const
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName);
-    QList<QSqlRecord> ans;
+    QMutexLocker locker(&mRoutingMutex);
+    return mReplicas.size();
+}
 
-    if (placeholders.size() != binaries.size() ||
-        placeholders.size() == 0 ||
-        binaries.size() == 0)
-    {
-        LOG(QString("Placeholders and/or binaries") +
-            " are empty or of different size.",
-            mUseLog);
-        return ans;
-    }
 
-    openDb();
-    if (db.isOpen())
-    {
-        LOG("database " + db.databaseName() + " opened", mUseLog);
+void ParallelDbClient::setReplicaSelection(ReplicaSelection selection)
+{
+    QMutexLocker locker(&mRoutingMutex);
+    mReplicaSelection = selection;
+}
 
-        QSqlQuery query(db);
-        query.setForwardOnly(true);
-        query.prepare(queryString);
-        int i = 0;
-        for (auto& placeholder : placeholders)
-        {
-            query.bindValue(
-                        placeholder,
-                        binaries[i++],
-                        QSql::In | QSql::Binary);
-        }
 
-        if (query.exec())
-        {
-            while (query.next())
-            {
-                ans.append(query.record());
-            }
-            LOG("query executed successfully!", mUseLog);
-        }
-        else
-        {
-            LOG("query not executed " + query.lastError().text(), mUseLog);
-            emit dbError(db.lastError());
-        }
-    }
-    else
-    {
-        log("database " + db.databaseName() + " is not opened");
-        emit dbError(db.lastError());
-    }
+ParallelDbClient::ReplicaSelection ParallelDbClient::getReplicaSelection() const
+{
+    QMutexLocker locker(&mRoutingMutex);
+    return mReplicaSelection;
+}
 
-    return ans;
+
+// With read-your-writes enabled, reads of a thread go to the primary
+// for windowMs after its last write, so it sees its own changes
+// in spite of the replication lag
+void ParallelDbClient::setReadYourWrites(bool enabled, int windowMs)
+{
+    QMutexLocker locker(&mRoutingMutex);
+    mReadYourWrites = enabled;
+    mReadYourWritesMs = qMax(0, windowMs);
+    mLastWrites.clear();
 }
 
 
-bool ParallelDbClient::executeNonQuery(const QString& queryString)
+bool ParallelDbClient::isReadYourWrites() const
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName);
-    bool succ = false;
+    QMutexLocker locker(&mRoutingMutex);
+    return mReadYourWrites;
+}
 
-    openDb();
-    if (db.isOpen())
-    {
-        LOG("database " + db.databaseName() + " opened", mUseLog);
 
-        QSqlQuery query(db);
-        query.setForwardOnly(true);
-        query.prepare(queryString);
-        if (query.exec())
-        {
-            succ = true;
-            LOG("query executed successfully!", mUseLog);
-        }
-        else
-        {
-            LOG("query not executed " + query.lastError().text(), mUseLog);
-            emit dbError(db.lastError());
-        }
-    }
-    else
-    {
-        LOG("database " + db.databaseName() + " is not opened", mUseLog);
-        emit dbError(db.lastError());
-    }
+void ParallelDbClient::Replica::finished(double ms)
+{
+    // Exponentially weighted moving average of the read latency
+    const double alpha = 0.2;
+    QMutexLocker locker(&mutex);
+    latencyMs = latencyMs == 0.0 ? ms : alpha * ms + (1.0 - alpha) * latencyMs;
+}
 
-    return succ;
+
+double ParallelDbClient::Replica::expectedWaitMs()
+{
+    QMutexLocker locker(&mutex);
+    return latencyMs * (outstanding.loadAcquire() + 1);
 }
 
 
-bool ParallelDbClient::executeBindedNonQuery(
-        const QString& queryString,
-        const QList<QString>& placeholders,
-        const QList<QByteArray>& binaries)
+// Returns null when the read has to go to the primary. Replicas are
+// scanned from a rotating start, so ties are spread evenly.
+QSharedPointer<ParallelDbClient::Replica> ParallelDbClient::pickReplica()
 {
-    QSqlDatabase db = QSqlDatabase::database(mConnectionName);
-    bool succ = false;
+    QMutexLocker locker(&mRoutingMutex);
+    if (mReplicas.isEmpty())
+        return QSharedPointer<Replica>();
 
-    if (placeholders.size() != binaries.size() ||
-        placeholders.size() == 0 ||
-        binaries.size() == 0)
+    if (mReadYourWrites)
     {
-        LOG(QString("binded query not executed. Placeholders and/or binaries") +
-            " are empty or of different size.", mUseLog);
-        return succ;
+        auto it = mLastWrites.constFind(QThread::currentThreadId());
+        if (it != mLastWrites.constEnd() &&
+                mClock.elapsed() - it.value() < mReadYourWritesMs)
+            return QSharedPointer<Replica>();
     }
 
-    openDb();
-    if (db.isOpen())
+    int count = mReplicas.size();
+    int start = static_cast<int>(mNextReplica++ % static_cast<uint>(count));
+    QSharedPointer<Replica> best;
+    double bestCost = 0.0;
+    for (int i = 0; i < count; ++i)
     {
-        LOG("database " + db.databaseName() + " opened", mUseLog);
-
-        QSqlQuery query(db);
-        query.setForwardOnly(true);
-        query.prepare(queryString);
-        int i = 0;
-        for (auto& placeholder : placeholders)
+        const QSharedPointer<Replica>& replica = mReplicas[(start + i) % count];
+        double cost = mReplicaSelection == ReplicaSelection::LOWEST_LATENCY
+                ? replica->expectedWaitMs()
+                : replica->outstanding.loadAcquire();
+        if (best.isNull() || cost < bestCost)
         {
-            query.bindValue(
-                        placeholder,
-                        binaries[i++],
-                        QSql::In | QSql::Binary);
+            best = replica;
+            bestCost = cost;
         }
+    }
 
-        if (query.exec())
-        {
-            succ = true;
-            LOG("query executed successfully!", mUseLog);
-        }
-        else
+    return best;
+}
+
+
+QSharedPointer<DbConnectionPool> ParallelDbClient::readPool()
+{
+    QSharedPointer<Replica> replica = pickReplica();
+    return replica.isNull() ? mPool : replica->pool;
+}
+
+
+void ParallelDbClient::markWrite()
+{
+    QMutexLocker locker(&mRoutingMutex);
+    if (!mReadYourWrites || mReplicas.isEmpty())
+        return;
+
+    qint64 now = mClock.elapsed();
+    if (mLastWrites.size() > 256)
+    {
+        for (auto it = mLastWrites.begin(); it != mLastWrites.end();)
         {
-            LOG("query not executed " + query.lastError().text(), mUseLog);
-            emit dbError(db.lastError());
+            if (now - it.value() >= mReadYourWritesMs)
+                it = mLastWrites.erase(it);
+            else
+                ++it;
         }
     }
-    else
-    {
-        LOG("database " + db.databaseName() + " is not opened", mUseLog);
-        emit dbError(db.lastError());
-    }
 
-    return succ;
+    mLastWrites.insert(QThread::currentThreadId(), now);
+}
+
+
+// Opt-in cache of select() results keyed by SQL text and parameters.
+// Writes through this client (insert/update/del, sendNonQuery, batches,
+// transactions and pipelines) drop results of the tables they touch.
+// Writes done elsewhere are only caught up with by the TTL.
+void ParallelDbClient::setResultCacheEnabled(bool enabled)
+{
+    mResultCache.setEnabled(enabled);
+}
+
+
+void ParallelDbClient::setResultCacheLimits(qint64 maxBytes, int ttlMs)
+{
+    mResultCache.setLimits(maxBytes, ttlMs);
+}
+
+
+bool ParallelDbClient::isResultCacheEnabled() const
+{
+    return mResultCache.isEnabled();
+}
+
+
+qint64 ParallelDbClient::getResultCacheMaxBytes() const
+{
+    return mResultCache.maxBytes();
+}
+
+
+int ParallelDbClient::getResultCacheTtl() const
+{
+    return mResultCache.ttlMs();
+}
+
+
+void ParallelDbClient::invalidateResultCache(const QString& table)
+{
+    mResultCache.invalidateTable(table);
+}
+
+
+void ParallelDbClient::clearResultCache()
+{
+    mResultCache.clear();
+}
+
+
+quint64 ParallelDbClient::getResultCacheHits() const
+{
+    return mResultCache.hits();
+}
+
+
+quint64 ParallelDbClient::getResultCacheMisses() const
+{
+    return mResultCache.misses();
+}
+
+
+double ParallelDbClient::getResultCacheHitRatio() const
+{
+    return mResultCache.hitRatio();
+}
+
+
+qint64 ParallelDbClient::getResultCacheMemoryUsage() const
+{
+    return mResultCache.memoryUsage();
+}
+
+
+int ParallelDbClient::getResultCacheSize() const
+{
+    return mResultCache.size();
+}
+
+
+// Idle pooled connections are validated every intervalMs (a ping query,
+// or the ODBC dead connection attribute) and dead ones are re-opened.
+// Enabling the monitor also opens all pooled connections right away.
+// 0 disables it.
+void ParallelDbClient::setHealthCheckInterval(int intervalMs)
+{
+    mPool->setHealthCheckInterval(intervalMs);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setHealthCheckInterval(intervalMs);
+
+    locker.unlock();
+    if (intervalMs > 0)
+        preOpenConnections();
+}
+
+
+int ParallelDbClient::getHealthCheckInterval() const
+{
+    return mPool->getHealthCheckInterval();
+}
+
+
+// Opens every pooled connection in the background, so the first
+// queries do not wait for connecting. Connections report their state
+// through connectionStateChanged().
+void ParallelDbClient::preOpenConnections()
+{
+    mPool->checkConnections();
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->checkConnections();
+}
+
+
+// Connection used by the calling thread for metadata (tables, record...).
+// Queries run on per-thread connections owned by mPool.
+void ParallelDbClient::addDb()
+{
+    if (!QSqlDatabase::contains(mConnectionName))
+    {
+        QSqlDatabase::addDatabase(
+                    mConfig.getDbDriver(),
+                    mConnectionName);
+    }
+}
+
+
+void ParallelDbClient::closeDb()
+{
+    QSqlDatabase db = QSqlDatabase::database(mConnectionName, false);
+    if (db.isOpen())
+    {
+        db.close();
+    }
+}
+
+
+void ParallelDbClient::recordResult(
+        DbStatementMetrics* statement,
+        const QList<QSqlRecord>& rows)
+{
+    statement->rows.fetchAndAddRelaxed(static_cast<quint64>(rows.size()));
+    statement->bytes.fetchAndAddRelaxed(
+                static_cast<quint64>(DbResultCache::sizeOf(rows)));
+}
+
+
+void ParallelDbClient::recordResult(
+        DbStatementMetrics* statement,
+        const DbResultSet& result)
+{
+    statement->rows.fetchAndAddRelaxed(static_cast<quint64>(result.rowCount()));
+    statement->bytes.fetchAndAddRelaxed(
+                static_cast<quint64>(result.byteSize()));
+}
+
+
+void ParallelDbClient::recordResult(
+        DbStatementMetrics* statement,
+        const DbPage& page)
+{
+    recordResult(statement, page.rows);
+}
+
+
+void ParallelDbClient::recordResult(
+        DbStatementMetrics* statement,
+        const DbExportResult& result)
+{
+    statement->rows.fetchAndAddRelaxed(static_cast<quint64>(result.rows));
+    statement->bytes.fetchAndAddRelaxed(static_cast<quint64>(result.bytes));
+}
+
+
+void ParallelDbClient::recordResult(
+        DbStatementMetrics* statement,
+        const DbBlobResult& result)
+{
+    statement->bytes.fetchAndAddRelaxed(static_cast<quint64>(result.bytes));
+}
+
+
+// Errors of statements that may be retried are only recorded,
+// retryAfter() reports them once it gives up
+// Whatever fails after a cancel is reported as the cancel
+void ParallelDbClient::fail(DbConnection& connection, const QSqlError& error)
+{
+    QSqlError reported = connection.isCancelled()
+            ? connection.cancelError()
+            : error;
+    connection.setQueryError(reported);
+    if (connection.metrics())
+    {
+        connection.metrics()->recordError(reported, connection.currentStatement());
+    }
+
+    if (!connection.isDeferringErrors())
+    {
+        emit dbError(reported);
+    }
+}
+
+
+// Decides whether the failed attempt is run again, returns the backoff
+// before the next one or -1. The next attempt may run on another pooled
+// connection, this one is re-opened right away when it is dead.
+int ParallelDbClient::retryAfter(
+        DbConnection& connection,
+        const DbRetryPolicy& policy,
+        const QString& queryString,
+        bool write,
+        int attempt)
+{
+    QSqlError error = connection.queryError();
+    if (!error.isValid())
+        return -1;
+
+    // No point in a retry that could only start after the deadline
+    QString driverName = connection.database().driverName();
+    int backoffMs = policy.backoffMs(attempt + 1);
+    qint64 remaining = connection.deadline().remainingTime();
+    bool retry = !connection.isCancelled() &&
+            attempt < policy.getMaxAttempts() &&
+            policy.isRetryable(error, write, driverName) &&
+            (remaining < 0 || backoffMs < remaining);
+
+    if (retry && !mRetryBudget.withdraw())
+    {
+        LOG("retry budget exhausted", mUseLog);
+        mRetriesDenied.fetchAndAddRelaxed(1);
+        retry = false;
+    }
+
+    if (!retry)
+    {
+        emit dbError(error);
+        emit queryFailed(queryString, attempt, error);
+        return -1;
+    }
+
+    mRetries.fetchAndAddRelaxed(1);
+    LOG(QString("attempt %1 failed, retrying: ").arg(attempt) +
+        error.text(), mUseLog);
+    emit queryRetried(queryString, attempt + 1, error);
+
+    if (policy.classify(error, driverName) == DbRetryPolicy::ErrorClass::CONNECTION ||
+            !connection.ping())
+    {
+        connection.reconnect();
+    }
+
+    return backoffMs;
+}
+
+
+// Reads (except streams) and writes submitted through the client are
+// retried, statements of transactions and pipelines are not: a failure
+// there aborts more than the one statement.
+void ParallelDbClient::setRetryPolicy(const DbRetryPolicy& policy)
+{
+    {
+        QMutexLocker locker(&mRetryMutex);
+        mRetryPolicy = policy;
+    }
+
+    mRetryBudget.reset(policy.getBudgetRatio(), policy.getBudgetMinRetries());
+}
+
+
+DbRetryPolicy ParallelDbClient::getRetryPolicy() const
+{
+    QMutexLocker locker(&mRetryMutex);
+    return mRetryPolicy;
+}
+
+
+quint64 ParallelDbClient::getRetries() const
+{
+    return mRetries.loadAcquire();
+}
+
+
+quint64 ParallelDbClient::getRetriesDenied() const
+{
+    return mRetriesDenied.loadAcquire();
+}
+
+
+// Deadline of every call submitted afterwards, 0 means none.
+// DbDeadline overrides it for single calls.
+void ParallelDbClient::setQueryTimeout(int timeoutMs)
+{
+    mQueryTimeoutMs.storeRelease(qMax(0, timeoutMs));
+}
+
+
+int ParallelDbClient::getQueryTimeout() const
+{
+    return mQueryTimeoutMs.loadAcquire();
+}
+
+
+// selectResultSet() over ODBC (MSSQL engines) without placeholders
+// fetches rowArraySize rows at once into bound column buffers instead
+// of going through QODBC row by row
+void ParallelDbClient::setNativeFetch(bool enabled, int rowArraySize)
+{
+    mNativeFetchRows.storeRelease(enabled ? qMax(1, rowArraySize) : 0);
+}
+
+
+bool ParallelDbClient::isNativeFetch() const
+{
+    return mNativeFetchRows.loadAcquire() > 0;
+}
+
+
+int ParallelDbClient::getNativeFetchRowArraySize() const
+{
+    return mNativeFetchRows.loadAcquire();
+}
+
+
+// Weighted round robin between the priority classes of queued queries,
+// on the primary and on every replica
+void ParallelDbClient::setPriorityWeights(int interactive, int normal, int bulk)
+{
+    mPool->setPriorityWeights(interactive, normal, bulk);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setPriorityWeights(interactive, normal, bulk);
+}
+
+
+// Pooled connections BULK queries may hold at once, per pool.
+// 0 means half of the maximum pool size.
+void ParallelDbClient::setMaxBulkConnections(int connections)
+{
+    mPool->setMaxBulkWorkers(connections);
+
+    QMutexLocker locker(&mRoutingMutex);
+    for (const QSharedPointer<Replica>& replica : mReplicas)
+        replica->pool->setMaxBulkWorkers(connections);
+}
+
+
+int ParallelDbClient::getPriorityWeight(DbConnectionPool::Priority priority) const
+{
+    return mPool->getPriorityWeight(priority);
+}
+
+
+int ParallelDbClient::getMaxBulkConnections() const
+{
+    return mPool->getMaxBulkWorkers();
+}
+
+
+// Taken when the call is submitted, time spent in the queue counts
+QDeadlineTimer ParallelDbClient::deadline() const
+{
+    const DbDeadline* scoped = DbDeadline::current();
+    if (scoped != nullptr)
+        return scoped->deadline();
+
+    int timeoutMs = mQueryTimeoutMs.loadAcquire();
+    if (timeoutMs <= 0)
+        return QDeadlineTimer(QDeadlineTimer::Forever);
+
+    return QDeadlineTimer(timeoutMs);
+}
+
+
+void ParallelDbClient::openDb(DbConnection& connection)
+{
+    if (!connection.open())
+    {
+        fail(connection, connection.lastError());
+    }
+}
+
+
+QFuture<QList<QSqlRecord>> ParallelDbClient::sendQuery(
+        const QString& queryString)
+{
+    // Copy of an operand is always stored by std::bind() for the worker!
+    QFuture<QList<QSqlRecord>> future = runRead<QList<QSqlRecord>>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString));
+    return future;
+}
+
+
+QFuture<QList<QSqlRecord>> ParallelDbClient::sendBindedQuery(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QFuture<QList<QSqlRecord>> future = runRead<QList<QSqlRecord>>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeBindedQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    placeholders,
+                    binaries));
+    return future;
+}
+
+
+QFuture<bool> ParallelDbClient::sendNonQuery(
+        const QString& queryString)
+{
+    QFuture<bool> future = runWrite<bool>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeNonQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString));
+    return future;
+}
+
+
+QFuture<bool> ParallelDbClient::sendBindedNonQuery(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QFuture<bool> future = runWrite<bool>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeBindedNonQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    placeholders,
+                    binaries));
+    return future;
+}
+
+
+QFuture<QList<QSqlRecord>> ParallelDbClient::select(const QString& queryString)
+{
+    if (mResultCache.isEnabled())
+        return runCachedSelect(queryString, DbParams());
+
+    // Copy of an operand is always stored by std::bind() for the worker!
+    QFuture<QList<QSqlRecord>> future = runRead<QList<QSqlRecord>>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString));
+    return future;
+}
+
+
+QFuture<QList<QSqlRecord>> ParallelDbClient::select(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    if (mResultCache.isEnabled() &&
+            !placeholders.isEmpty() &&
+            placeholders.size() == binaries.size())
+    {
+        DbParams params;
+        for (int i = 0; i < placeholders.size(); ++i)
+        {
+            params.bind(placeholders[i], binaries[i]);
+        }
+
+        return runCachedSelect(queryString, std::move(params));
+    }
+
+    QFuture<QList<QSqlRecord>> future = runRead<QList<QSqlRecord>>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeBindedQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    placeholders,
+                    binaries));
+    return future;
+}
+
+
+QFuture<QList<QSqlRecord>> ParallelDbClient::select(
+        const QString& queryString,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    if (mResultCache.isEnabled())
+        return runCachedSelect(queryString, std::move(params), priority);
+
+    QFuture<QList<QSqlRecord>> future = runRead<QList<QSqlRecord>>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeParamsQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    std::move(params)),
+                priority);
+    return future;
+}
+
+
+// Failed queries are not cached. A result is not cached either when
+// its tables were written while it was read.
+QFuture<QList<QSqlRecord>> ParallelDbClient::runCachedSelect(
+        const QString& queryString,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    QByteArray key = DbResultCache::key(queryString, params);
+    QList<QSqlRecord> rows;
+    if (mResultCache.find(key, rows))
+        return Db::readyFuture(rows);
+
+    quint64 stamp = mResultCache.stamp();
+    return runRead<QList<QSqlRecord>>(
+                queryString,
+                [this, key, queryString, params, stamp](
+                DbConnection& connection)
+    {
+        bool succ = false;
+        QList<QSqlRecord> ans = executeCheckedQuery(
+                    connection, queryString, params, succ);
+        if (succ)
+            mResultCache.insert(key, queryString, ans, stamp);
+
+        return ans;
+    }, priority);
+}
+
+
+QFuture<DbResultSet> ParallelDbClient::selectResultSet(
+        const QString& queryString)
+{
+    return selectResultSet(
+                queryString, QList<QString>(), QList<QByteArray>());
+}
+
+
+QFuture<DbResultSet> ParallelDbClient::selectResultSet(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QFuture<DbResultSet> future = runRead<DbResultSet>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeResultSetQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    placeholders,
+                    binaries));
+    return future;
+}
+
+
+// Rows are handed over in chunks as they are fetched. The worker waits
+// while maxPendingChunks are not consumed yet. Destroy or cancel()
+// the stream to stop fetching early. Runs like the callback overload,
+// under the deadline and on a replica when there are some.
+QSharedPointer<DbRowStream> ParallelDbClient::selectStream(
+        const QString& queryString,
+        int chunkSize,
+        int maxPendingChunks,
+        DbConnectionPool::Priority priority)
+{
+    QSharedPointer<DbRowStream> stream(new DbRowStream(maxPendingChunks));
+    QSharedPointer<DbRowStream::Channel> channel = stream->channel();
+    // Ends the stream as well when the task is dropped without running
+    // (deadline, cancel, stopped pool)
+    QSharedPointer<DbRowStream::Channel> closer(
+                channel.data(),
+                [channel](DbRowStream::Channel* c) { c->finish(false); });
+    RowConsumer consumer = counting(
+                queryString,
+                [channel](const QList<QSqlRecord>& chunk)
+    {
+        return channel->push(chunk);
+    });
+
+    runRead<bool>(
+                measured<bool>(
+                    queryString,
+                    [this, queryString, chunkSize, consumer, closer](
+                    DbConnection& connection)
+    {
+        bool succ = executeStreamedQuery(
+                    connection, queryString, DbParams(), chunkSize, consumer);
+        closer->finish(succ);
+        return succ;
+    }),
+                priority);
+
+    return stream;
+}
+
+
+// Consumer is called from the worker thread for every chunk,
+// returning false from it stops fetching
+QFuture<bool> ParallelDbClient::selectStream(
+        const QString& queryString,
+        const RowConsumer& consumer,
+        int chunkSize,
+        DbConnectionPool::Priority priority)
+{
+    QFuture<bool> future = runRead<bool>(
+                measured<bool>(
+                    queryString,
+                    std::bind(
+                        &ParallelDbClient::executeStreamedQuery,
+                        this,
+                        std::placeholders::_1,
+                        queryString,
+                        DbParams(),
+                        chunkSize,
+                        counting(queryString, consumer))),
+                priority);
+    return future;
+}
+
+
+// Streams are not retried, the consumer may already have got rows.
+// Rows are counted in the metrics as they are handed over.
+ParallelDbClient::RowConsumer ParallelDbClient::counting(
+        const QString& queryString,
+        RowConsumer consumer)
+{
+    DbStatementMetrics* total = &mMetrics.total();
+    DbStatementMetrics* statement = mMetrics.statement(queryString);
+    return [consumer, total, statement](const QList<QSqlRecord>& chunk)
+    {
+        recordResult(total, chunk);
+        recordResult(statement, chunk);
+        return consumer(chunk);
+    };
+}
+
+
+// Pass the token of a page to get the next one. KEYSET pages seek past
+// the last key of the previous page, page K costs as much as page 1 and
+// tokens survive restarts. CURSOR pages are read from a forward-only
+// cursor kept open between calls; it holds a pooled connection until
+// its last page was read or it was idle for DEFAULT_CURSOR_IDLE_MS.
+QFuture<DbPage> ParallelDbClient::selectPage(
+        const QString& queryString,
+        const DbPageOptions& options,
+        const QByteArray& token,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    // Cursor pages fall back to keyset pages when no connection could be
+    // reserved, their tokens keep pointing to keyset pages
+    QVariantList lastKey;
+    bool keysetToken = !token.isEmpty() && !options.keyColumns.isEmpty()
+            && DbPaging::readKeysetToken(token, queryString, options, params, lastKey);
+    if (options.mode == DbPageOptions::Mode::CURSOR && !keysetToken)
+    {
+        return selectCursorPage(
+                    queryString, options, token, std::move(params), priority);
+    }
+
+    if (options.keyColumns.isEmpty())
+    {
+        emit dbError(QSqlError(
+                         QString(),
+                         "Keyset paging needs key columns",
+                         QSqlError::StatementError));
+        return Db::readyFuture(DbPage());
+    }
+
+    if (!token.isEmpty() && !keysetToken)
+    {
+        emit dbError(QSqlError(
+                         QString(),
+                         "Invalid page token",
+                         QSqlError::StatementError));
+        return Db::readyFuture(DbPage());
+    }
+
+    QFuture<DbPage> future = runRead<DbPage>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeKeysetPage,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    options,
+                    lastKey,
+                    std::move(params)),
+                priority);
+    return future;
+}
+
+
+// Each cursor reserves its own pooled connection. At least one
+// connection is always left for the shared queue, cursors beyond that
+// are closed from the start.
+QSharedPointer<DbCursor> ParallelDbClient::openCursor(
+        const QString& queryString,
+        DbParams params)
+{
+    QSharedPointer<DbConnectionPool> pool = readPool();
+    int workerId = pool->reserve(1);
+    if (workerId < 0)
+    {
+        emit dbError(QSqlError(
+                         QString(),
+                         "No pooled connection left for a cursor",
+                         QSqlError::ConnectionError));
+    }
+
+    return QSharedPointer<DbCursor>(
+                new DbCursor(this, pool, workerId, queryString, std::move(params)));
+}
+
+
+// Tokens are random, a caller can not guess the cursor of another one.
+// Without a connection left to reserve the first page is read as a
+// keyset page when key columns are given.
+QFuture<DbPage> ParallelDbClient::selectCursorPage(
+        const QString& queryString,
+        const DbPageOptions& options,
+        const QByteArray& token,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    QSharedPointer<DbCursor> cursor;
+    if (token.isEmpty())
+    {
+        QSharedPointer<DbConnectionPool> pool = readPool();
+        int workerId = pool->reserve(1);
+        if (workerId < 0 && !options.keyColumns.isEmpty())
+        {
+            DbPageOptions keyset = options;
+            keyset.mode = DbPageOptions::Mode::KEYSET;
+            return selectPage(queryString, keyset, token, std::move(params), priority);
+        }
+        else if (workerId < 0)
+        {
+            emit dbError(QSqlError(
+                             QString(),
+                             "No pooled connection left for a cursor",
+                             QSqlError::ConnectionError));
+            return Db::readyFuture(DbPage());
+        }
+
+        QByteArray id = QUuid::createUuid().toRfc4122();
+        cursor = QSharedPointer<DbCursor>(
+                    new DbCursor(this, pool, workerId, queryString, std::move(params)));
+        cursor->mToken = DbPaging::cursorToken(id);
+
+        QMutexLocker locker(&mCursorMutex);
+        PagingCursor& entry = mCursors[id];
+        entry.cursor = cursor;
+        entry.lastUsed = mClock.elapsed();
+    }
+    else
+    {
+        QByteArray id;
+        QMutexLocker locker(&mCursorMutex);
+        auto it = mCursors.end();
+        if (DbPaging::readCursorToken(token, id))
+            it = mCursors.find(id);
+
+        if (it == mCursors.end())
+        {
+            locker.unlock();
+            emit dbError(QSqlError(
+                             QString(),
+                             "Unknown or expired page token",
+                             QSqlError::StatementError));
+            return Db::readyFuture(DbPage());
+        }
+
+        it->lastUsed = mClock.elapsed();
+        cursor = it->cursor;
+    }
+
+    return cursor->fetch(options.pageSize);
+}
+
+
+// Finished cursors and cursors idle for DEFAULT_CURSOR_IDLE_MS give
+// their connections back. Closed outside of the lock.
+void ParallelDbClient::sweepCursors()
+{
+    QList<PagingCursor> dropped;
+    QMutexLocker locker(&mCursorMutex);
+    qint64 now = mClock.elapsed();
+    for (auto it = mCursors.begin(); it != mCursors.end();)
+    {
+        if (!it->cursor->isOpen()
+                || now - it->lastUsed > DbConstants::DEFAULT_CURSOR_IDLE_MS)
+        {
+            dropped.append(it.value());
+            it = mCursors.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    locker.unlock();
+    dropped.clear();
+}
+
+
+// Rows go from the cursor through a buffered writer to the file, only
+// one chunk is held at a time. With options.keyColumn and parts > 1 the
+// key range is read first and split into parts exported in parallel;
+// the parts do not share a snapshot. Exports are BULK work by default,
+// the pool caps how many connections they take.
+QFuture<DbExportResult> ParallelDbClient::exportQuery(
+        const QString& queryString,
+        const QString& fileName,
+        const DbExportOptions& options,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    DbScanOptions scan;
+    scan.keyColumn = options.keyColumn;
+    scan.parallelism = options.parts;
+    bool partFiles = !options.keyColumn.isEmpty() && options.parts > 1;
+
+    DbExportResult failed;
+    failed.errorText = "Export could not be started";
+
+    return runPartitioned<DbExportResult>(
+                readPool(),
+                queryString,
+                params,
+                scan,
+                &DbExport::combine,
+                [this, queryString, params, fileName, options, partFiles](
+                DbConnection& connection,
+                int part,
+                const QVariantList& boundaries)
+    {
+        DbParams partParams = params;
+        QString partQuery = DbPartition::rangeQuery(
+                    connection.database(), queryString, options.keyColumn,
+                    boundaries, part, partParams);
+        return executeExport(
+                    connection,
+                    partQuery,
+                    partParams,
+                    partFiles ? DbExportWriter::partFileName(fileName, part) : fileName,
+                    options);
+    }, failed, priority);
+}
+
+
+// Ranges of options.keyColumn run on up to options.parallelism pooled
+// connections at once. Rows come in key range order, unordered within
+// a range. Any failed range fails the whole call.
+QFuture<QList<QSqlRecord>> ParallelDbClient::selectParallel(
+        const QString& queryString,
+        const DbScanOptions& options,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    QSharedPointer<QAtomicInt> failed(new QAtomicInt(0));
+    return runPartitioned<QList<QSqlRecord>>(
+                readPool(),
+                queryString,
+                params,
+                options,
+                [failed](const QVector<QList<QSqlRecord>>& parts)
+    {
+        if (failed->loadAcquire() != 0)
+            return QList<QSqlRecord>();
+
+        return DbScatter::merge(parts, DbScatterOptions());
+    },
+                [this, queryString, params, options, failed](
+                DbConnection& connection,
+                int part,
+                const QVariantList& boundaries)
+    {
+        DbParams partParams = params;
+        QString partQuery = DbPartition::rangeQuery(
+                    connection.database(), queryString, options.keyColumn,
+                    boundaries, part, partParams);
+        bool succ = false;
+        QList<QSqlRecord> rows = executeCheckedQuery(
+                    connection, partQuery, partParams, succ);
+        if (!succ)
+            failed->storeRelease(1);
+
+        return rows;
+    }, QList<QSqlRecord>(), priority);
+}
+
+
+// Like selectStream(), the ranges call the consumer one at a time from
+// their worker threads, chunks of different ranges interleave. Returning
+// false from the consumer stops every range.
+QFuture<bool> ParallelDbClient::selectParallelStream(
+        const QString& queryString,
+        const RowConsumer& consumer,
+        const DbScanOptions& options,
+        DbParams params,
+        int chunkSize,
+        DbConnectionPool::Priority priority)
+{
+    QSharedPointer<QMutex> serial(new QMutex);
+    QSharedPointer<QAtomicInt> stopped(new QAtomicInt(0));
+    RowConsumer serialized = [consumer, serial, stopped](
+            const QList<QSqlRecord>& chunk)
+    {
+        QMutexLocker locker(serial.data());
+        if (stopped->loadAcquire() != 0)
+            return false;
+
+        if (consumer(chunk))
+            return true;
+
+        stopped->storeRelease(1);
+        return false;
+    };
+
+    return runPartitioned<bool>(
+                readPool(),
+                queryString,
+                params,
+                options,
+                [](const QVector<bool>& parts)
+    {
+        return !parts.contains(false);
+    },
+                [this, queryString, params, options, chunkSize, serialized](
+                DbConnection& connection,
+                int part,
+                const QVariantList& boundaries)
+    {
+        DbParams partParams = params;
+        QString partQuery = DbPartition::rangeQuery(
+                    connection.database(), queryString, options.keyColumn,
+                    boundaries, part, partParams);
+        return executeStreamedQuery(
+                    connection, partQuery, partParams, chunkSize, serialized);
+    }, false, priority);
+}
+
+
+QFuture<bool> ParallelDbClient::insert(const QString &queryString)
+{
+    QFuture<bool> future = runWrite<bool>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeNonQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString));
+    return future;
+}
+
+
+QFuture<bool> ParallelDbClient::insert(
+        const QString& queryString,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    QFuture<bool> future = runWrite<bool>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeParamsNonQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    std::move(params)),
+                priority);
+    return future;
+}
+
+
+QFuture<bool> ParallelDbClient::update(const QString &queryString)
+{
+    return insert(queryString);
+}
+
+
+QFuture<bool> ParallelDbClient::update(
+        const QString& queryString,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    return insert(queryString, std::move(params), priority);
+}
+
+
+QFuture<bool> ParallelDbClient::del(const QString &queryString)
+{
+    return insert(queryString);
+}
+
+
+QFuture<bool> ParallelDbClient::del(
+        const QString& queryString,
+        DbParams params,
+        DbConnectionPool::Priority priority)
+{
+    return insert(queryString, std::move(params), priority);
+}
+
+
+QFuture<bool> ParallelDbClient::insert(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QFuture<bool> future = runWrite<bool>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeBindedNonQuery,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    placeholders,
+                    binaries));
+    return future;
+}
+
+
+QFuture<bool> ParallelDbClient::update(
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    return insert(queryString, placeholders, binaries);
+}
+
+
+// Every item of columns holds values of one parameter, in placeholder
+// order, for all rows of the batch. All columns must have the same size.
+QFuture<DbBatchResult> ParallelDbClient::insertBatch(
+        const QString& queryString,
+        const QList<QVariantList>& columns,
+        DbConnectionPool::Priority priority)
+{
+    QFuture<DbBatchResult> future = runWrite<DbBatchResult>(
+                queryString,
+                std::bind(
+                    &ParallelDbClient::executeBatch,
+                    this,
+                    std::placeholders::_1,
+                    queryString,
+                    columns,
+                    false),
+                priority);
+    return future;
+}
+
+
+QFuture<DbBatchResult> ParallelDbClient::updateBatch(
+        const QString& queryString,
+        const QList<QVariantList>& columns,
+        DbConnectionPool::Priority priority)
+{
+    return insertBatch(queryString, columns, priority);
+}
+
+
+QList<QSqlRecord> ParallelDbClient::executeQuery(
+        DbConnection& connection,
+        const QString& queryString)
+{
+    QSqlDatabase db = connection.database();
+    QList<QSqlRecord> ans;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        if (connection.exec(query))
+        {
+            while (query.next())
+            {
+                ans.append(query.record());
+            }
+
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        // Releases the cursor, cached statement can be executed again
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+QList<QSqlRecord> ParallelDbClient::executeBindedQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QSqlDatabase db = connection.database();
+    QList<QSqlRecord> ans;
+
+    if (placeholders.size() != binaries.size() ||
+        placeholders.size() == 0 ||
+        binaries.size() == 0)
+    {
+        LOG(QString("Placeholders and/or binaries") +
+            " are empty or of different size.",
+            mUseLog);
+        return ans;
+    }
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        int i = 0;
+        for (auto& placeholder : placeholders)
+        {
+            query.bindValue(
+                        placeholder,
+                        binaries[i++],
+                        QSql::In | QSql::Binary);
+        }
+
+        if (connection.exec(query))
+        {
+            while (query.next())
+            {
+                ans.append(query.record());
+            }
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        log("database " + db.databaseName() + " is not opened");
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+QList<QSqlRecord> ParallelDbClient::executeParamsQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params)
+{
+    bool succ = false;
+    return executeCheckedQuery(connection, queryString, params, succ);
+}
+
+
+DbPage ParallelDbClient::executeKeysetPage(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbPageOptions& options,
+        const QVariantList& lastKey,
+        const DbParams& params)
+{
+    DbPage ans;
+    DbParams pageParams = params;
+    QString pageQuery = DbPaging::keysetQuery(
+                connection.database(), queryString, options, lastKey, pageParams);
+
+    bool succ = false;
+    ans.rows = executeCheckedQuery(connection, pageQuery, pageParams, succ);
+    if (succ && ans.rows.size() > qMax(1, options.pageSize))
+    {
+        ans.rows.removeLast();
+        ans.hasMore = true;
+        ans.token = DbPaging::keysetToken(
+                    queryString,
+                    options,
+                    params,
+                    DbPaging::keyOf(ans.rows.last(), options.keyColumns));
+    }
+
+    return ans;
+}
+
+
+// Like executeParamsQuery(), succ tells an empty result from a failure
+QList<QSqlRecord> ParallelDbClient::executeCheckedQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params,
+        bool& succ)
+{
+    QSqlDatabase db = connection.database();
+    QList<QSqlRecord> ans;
+    succ = false;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        params.bindTo(query);
+
+        if (connection.exec(query))
+        {
+            succ = true;
+            while (query.next())
+            {
+                ans.append(query.record());
+            }
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+bool ParallelDbClient::executeParamsNonQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        params.bindTo(query);
+
+        if (connection.exec(query))
+        {
+            succ = true;
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return succ;
+}
+
+
+// Placeholders are optional here, a query without them is just executed
+DbResultSet ParallelDbClient::executeResultSetQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QSqlDatabase db = connection.database();
+    DbResultSet ans;
+
+    if (placeholders.size() != binaries.size())
+    {
+        LOG(QString("Placeholders and binaries are of different size."),
+            mUseLog);
+        return ans;
+    }
+
+    openDb(connection);
+    int nativeRows = mNativeFetchRows.loadAcquire();
+    if (db.isOpen() && nativeRows > 0 && placeholders.isEmpty() &&
+            DbOdbc::isOdbc(db))
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QString errorText;
+        if (DbOdbc::executeResultSet(connection, queryString, nativeRows, ans, errorText))
+        {
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + errorText, mUseLog);
+            ans.clear();
+            fail(connection, QSqlError(
+                     QString(),
+                     errorText,
+                     QSqlError::StatementError));
+        }
+    }
+    else if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        // MySQL DECIMAL is reported as double, it is read as its exact
+        // text instead (MYSQL_TYPE_DECIMAL 0, MYSQL_TYPE_NEWDECIMAL 246)
+        bool mysql = db.driverName().startsWith("QMYSQL");
+        QSqlQuery query = connection.statement(queryString);
+        if (mysql)
+            query.setNumericalPrecisionPolicy(QSql::HighPrecision);
+
+        int i = 0;
+        for (auto& placeholder : placeholders)
+        {
+            query.bindValue(
+                        placeholder,
+                        binaries[i++],
+                        QSql::In | QSql::Binary);
+        }
+
+        if (connection.exec(query))
+        {
+            QSqlRecord record = query.record();
+            QVector<DbResultSet::ColumnType> types(record.count());
+            for (int c = 0; c < record.count(); ++c)
+            {
+                int typeId = record.field(c).typeID();
+                types[c] = mysql && (typeId == 0 || typeId == 246)
+                        ? DbResultSet::ColumnType::TEXT
+                        : DbResultSet::columnTypeOf(record.field(c).type());
+            }
+
+            ans.setColumns(record, types);
+            while (query.next())
+            {
+                ans.appendRow(query);
+            }
+
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        // The statement is cached, select() of the same text reads doubles
+        connection.finish(query);
+        if (mysql)
+            query.setNumericalPrecisionPolicy(db.numericalPrecisionPolicy());
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+// Keys that can not be split leave a single range
+bool ParallelDbClient::executeBoundaries(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params,
+        const DbScanOptions& options,
+        QVariantList& boundaries)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+    if (options.boundaries == DbScanOptions::Boundaries::SAMPLED)
+    {
+        QList<QSqlRecord> sample = executeCheckedQuery(
+                    connection,
+                    DbPartition::sampleQuery(
+                        db, queryString, options.keyColumn, options.sampleSize),
+                    params,
+                    succ);
+        QVariantList keys;
+        for (const QSqlRecord& record : sample)
+        {
+            keys.append(record.value(0));
+        }
+
+        boundaries = DbPartition::quantiles(keys, options.parallelism);
+        return succ;
+    }
+
+    QList<QSqlRecord> bounds = executeCheckedQuery(
+                connection,
+                DbPartition::boundsQuery(db, queryString, options.keyColumn),
+                params,
+                succ);
+    if (succ && !bounds.isEmpty())
+    {
+        boundaries = DbPartition::split(
+                    bounds.first().value(0), bounds.first().value(1), options.parallelism);
+    }
+
+    return succ;
+}
+
+
+DbExportResult ParallelDbClient::executeExport(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params,
+        const QString& fileName,
+        const DbExportOptions& options)
+{
+    DbExportResult ans;
+    DbExportWriter writer(fileName, options);
+    if (!writer.open())
+    {
+        ans.errorText = writer.errorString();
+        LOG(ans.errorText, mUseLog);
+        return ans;
+    }
+
+    bool fetched = executeStreamedQuery(
+                connection,
+                queryString,
+                params,
+                options.chunkSize,
+                [&writer](const QList<QSqlRecord>& chunk)
+    {
+        return writer.write(chunk);
+    });
+
+    if (!fetched)
+    {
+        writer.discard();
+        ans.errorText = connection.queryError().text();
+        return ans;
+    }
+
+    ans.succ = writer.close();
+    ans.errorText = writer.errorString();
+    ans.rows = writer.rows();
+    ans.bytes = writer.bytes();
+    if (ans.succ)
+        ans.files.append(fileName);
+
+    return ans;
+}
+
+
+DbBlobResult ParallelDbClient::executeReadBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* target,
+        int chunkSize)
+{
+    QSqlDatabase db = connection.database();
+    DbBlobResult ans;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        if (DbOdbc::isOdbc(db))
+        {
+            ans = DbOdbc::readBlob(
+                        connection,
+                        DbBlob::selectQuery(db, location),
+                        location.key,
+                        target,
+                        chunkSize);
+        }
+        else if (DbSqlite::hasNativeBlob(db))
+        {
+            ans = DbSqlite::readBlob(connection, location, target, chunkSize);
+        }
+        else
+        {
+            ans = DbBlob::readValue(connection, location, target);
+        }
+
+        if (ans.succ)
+        {
+            LOG(QString("blob read, %1 bytes").arg(ans.bytes), mUseLog);
+        }
+        else
+        {
+            LOG("blob not read " + ans.errorText, mUseLog);
+            fail(connection, QSqlError(
+                     QString(),
+                     ans.errorText,
+                     QSqlError::StatementError));
+        }
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        ans.errorText = db.lastError().text();
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+DbBlobResult ParallelDbClient::executeWriteBlob(
+        DbConnection& connection,
+        const DbBlobLocation& location,
+        QIODevice* source,
+        int chunkSize)
+{
+    QSqlDatabase db = connection.database();
+    DbBlobResult ans;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        if (DbOdbc::isOdbc(db))
+        {
+            ans = DbOdbc::writeBlob(
+                        connection,
+                        DbBlob::updateQuery(db, location),
+                        location.key,
+                        source,
+                        chunkSize);
+        }
+        else if (DbSqlite::hasNativeBlob(db))
+        {
+            ans = DbSqlite::writeBlob(connection, location, source, chunkSize);
+        }
+        else
+        {
+            ans = DbBlob::writeValue(connection, location, source);
+        }
+
+        if (ans.succ)
+        {
+            LOG(QString("blob written, %1 bytes").arg(ans.bytes), mUseLog);
+        }
+        else
+        {
+            LOG("blob not written " + ans.errorText, mUseLog);
+            fail(connection, QSqlError(
+                     QString(),
+                     ans.errorText,
+                     QSqlError::StatementError));
+        }
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        ans.errorText = db.lastError().text();
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+bool ParallelDbClient::executeStreamedQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const DbParams& params,
+        int chunkSize,
+        const RowConsumer& consumer)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+    chunkSize = qMax(1, chunkSize);
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        params.bindTo(query);
+        if (connection.exec(query))
+        {
+            succ = true;
+            QList<QSqlRecord> chunk;
+            chunk.reserve(chunkSize);
+            while (query.next())
+            {
+                chunk.append(query.record());
+                if (chunk.size() >= chunkSize)
+                {
+                    bool more = consumer(chunk);
+                    chunk.clear();
+                    if (!more)
+                    {
+                        LOG("stream stopped by the consumer", mUseLog);
+                        break;
+                    }
+                }
+            }
+
+            if (!chunk.isEmpty())
+            {
+                consumer(chunk);
+            }
+
+            // A fetch that broke off must not pass for the end of the rows
+            if (query.lastError().isValid())
+            {
+                succ = false;
+                LOG("fetch failed " + query.lastError().text(), mUseLog);
+                fail(connection, query.lastError());
+            }
+            else
+            {
+                LOG("query executed successfully!", mUseLog);
+            }
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return succ;
+}
+
+
+bool ParallelDbClient::executeNonQuery(
+        DbConnection& connection,
+        const QString& queryString)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        if (connection.exec(query))
+        {
+            succ = true;
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return succ;
+}
+
+
+bool ParallelDbClient::executeBindedNonQuery(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QString>& placeholders,
+        const QList<QByteArray>& binaries)
+{
+    QSqlDatabase db = connection.database();
+    bool succ = false;
+
+    if (placeholders.size() != binaries.size() ||
+        placeholders.size() == 0 ||
+        binaries.size() == 0)
+    {
+        LOG(QString("binded query not executed. Placeholders and/or binaries") +
+            " are empty or of different size.", mUseLog);
+        return succ;
+    }
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        QSqlQuery query = connection.statement(queryString);
+        int i = 0;
+        for (auto& placeholder : placeholders)
+        {
+            query.bindValue(
+                        placeholder,
+                        binaries[i++],
+                        QSql::In | QSql::Binary);
+        }
+
+        if (connection.exec(query))
+        {
+            succ = true;
+            LOG("query executed successfully!", mUseLog);
+        }
+        else
+        {
+            LOG("query not executed " + query.lastError().text(), mUseLog);
+            fail(connection, query.lastError());
+        }
+
+        connection.finish(query);
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        fail(connection, db.lastError());
+    }
+
+    return succ;
+}
+
+
+// inTransaction: the caller holds a transaction on the connection, the
+// batch must not begin or commit one of its own. Starting one would
+// commit the caller's on MySQL.
+DbBatchResult ParallelDbClient::executeBatch(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QVariantList>& columns,
+        bool inTransaction)
+{
+    QSqlDatabase db = connection.database();
+    DbBatchResult ans;
+
+    int rows = columns.isEmpty() ? 0 : columns.first().size();
+    for (auto& column : columns)
+    {
+        if (column.size() != rows)
+        {
+            LOG(QString("batch not executed. Parameter columns") +
+                " are of different size.", mUseLog);
+            ans.errorText = "Parameter columns are of different size";
+            return ans;
+        }
+    }
+
+    openDb(connection);
+    if (db.isOpen())
+    {
+        LOG("database " + db.databaseName() + " opened", mUseLog);
+
+        // Parameter arrays bind positionally, ODBC knows no named
+        // placeholders
+        if (DbOdbc::isOdbc(db) && !columns.isEmpty())
+        {
+            ans = DbOdbc::executeBatch(
+                        connection,
+                        queryString,
+                        columns,
+                        DbConstants::DEFAULT_BATCH_PARAMSET_SIZE);
+        }
+        else if (db.driver()->hasFeature(QSqlDriver::BatchOperations))
+        {
+            ans = executeDriverBatch(connection, queryString, columns);
+        }
+        else
+        {
+            ans = executeBatchInTransaction(connection, queryString, columns, inTransaction);
+        }
+
+        if (ans.succ)
+        {
+            LOG(QString("batch executed successfully, %1 rows affected")
+                .arg(ans.rowsAffected), mUseLog);
+        }
+        else
+        {
+            LOG(QString("batch failed for %1 rows: ")
+                .arg(ans.failedRows.size()) + ans.errorText, mUseLog);
+            // The driver error keeps its native code, retries are
+            // decided by it
+            fail(connection, ans.error.isValid()
+                 ? ans.error
+                 : QSqlError(QString(), ans.errorText, QSqlError::StatementError));
+        }
+    }
+    else
+    {
+        LOG("database " + db.databaseName() + " is not opened", mUseLog);
+        ans.errorText = db.lastError().text();
+        fail(connection, db.lastError());
+    }
+
+    return ans;
+}
+
+
+// Driver executes the whole batch at once, it can not tell which rows
+// failed, so on error all of them are reported
+DbBatchResult ParallelDbClient::executeDriverBatch(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QVariantList>& columns)
+{
+    DbBatchResult ans;
+    int rows = columns.isEmpty() ? 0 : columns.first().size();
+
+    QSqlQuery query = connection.statement(queryString);
+    for (int c = 0; c < columns.size(); ++c)
+    {
+        query.bindValue(c, columns[c]);
+    }
+
+    if (connection.execBatch(query))
+    {
+        ans.succ = true;
+        ans.rowsAffected = qMax(0, query.numRowsAffected());
+    }
+    else
+    {
+        ans.setError(query.lastError());
+        for (int row = 0; row < rows; ++row)
+        {
+            ans.failedRows.append(row);
+        }
+    }
+
+    connection.finish(query);
+    return ans;
+}
+
+
+// One prepared statement executed row by row inside a single transaction.
+// Failing rows are skipped and reported, the rest is committed. In a
+// transaction of the caller nothing is committed here.
+DbBatchResult ParallelDbClient::executeBatchInTransaction(
+        DbConnection& connection,
+        const QString& queryString,
+        const QList<QVariantList>& columns,
+        bool callerTransaction)
+{
+    QSqlDatabase db = connection.database();
+    DbBatchResult ans;
+    int rows = columns.isEmpty() ? 0 : columns.first().size();
+
+    bool inTransaction = !callerTransaction && db.transaction();
+    QSqlQuery query = connection.statement(queryString);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int c = 0; c < columns.size(); ++c)
+        {
+            query.bindValue(c, columns[c][row]);
+        }
+
+        if (connection.exec(query))
+        {
+            ans.rowsAffected += qMax(0, query.numRowsAffected());
+        }
+        else
+        {
+            ans.failedRows.append(row);
+            if (!ans.error.isValid())
+                ans.setError(query.lastError());
+        }
+    }
+
+    connection.finish(query);
+
+    if (inTransaction && !db.commit())
+    {
+        ans.setError(db.lastError());
+        ans.rowsAffected = 0;
+        ans.failedRows.clear();
+        for (int row = 0; row < rows; ++row)
+        {
+            ans.failedRows.append(row);
+        }
+        db.rollback();
+    }
+
+    ans.succ = ans.failedRows.isEmpty();
+    return ans;
+}
+
+
+// Runs in the background, wait for result() or watch progress(). The
+// import reserves its connections for its whole run. The table is
+// dropped from the result cache when the import starts and again when
+// it finishes.
+QSharedPointer<DbImport> ParallelDbClient::importCsv(
+        const QString& fileName,
+        const QString& table,
+        const DbImportOptions& options)
+{
+    markWrite();
+    mResultCache.invalidateTable(table);
+    QSharedPointer<DbImport> ans(new DbImport(this, mPool, fileName, table, options));
+    ans->start();
+    return ans;
+}
+
+
+// The blob goes through the device chunkSize bytes at a time, with
+// SQLGetData over ODBC and incremental blob I/O on SQLite; other drivers
+// hold it in memory once. A pool thread uses the device, it has to stay
+// open and untouched until the future is finished. Not retried, the
+// device may already be partly written.
+QFuture<DbBlobResult> ParallelDbClient::readBlob(
+        const DbBlobLocation& location,
+        QIODevice* target,
+        int chunkSize,
+        DbConnectionPool::Priority priority)
+{
+    QString queryString = "SELECT " + location.column + " FROM " + location.table
+            + " WHERE " + location.keyColumn + " = ?";
+    return runRead<DbBlobResult>(
+                measured<DbBlobResult>(
+                    queryString,
+                    std::bind(
+                        &ParallelDbClient::executeReadBlob,
+                        this,
+                        std::placeholders::_1,
+                        location,
+                        target,
+                        chunkSize)),
+                priority);
+}
+
+
+// Source is read from its current position to its end: with SQLPutData
+// over ODBC, into a zeroblob of its size on SQLite (random access
+// devices only). Same device rules as readBlob().
+QFuture<DbBlobResult> ParallelDbClient::writeBlob(
+        const DbBlobLocation& location,
+        QIODevice* source,
+        int chunkSize,
+        DbConnectionPool::Priority priority)
+{
+    QString queryString = "UPDATE " + location.table + " SET " + location.column
+            + " = ? WHERE " + location.keyColumn + " = ?";
+    markWrite();
+    return mPool->run<DbBlobResult>(
+                invalidating<DbBlobResult>(
+                    queryString,
+                    bounded<DbBlobResult>(
+                        measured<DbBlobResult>(
+                            queryString,
+                            std::bind(
+                                &ParallelDbClient::executeWriteBlob,
+                                this,
+                                std::placeholders::_1,
+                                location,
+                                source,
+                                chunkSize)))),
+                deadline(),
+                priority);
+}
+
+
+// Statements of the returned transaction run on one reserved pooled
+// connection; queue them, then commit() or rollback() asynchronously
+QSharedPointer<DbTransaction> ParallelDbClient::beginTransaction()
+{
+    return QSharedPointer<DbTransaction>(new DbTransaction(this, mPool.data()));
+}
+
+
+// Each pipeline reserves its own pooled connection, open several of them
+// to spread a burst over more connections
+QSharedPointer<DbPipeline> ParallelDbClient::openPipeline()
+{
+    return QSharedPointer<DbPipeline>(new DbPipeline(this, mPool.data()));
 }
 
 
@@ -610,6 +2614,8 @@ bool ParallelDbClient::driverHasFeature() const
 }
 
 
+// transaction(), commit() and rollback() act on the connection of the
+// calling thread only, not on the pooled ones. See beginTransaction().
 bool ParallelDbClient::transaction() const
 {
     return QSqlDatabase::database(mConnectionName).transaction();
@@ -19,8 +19,30 @@
 #include <QtConcurrent/QtConcurrent>
 #include <QFuture>
 #include <QList>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSharedPointer>
+#include <QTimer>
 #include "paralleldbmetainfo.h"
 #include "dbconfig.h"
+#include "dbconnection.h"
+#include "dbconnectionpool.h"
+#include "dbrowstream.h"
+#include "dbresultset.h"
+#include "dbbatchresult.h"
+#include "dbparams.h"
+#include "dbresultcache.h"
+#include "dbretrypolicy.h"
+#include "dbmetrics.h"
+#include "dbdeadline.h"
+#include "dbtransaction.h"
+#include "dbpipeline.h"
+#include "dbpage.h"
+#include "dbcursor.h"
+#include "dbimport.h"
+#include "dbexport.h"
+#include "dbblob.h"
+#include "dbpartition.h"
 #include "constants.h"
 #include <ctime>
 
@@ -42,8 +64,15 @@ class LIBSHARED_EXPORT ParallelDbClient : public ParallelDbMetainfo
 {
     Q_OBJECT
     friend ParallelDbFactory;
+    friend DbTransaction;
+    friend DbPipeline;
+    friend DbCursor;
+    friend DbImport;
 
 public:
+    typedef std::function<bool(const QList<QSqlRecord>&)> RowConsumer;
+    enum ReplicaSelection { LEAST_OUTSTANDING, LOWEST_LATENCY };
+
     ~ParallelDbClient();
     ParallelDbClient(const ParallelDbClient&) = delete;
     void operator=(const ParallelDbClient&) = delete;
@@ -69,6 +98,64 @@ public:
     QString getOdbcName() const;
     void applyConfig();
     void useLog(bool v);
+    void setPoolSize(int minSize, int maxSize);
+    int getPoolMinSize() const;
+    int getPoolMaxSize() const;
+    int getPoolSize() const;
+    void setMaxQueueDepth(int depth);
+    void setOverflowPolicy(DbConnectionPool::OverflowPolicy policy);
+    int getMaxQueueDepth() const;
+    DbConnectionPool::OverflowPolicy getOverflowPolicy() const;
+    int getQueueDepth() const;
+    int getActiveWorkers() const;
+    void setStatementCacheSize(int size);
+    int getStatementCacheSize() const;
+    quint64 getStatementCacheHits() const;
+    quint64 getStatementCacheMisses() const;
+    quint64 getStatementCacheEvictions() const;
+    void addReplica(const DbConfig& config);
+    void clearReplicas();
+    int getReplicaCount() const;
+    void setReplicaSelection(ReplicaSelection selection);
+    ReplicaSelection getReplicaSelection() const;
+    void setReadYourWrites(
+            bool enabled,
+            int windowMs = DbConstants::DEFAULT_READ_YOUR_WRITES_MS);
+    bool isReadYourWrites() const;
+    void setResultCacheEnabled(bool enabled);
+    void setResultCacheLimits(
+            qint64 maxBytes = DbConstants::DEFAULT_RESULT_CACHE_BYTES,
+            int ttlMs = DbConstants::DEFAULT_RESULT_CACHE_TTL_MS);
+    bool isResultCacheEnabled() const;
+    qint64 getResultCacheMaxBytes() const;
+    int getResultCacheTtl() const;
+    void invalidateResultCache(const QString& table);
+    void clearResultCache();
+    quint64 getResultCacheHits() const;
+    quint64 getResultCacheMisses() const;
+    double getResultCacheHitRatio() const;
+    qint64 getResultCacheMemoryUsage() const;
+    int getResultCacheSize() const;
+    void setHealthCheckInterval(
+            int intervalMs = DbConstants::DEFAULT_HEALTH_CHECK_INTERVAL_MS);
+    int getHealthCheckInterval() const;
+    void preOpenConnections();
+    void setRetryPolicy(const DbRetryPolicy& policy);
+    DbRetryPolicy getRetryPolicy() const;
+    quint64 getRetries() const;
+    quint64 getRetriesDenied() const;
+    void setQueryTimeout(int timeoutMs);
+    int getQueryTimeout() const;
+    void setNativeFetch(
+            bool enabled,
+            int rowArraySize = DbConstants::DEFAULT_ODBC_ROW_ARRAY_SIZE);
+    bool isNativeFetch() const;
+    int getNativeFetchRowArraySize() const;
+    void setPriorityWeights(int interactive, int normal, int bulk);
+    void setMaxBulkConnections(int connections);
+    int getPriorityWeight(DbConnectionPool::Priority priority) const;
+    int getMaxBulkConnections() const;
+    const DbMetrics& getMetrics() const { return mMetrics; }
 
     QFuture<QList<QSqlRecord>> sendQuery(const QString& queryString);
     QFuture<QList<QSqlRecord>> sendBindedQuery(
@@ -86,17 +173,99 @@ public:
             const QString& queryString,
             const QList<QString>& placeholders,
             const QList<QByteArray>& binaries);
+    QFuture<QList<QSqlRecord>> select(
+            const QString& queryString,
+            DbParams params,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbResultSet> selectResultSet(const QString& queryString);
+    QFuture<DbResultSet> selectResultSet(
+            const QString& queryString,
+            const QList<QString>& placeholders,
+            const QList<QByteArray>& binaries);
+    QSharedPointer<DbRowStream> selectStream(
+            const QString& queryString,
+            int chunkSize = DbConstants::DEFAULT_STREAM_CHUNK_SIZE,
+            int maxPendingChunks = DbConstants::DEFAULT_STREAM_PENDING_CHUNKS,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<bool> selectStream(
+            const QString& queryString,
+            const RowConsumer& consumer,
+            int chunkSize = DbConstants::DEFAULT_STREAM_CHUNK_SIZE,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbPage> selectPage(
+            const QString& queryString,
+            const DbPageOptions& options,
+            const QByteArray& token = QByteArray(),
+            DbParams params = DbParams(),
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QSharedPointer<DbCursor> openCursor(
+            const QString& queryString,
+            DbParams params = DbParams());
+    QFuture<DbExportResult> exportQuery(
+            const QString& queryString,
+            const QString& fileName,
+            const DbExportOptions& options = DbExportOptions(),
+            DbParams params = DbParams(),
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::BULK);
+    QFuture<QList<QSqlRecord>> selectParallel(
+            const QString& queryString,
+            const DbScanOptions& options,
+            DbParams params = DbParams(),
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<bool> selectParallelStream(
+            const QString& queryString,
+            const RowConsumer& consumer,
+            const DbScanOptions& options,
+            DbParams params = DbParams(),
+            int chunkSize = DbConstants::DEFAULT_STREAM_CHUNK_SIZE,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
     QFuture<bool> insert(const QString& queryString);
     QFuture<bool> insert(
             const QString& queryString,
             const QList<QString>& placeholders,
             const QList<QByteArray>& binaries);
+    QFuture<bool> insert(
+            const QString& queryString,
+            DbParams params,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
     QFuture<bool> update(const QString& queryString);
     QFuture<bool> update(
             const QString& queryString,
             const QList<QString>& placeholders,
             const QList<QByteArray>& binaries);
+    QFuture<bool> update(
+            const QString& queryString,
+            DbParams params,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
     QFuture<bool> del(const QString& queryString);
+    QFuture<bool> del(
+            const QString& queryString,
+            DbParams params,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbBatchResult> insertBatch(
+            const QString& queryString,
+            const QList<QVariantList>& columns,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbBatchResult> updateBatch(
+            const QString& queryString,
+            const QList<QVariantList>& columns,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QSharedPointer<DbImport> importCsv(
+            const QString& fileName,
+            const QString& table,
+            const DbImportOptions& options = DbImportOptions());
+    QFuture<DbBlobResult> readBlob(
+            const DbBlobLocation& location,
+            QIODevice* target,
+            int chunkSize = DbConstants::DEFAULT_BLOB_CHUNK_BYTES,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbBlobResult> writeBlob(
+            const DbBlobLocation& location,
+            QIODevice* source,
+            int chunkSize = DbConstants::DEFAULT_BLOB_CHUNK_BYTES,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QSharedPointer<DbTransaction> beginTransaction();
+    QSharedPointer<DbPipeline> openPipeline();
     QSqlError lastError() const;
     QStringList tables() const;
 //    QSqlIndex primaryIndex(const QString& tablename) const;
@@ -115,31 +284,459 @@ private:
             const QString& connectionName,
             const DbConfig& config,
             QObject* parent = nullptr);
+    // Read-only copy of the database. outstanding and latency
+    // are used to pick the replica for the next read.
+    struct Replica
+    {
+        QSharedPointer<DbConnectionPool> pool;
+        QAtomicInt outstanding;
+        double latencyMs = 0.0;
+        QMutex mutex;
+
+        void finished(double ms);
+        double expectedWaitMs();
+    };
+    // Cursor of selectPage() in CURSOR mode, found by its token
+    struct PagingCursor
+    {
+        QSharedPointer<DbCursor> cursor;
+        qint64 lastUsed = 0;
+    };
+
+    template <typename T>
+    static void recordAttempts(T&, int) {}
+    static void recordAttempts(DbBatchResult& result, int attempts)
+    {
+        result.attempts = attempts;
+    }
+
+    // Runs fn again while it fails with errors the retry policy
+    // considers transient, the policy is the one set at submission.
+    // Between attempts the task goes back to the pool for its backoff
+    // (DbConnection::requestRetry()), the worker is not blocked.
+    template <typename T>
+    std::function<T(DbConnection&)> retrying(
+            const QString& queryString,
+            bool write,
+            std::function<T(DbConnection&)> fn)
+    {
+        DbRetryPolicy policy = getRetryPolicy();
+        if (!policy.isEnabled())
+            return fn;
+
+        // Attempts of one call never run at the same time
+        QSharedPointer<int> attempt(new int(1));
+        std::function<T(DbConnection&)> call(std::move(fn));
+        return [this, policy, queryString, write, call, attempt](
+                DbConnection& connection)
+        {
+            if (*attempt == 1)
+                mRetryBudget.deposit();
+
+            connection.setQueryError(QSqlError());
+            connection.setDeferErrors(true);
+            T ans = call(connection);
+            connection.setDeferErrors(false);
+            int backoffMs = retryAfter(connection, policy, queryString, write, *attempt);
+            if (backoffMs < 0)
+            {
+                recordAttempts(ans, *attempt);
+                return ans;
+            }
+
+            ++*attempt;
+            connection.requestRetry(backoffMs);
+            return ans;
+        };
+    }
+
+    // Calls cancelled or past their deadline report one error and
+    // no partial result. Statements they would still run after the
+    // cancel fail without reaching the server.
+    template <typename T>
+    std::function<T(DbConnection&)> bounded(std::function<T(DbConnection&)> fn)
+    {
+        std::function<T(DbConnection&)> call(std::move(fn));
+        return [this, call](DbConnection& connection)
+        {
+            if (connection.isCancelled())
+            {
+                fail(connection, connection.cancelError());
+                return T();
+            }
+
+            T ans = call(connection);
+            if (!connection.isCancelled())
+                return ans;
+
+            if (!connection.queryError().isValid())
+                fail(connection, connection.cancelError());
+
+            return T();
+        };
+    }
+
+    template <typename T>
+    static void recordResult(DbStatementMetrics*, const T&) {}
+    static void recordResult(
+            DbStatementMetrics* statement,
+            const QList<QSqlRecord>& rows);
+    static void recordResult(
+            DbStatementMetrics* statement,
+            const DbResultSet& result);
+    static void recordResult(
+            DbStatementMetrics* statement,
+            const DbPage& page);
+    static void recordResult(
+            DbStatementMetrics* statement,
+            const DbExportResult& result);
+    static void recordResult(
+            DbStatementMetrics* statement,
+            const DbBlobResult& result);
+
+    // Queue wait, executions, rows and bytes of the query. It is
+    // in flight until the task is run or dropped by the pool.
+    template <typename T>
+    std::function<T(DbConnection&)> measured(
+            const QString& queryString,
+            std::function<T(DbConnection&)> fn)
+    {
+        QElapsedTimer queued;
+        queued.start();
+        mMetrics.queryStarted();
+        QSharedPointer<DbMetrics> metrics(
+                    &mMetrics,
+                    [](DbMetrics* m) { m->queryFinished(); });
+        std::function<T(DbConnection&)> call(std::move(fn));
+        return [metrics, queryString, queued, call](DbConnection& connection)
+        {
+            qint64 us = queued.nsecsElapsed() / 1000;
+            DbStatementMetrics* statement = metrics->statement(queryString);
+            metrics->total().queueWait.observe(us);
+            statement->queueWait.observe(us);
+            metrics->total().executions.fetchAndAddRelaxed(1);
+            statement->executions.fetchAndAddRelaxed(1);
+
+            connection.setCurrentStatement(statement);
+            T ans = call(connection);
+            recordResult(&metrics->total(), ans);
+            recordResult(statement, ans);
+            return ans;
+        };
+    }
+
+    template <typename T>
+    QFuture<T> runRead(
+            const QString& queryString,
+            std::function<T(DbConnection&)> fn,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL)
+    {
+        return runRead<T>(measured<T>(
+                              queryString,
+                              retrying<T>(queryString, false, std::move(fn))),
+                          priority);
+    }
+
+    template <typename T>
+    QFuture<T> runRead(
+            std::function<T(DbConnection&)> fn,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL)
+    {
+        QDeadlineTimer until = deadline();
+        QSharedPointer<Replica> replica = pickReplica();
+        if (replica.isNull())
+        {
+            return mPool->run<T>(bounded<T>(std::move(fn)), until, priority);
+        }
+
+        // Ticket is released when the task is done or dropped by the pool
+        replica->outstanding.ref();
+        QSharedPointer<Replica> ticket(
+                    replica.data(),
+                    [replica](Replica* r) { r->outstanding.deref(); });
+        std::function<T(DbConnection&)> read(bounded<T>(std::move(fn)));
+        return replica->pool->run<T>([ticket, read](DbConnection& connection)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            T ans = read(connection);
+            ticket->finished(timer.nsecsElapsed() / 1000000.0);
+            return ans;
+        }, until, priority);
+    }
+
+    // Cached results of the written tables are dropped now and once more
+    // after the write, reads queued meanwhile may have cached old rows
+    template <typename T>
+    std::function<T(DbConnection&)> invalidating(
+            const QString& queryString,
+            std::function<T(DbConnection&)> fn)
+    {
+        if (!mResultCache.isEnabled())
+            return fn;
+
+        mResultCache.invalidate(queryString);
+        DbResultCache* cache = &mResultCache;
+        std::function<T(DbConnection&)> write(std::move(fn));
+        return [cache, queryString, write](DbConnection& connection)
+        {
+            T ans = write(connection);
+            cache->invalidate(queryString);
+            return ans;
+        };
+    }
+
+    template <typename T>
+    QFuture<T> runWrite(
+            const QString& queryString,
+            std::function<T(DbConnection&)> fn,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL)
+    {
+        markWrite();
+        return mPool->run<T>(invalidating<T>(
+                                 queryString,
+                                 bounded<T>(
+                                     measured<T>(
+                                         queryString,
+                                         retrying<T>(
+                                             queryString,
+                                             true,
+                                             std::move(fn))))),
+                             deadline(),
+                             priority);
+    }
+
+    // Part of a partitioned call, run on its own pooled connection.
+    // Parts are not retried, streamed rows may already be consumed.
+    template <typename T>
+    void queuePart(
+            QSharedPointer<DbConnectionPool> pool,
+            QSharedPointer<DbPartJob<T>> job,
+            const QString& queryString,
+            int part,
+            const QVariantList& boundaries,
+            std::function<T(DbConnection&, int, const QVariantList&)> fn,
+            const T& failed,
+            DbConnectionPool::Priority priority)
+    {
+        std::function<T(DbConnection&)> run = measured<T>(
+                    queryString,
+                    [fn, part, boundaries](DbConnection& connection)
+        {
+            return fn(connection, part, boundaries);
+        });
+
+        bool accepted = pool->enqueue([job, part, run](DbConnection& connection)
+        {
+            job->finish(part, run(connection));
+        }, priority);
+
+        if (!accepted)
+            job->finish(part, failed);
+    }
+
+    // Reads the key range boundaries on one pooled connection, then
+    // queues a part for every range. Without a key column the query is
+    // a single part. Parts are queued from a pool worker, which does
+    // not block on a full queue (see DbConnectionPool::enqueue()).
+    template <typename T>
+    QFuture<T> runPartitioned(
+            QSharedPointer<DbConnectionPool> pool,
+            const QString& queryString,
+            const DbParams& params,
+            const DbScanOptions& options,
+            typename DbPartJob<T>::Combine combine,
+            std::function<T(DbConnection&, int, const QVariantList&)> fn,
+            const T& failed,
+            DbConnectionPool::Priority priority)
+    {
+        QSharedPointer<DbPartJob<T>> job(new DbPartJob<T>(std::move(combine)));
+        QFuture<T> future = job->future();
+        if (options.keyColumn.isEmpty() || options.parallelism <= 1)
+        {
+            job->start(1);
+            queuePart<T>(pool, job, queryString, 0, QVariantList(), fn, failed, priority);
+            return future;
+        }
+
+        bool accepted = pool->enqueue(
+                    [this, pool, job, queryString, params, options, fn, failed, priority](
+                    DbConnection& connection)
+        {
+            QVariantList boundaries;
+            if (!executeBoundaries(connection, queryString, params, options, boundaries))
+            {
+                job->fail(failed);
+                return;
+            }
+
+            job->start(boundaries.size() + 1);
+            for (int part = 0; part <= boundaries.size(); ++part)
+            {
+                queuePart<T>(pool, job, queryString, part, boundaries, fn, failed, priority);
+            }
+        }, priority);
+
+        if (!accepted)
+            job->fail(failed);
+
+        return future;
+    }
+
+    QFuture<QList<QSqlRecord>> runCachedSelect(
+            const QString& queryString,
+            DbParams params,
+            DbConnectionPool::Priority priority = DbConnectionPool::Priority::NORMAL);
+    QFuture<DbPage> selectCursorPage(
+            const QString& queryString,
+            const DbPageOptions& options,
+            const QByteArray& token,
+            DbParams params,
+            DbConnectionPool::Priority priority);
+    void sweepCursors();
+    QSharedPointer<DbConnectionPool> createPool(
+            const QString& connectionName,
+            const DbConfig& config);
+    QSharedPointer<Replica> pickReplica();
+    QSharedPointer<DbConnectionPool> readPool();
+    void markWrite();
+    QDeadlineTimer deadline() const;
     bool verifyPresenceOfRequestedDriver();
     void addDb();
     void removeDbConnection(const QString& connectionName);
     void closeDb();
-    void openDb();
-    QList<QSqlRecord> executeQuery(const QString& queryString);
+    void openDb(DbConnection& connection);
+    void fail(DbConnection& connection, const QSqlError& error);
+    int retryAfter(
+            DbConnection& connection,
+            const DbRetryPolicy& policy,
+            const QString& queryString,
+            bool write,
+            int attempt);
+    QList<QSqlRecord> executeQuery(
+            DbConnection& connection,
+            const QString& queryString);
     QList<QSqlRecord> executeBindedQuery(
+            DbConnection& connection,
+            const QString& queryString,
+            const QList<QString>& placeholders,
+            const QList<QByteArray>& binaries);
+    QList<QSqlRecord> executeParamsQuery(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params);
+    QList<QSqlRecord> executeCheckedQuery(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params,
+            bool& succ);
+    bool executeParamsNonQuery(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params);
+    DbPage executeKeysetPage(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbPageOptions& options,
+            const QVariantList& lastKey,
+            const DbParams& params);
+    DbResultSet executeResultSetQuery(
+            DbConnection& connection,
             const QString& queryString,
             const QList<QString>& placeholders,
             const QList<QByteArray>& binaries);
-    bool executeNonQuery(const QString& queryString);
+    RowConsumer counting(const QString& queryString, RowConsumer consumer);
+    bool executeStreamedQuery(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params,
+            int chunkSize,
+            const RowConsumer& consumer);
+    bool executeBoundaries(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params,
+            const DbScanOptions& options,
+            QVariantList& boundaries);
+    DbExportResult executeExport(
+            DbConnection& connection,
+            const QString& queryString,
+            const DbParams& params,
+            const QString& fileName,
+            const DbExportOptions& options);
+    DbBlobResult executeReadBlob(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* target,
+            int chunkSize);
+    DbBlobResult executeWriteBlob(
+            DbConnection& connection,
+            const DbBlobLocation& location,
+            QIODevice* source,
+            int chunkSize);
+    bool executeNonQuery(
+            DbConnection& connection,
+            const QString& queryString);
     bool executeBindedNonQuery(
+            DbConnection& connection,
             const QString& queryString,
             const QList<QString>& placeholders,
             const QList<QByteArray>& binaries);
+    DbBatchResult executeBatch(
+            DbConnection& connection,
+            const QString& queryString,
+            const QList<QVariantList>& columns,
+            bool inTransaction);
+    DbBatchResult executeDriverBatch(
+            DbConnection& connection,
+            const QString& queryString,
+            const QList<QVariantList>& columns);
+    DbBatchResult executeBatchInTransaction(
+            DbConnection& connection,
+            const QString& queryString,
+            const QList<QVariantList>& columns,
+            bool callerTransaction);
     void log(const QString& msg);
 
     QString mConnectionName;
     DbConfig mConfig;
     bool mUseLog;
+    // Shared with the calls using a pool, it is deleted once the
+    // last of them is done
+    QSharedPointer<DbConnectionPool> mPool;
+
+    QList<QSharedPointer<Replica>> mReplicas;
+    ReplicaSelection mReplicaSelection;
+    uint mNextReplica;
+    bool mReadYourWrites;
+    int mReadYourWritesMs;
+    QHash<Qt::HANDLE, qint64> mLastWrites;
+    QElapsedTimer mClock;
+    mutable QMutex mRoutingMutex;
+    DbMetrics mMetrics;
+    DbResultCache mResultCache;
+    DbRetryPolicy mRetryPolicy;
+    DbRetryBudget mRetryBudget;
+    QAtomicInteger<quint64> mRetries;
+    QAtomicInteger<quint64> mRetriesDenied;
+    mutable QMutex mRetryMutex;
+    QAtomicInt mQueryTimeoutMs;
+    QAtomicInt mNativeFetchRows;
+    QHash<QByteArray, PagingCursor> mCursors;
+    QMutex mCursorMutex;
+    QTimer mCursorSweep;
 
     QMutex mMutex;
 
 signals:
     void dbError(QSqlError error);
+    void connectionStateChanged(const QString& connectionName, bool connected);
+    // Attempt counts of calls run under a retry policy are reported
+    // here, only batches return theirs too (DbBatchResult::attempts)
+    void queryRetried(const QString& queryString, int attempt, QSqlError error);
+    // Final error of a call run under a retry policy, after attempts
+    // executions. dbError() is emitted for it as well.
+    void queryFailed(const QString& queryString, int attempts, QSqlError error);
 };
 
 #endif // PARALLELDBCLIENT_H
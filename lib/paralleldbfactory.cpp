@@ -1,5 +1,79 @@
 #include "paralleldbfactory.h"
 
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QWaitCondition>
+
+namespace
+{
+    enum ShardStatus { PENDING, DONE, FAILED };
+
+    // Shared by the shard tasks and the gathering thread; outlives
+    // the gather when shards time out
+    struct ScatterState
+    {
+        QMutex mutex;
+        QWaitCondition shardFinished;
+        QVector<QList<QSqlRecord>> rows;
+        QVector<ShardStatus> status;
+        // Cancelled for shards still pending at the timeout
+        QVector<QFuture<bool>> futures;
+        int pending = 0;
+
+        void finish(int shard, const QList<QSqlRecord>& shardRows, bool succ)
+        {
+            QMutexLocker locker(&mutex);
+            rows[shard] = shardRows;
+            status[shard] = succ ? ShardStatus::DONE : ShardStatus::FAILED;
+            --pending;
+            shardFinished.wakeAll();
+        }
+    };
+
+    DbScatterResult gather(
+            QSharedPointer<ScatterState> state,
+            const QStringList& dbClientNames,
+            const DbScatterOptions& options,
+            QElapsedTimer timer)
+    {
+        DbScatterResult ans;
+        QVector<QList<QSqlRecord>> shards;
+
+        QMutexLocker locker(&state->mutex);
+        while (state->pending > 0)
+        {
+            qint64 left = options.timeoutMs - timer.elapsed();
+            if (left <= 0)
+                break;
+
+            state->shardFinished.wait(&state->mutex, static_cast<unsigned long>(left));
+        }
+
+        for (int i = 0; i < dbClientNames.size(); ++i)
+        {
+            switch (state->status[i])
+            {
+            case ShardStatus::DONE:
+                ans.completed.append(dbClientNames[i]);
+                shards.append(state->rows[i]);
+                break;
+            case ShardStatus::FAILED:
+                ans.failed.append(dbClientNames[i]);
+                break;
+            case ShardStatus::PENDING:
+                ans.timedOut.append(dbClientNames[i]);
+                state->futures[i].cancel();
+                break;
+            }
+        }
+        locker.unlock();
+
+        ans.rows = DbScatter::merge(shards, options);
+        return ans;
+    }
+}
+
+
 ParallelDbFactory& ParallelDbFactory::getInstance()
 {
     static ParallelDbFactory instance;
@@ -9,7 +83,7 @@ ParallelDbFactory& ParallelDbFactory::getInstance()
 
 ParallelDbFactory::ParallelDbFactory()
 {
-    //
+    mGatherPool.setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
 }
 
 
@@ -71,3 +145,127 @@ bool ParallelDbFactory::removeDbClient(const QString& dbClientName)
 
     return succ;
 }
+
+
+void ParallelDbFactory::defineShardGroup(
+        const QString& groupName,
+        const QStringList& dbClientNames)
+{
+    mShardGroups.insert(groupName, dbClientNames);
+}
+
+
+QStringList ParallelDbFactory::getShardGroup(const QString& groupName) const
+{
+    return mShardGroups.value(groupName);
+}
+
+
+const DbMetrics* ParallelDbFactory::getMetrics(
+        const QString& dbClientName) const
+{
+    ParallelDbClient* client = mDbClients.value(dbClientName, nullptr);
+    return client ? &client->getMetrics() : nullptr;
+}
+
+
+// Metrics of all clients in Prometheus text format,
+// labelled with the client names
+QString ParallelDbFactory::metricsText() const
+{
+    QList<QPair<QString, const DbMetrics*>> clients;
+    for (auto it = mDbClients.cbegin(); it != mDbClients.cend(); ++it)
+    {
+        clients.append(qMakePair(it.key(), &it.value()->getMetrics()));
+    }
+
+    return DbMetrics::toPrometheus(clients);
+}
+
+
+// File is replaced atomically, a scraper never reads half of it
+bool ParallelDbFactory::dumpMetrics(const QString& filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    file.write(metricsText().toUtf8());
+    return file.commit();
+}
+
+
+// Sends the query to every listed client at once and merges what comes
+// back within options.timeoutMs. Unknown clients, failed and late shards
+// are listed in the result, which then holds partial data.
+QFuture<DbScatterResult> ParallelDbFactory::scatter(
+        const QStringList& dbClientNames,
+        const QString& queryString,
+        const DbScatterOptions& options,
+        const DbParams& params)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSharedPointer<ScatterState> state(new ScatterState);
+    state->rows.resize(dbClientNames.size());
+    state->status.fill(ShardStatus::PENDING, dbClientNames.size());
+    state->futures.resize(dbClientNames.size());
+    state->pending = dbClientNames.size();
+
+    for (int i = 0; i < dbClientNames.size(); ++i)
+    {
+        ParallelDbClient* client = mDbClients.value(dbClientNames[i], nullptr);
+        if (client == nullptr)
+        {
+            emit requestedDberror(
+                        "Database " +
+                        dbClientNames[i] +
+                        " does not exist.");
+            state->finish(i, QList<QSqlRecord>(), false);
+            continue;
+        }
+
+        // Late shards are cancelled by the gather, their deadline
+        // stops a statement still running on the server
+        QFuture<bool> future = client->mPool->run<bool>(
+                    [client, state, i, queryString, params](
+                    DbConnection& connection)
+        {
+            bool succ = false;
+            QList<QSqlRecord> rows = client->executeCheckedQuery(
+                        connection, queryString, params, succ);
+            state->finish(i, rows, succ);
+            return succ;
+        },
+        QDeadlineTimer(qMax(0, options.timeoutMs)));
+
+        QMutexLocker locker(&state->mutex);
+        state->futures[i] = future;
+    }
+
+    return QtConcurrent::run(
+                &mGatherPool,
+                [state, dbClientNames, options, timer]()
+    {
+        return gather(state, dbClientNames, options, timer);
+    });
+}
+
+
+QFuture<DbScatterResult> ParallelDbFactory::scatterGroup(
+        const QString& groupName,
+        const QString& queryString,
+        const DbScatterOptions& options,
+        const DbParams& params)
+{
+    if (!mShardGroups.contains(groupName))
+    {
+        emit requestedDberror(
+                    "Shard group " +
+                    groupName +
+                    " does not exist.");
+    }
+
+    return scatter(getShardGroup(groupName), queryString, options, params);
+}
@@ -6,8 +6,10 @@
 
 #include <QObject>
 #include <QMap>
+#include <QThreadPool>
 #include "paralleldbclient.h"
 #include "dbconfig.h"
+#include "dbscatter.h"
 
 class LIBSHARED_EXPORT ParallelDbFactory : public QObject
 {
@@ -25,9 +27,31 @@ public:
             const DbConfig& config);
     bool removeDbClient(const QString& dbClientName);
 
+    void defineShardGroup(
+            const QString& groupName,
+            const QStringList& dbClientNames);
+    QStringList getShardGroup(const QString& groupName) const;
+    QFuture<DbScatterResult> scatter(
+            const QStringList& dbClientNames,
+            const QString& queryString,
+            const DbScatterOptions& options = DbScatterOptions(),
+            const DbParams& params = DbParams());
+    QFuture<DbScatterResult> scatterGroup(
+            const QString& groupName,
+            const QString& queryString,
+            const DbScatterOptions& options = DbScatterOptions(),
+            const DbParams& params = DbParams());
+
+    const DbMetrics* getMetrics(const QString& dbClientName) const;
+    QString metricsText() const;
+    bool dumpMetrics(const QString& filePath) const;
+
 private:
     explicit ParallelDbFactory(/*QObject* parent = nullptr*/);
     QMap<QString, ParallelDbClient*> mDbClients;
+    QMap<QString, QStringList> mShardGroups;
+    // Only waits for shard results, queries run on the clients' pools
+    QThreadPool mGatherPool;
 
 signals:
     void requestedDberror(QString msg);
@@ -2,10 +2,23 @@
 #define UTILS_H
 
 #include <QDebug>
+#include <QFuture>
+#include <QFutureInterface>
 
 namespace Db
 {
     void log(const QString& msg);
+
+    // Future already holding its result, for calls that can not be queued
+    template <typename T>
+    QFuture<T> readyFuture(const T& value)
+    {
+        QFutureInterface<T> promise;
+        promise.reportStarted();
+        promise.reportResult(value);
+        promise.reportFinished();
+        return promise.future();
+    }
 }
 
 #endif // UTILS_H